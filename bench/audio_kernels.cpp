@@ -0,0 +1,395 @@
+/* microbenchmark of the sample processing functions and the audio file loaders
+ * every function is measured over buffer sizes from L1 resident to larger than the last level cache
+ * conversion and DSP kernels are measured for every kernel set the CPU supports, so scalar and vectorized variants can be compared
+ * writes CSV with one row per function, variant and size; the best of several batches is reported, as that is the least noisy
+ * usage: bench_audio_kernels [output path]; run from the build directory (`make microbench`)
+ */
+
+#include "wav_fixture.hpp"
+
+#include "exception.hpp"
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "audio/audio_funcs.hpp"
+#include "audio/dsp/kernels.hpp"
+#include "audio/dsp/wave_ops.hpp"
+#include "audio/wave_data.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/convert/kernels.hpp"
+#include "audio/convert/resampler.hpp"
+#include "audio/convert/sample_format.hpp"
+#include "audio/audio_file_loader/loaders.hpp"
+#include "audio/audio_file_loader/async_loader.hpp"
+#include "profiling/timer.hpp"
+
+#include <algorithm>  // sort(), min()
+#include <cmath>  // abs()
+#include <cstdint>
+#include <cstdlib>  // EXIT_SUCCESS, EXIT_FAILURE
+#include <cstring>  // memcpy()
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>  // pair
+#include <vector>
+
+
+/* config */
+constexpr const char* DEFAULT_OUTPUT_PATH = "bench_audio_kernels.csv";
+// float samples per buffer; 4 KiB (L1) up to 64 MiB (larger than most last level caches)
+const std::vector<size_t> BUFFER_SIZES = {1 << 10, 1 << 13, 1 << 16, 1 << 19, 1 << 22, 1 << 24};
+// every measurement is the best of this many batches
+constexpr int N_BATCHES = 5;
+// each batch repeats the function until it took at least this long
+constexpr double MIN_BATCH_TIME = 20.0;  // milliseconds
+// loaders are slow enough to time single runs
+constexpr int N_LOADER_RUNS = 5;
+constexpr double FIXTURE_SECONDS = 30.0;
+
+
+namespace {
+
+// results are written here, so the compiler can't remove the computations
+volatile float sink;
+
+
+struct Measurement {
+    double min;  // nanoseconds per sample
+    double median;  // nanoseconds per sample
+};
+
+
+// runs `function` (processing `n_samples` samples per call) in batches
+Measurement measure(const std::function<void()>& function, const size_t n_samples) {
+    // warm caches and branch predictors, and find the number of calls per batch
+    int n_calls = 1;
+    while (true) {
+        const Timer::TimePoint start = Timer::now();
+        for (int i = 0; i < n_calls; i++)
+            function();
+        if (Timer::Duration<Timer::ms>(Timer::now() - start) >= MIN_BATCH_TIME)
+            break;
+        n_calls *= 2;
+    }
+
+    std::vector<double> batch_times;
+    for (int batch = 0; batch < N_BATCHES; batch++) {
+        const Timer::TimePoint start = Timer::now();
+        for (int i = 0; i < n_calls; i++)
+            function();
+        const double time = Timer::Duration<Timer::ns>(Timer::now() - start);
+        batch_times.push_back(time / ((double)n_calls * n_samples));
+    }
+
+    std::sort(batch_times.begin(), batch_times.end());
+    return {.min = batch_times.front(), .median = batch_times[batch_times.size() / 2]};
+}
+
+
+class CsvWriter {
+    public:
+        CsvWriter(const std::filesystem::path& path)
+            : file(path)
+        {
+            if (!file.is_open())
+                throw Exception("Failed to open '" + path.string() + "' for writing benchmark results");
+
+            file << "benchmark,variant,n_samples,bytes,ns_per_sample_min,ns_per_sample_median,mb_per_s\n";
+        }
+
+        // `bytes` is the amount of input data per call, used for throughput
+        void write(const std::string& benchmark, const std::string& variant, const size_t n_samples, const size_t bytes, const Measurement& measurement) {
+            const double mb_per_s = (bytes / 1e6) / (measurement.min * n_samples / 1e9);
+            file << benchmark << ',' << variant << ',' << n_samples << ',' << bytes << ','
+                 << measurement.min << ',' << measurement.median << ',' << mb_per_s << '\n';
+            Logger::info("{} ({}, {} samples): {:.3f} ns/sample", benchmark, variant, n_samples, measurement.min);
+        }
+
+        void check() const {
+            if (!file)
+                throw Exception("Failed to write benchmark results");
+        }
+
+
+    private:
+        std::ofstream file;
+};
+
+
+// reference implementation of normalize() before it was vectorized
+void normalize_reference(std::vector<float>& samples) {
+    float max_value = 0.0f;
+    for (const float sample : samples) {
+        if (std::abs(sample) > max_value)
+            max_value = std::abs(sample);
+    }
+
+    const float factor = 1.0f / max_value;
+    for (float& sample : samples)
+        sample *= factor;
+}
+
+
+void bench_conversion_kernels(CsvWriter& csv, std::mt19937& rng) {
+    const std::vector<AudioConvert::SampleFormat> formats = {AudioConvert::SampleFormat::s16, AudioConvert::SampleFormat::s24, AudioConvert::SampleFormat::s32, AudioConvert::SampleFormat::f64};
+    const std::vector<std::string> format_names = {"s16", "s24", "s32", "f64"};
+
+    for (const std::string& kernel_set : AudioConvert::get_supported_kernel_sets()) {
+        AudioConvert::set_kernel_set(kernel_set);
+
+        for (const size_t n_samples : BUFFER_SIZES) {
+            std::vector<float> out(n_samples);
+
+            for (size_t f = 0; f < formats.size(); f++) {
+                // f64 needs valid doubles; random bytes are fine for integer formats
+                std::vector<uint8_t> raw(n_samples * AudioConvert::bytes_per_sample(formats[f]));
+                if (formats[f] == AudioConvert::SampleFormat::f64) {
+                    std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+                    for (size_t i = 0; i < n_samples; i++) {
+                        const double value = distribution(rng);
+                        std::memcpy(raw.data() + i * sizeof(double), &value, sizeof(double));
+                    }
+                }
+                else {
+                    for (uint8_t& byte : raw)
+                        byte = rng();
+                }
+
+                const Measurement measurement = measure([&]() { AudioConvert::to_float(raw.data(), out.data(), n_samples, formats[f]); sink = out[0]; }, n_samples);
+                csv.write("to_float_" + format_names[f], kernel_set, n_samples, raw.size(), measurement);
+            }
+
+            // n_samples is the number of input samples
+            std::vector<float> in(n_samples);
+            std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+            for (float& sample : in)
+                sample = distribution(rng);
+
+            std::vector<float> stereo_out(2 * n_samples);
+            csv.write("stereo_to_mono", kernel_set, n_samples, n_samples * sizeof(float),
+                measure([&]() { AudioConvert::remix_channels(in.data(), 2, out.data(), 1, n_samples / 2); sink = out[0]; }, n_samples));
+            csv.write("mono_to_stereo", kernel_set, n_samples, n_samples * sizeof(float),
+                measure([&]() { AudioConvert::remix_channels(in.data(), 1, stereo_out.data(), 2, n_samples); sink = stereo_out[0]; }, n_samples));
+        }
+    }
+
+    // restore the default
+    AudioConvert::set_kernel_set(AudioConvert::get_supported_kernel_sets().front());
+}
+
+
+void bench_resampler(CsvWriter& csv, std::mt19937& rng) {
+    // most common conversion, and downsampling, which uses a longer filter; the resampler selects its own dot product kernel
+    const std::vector<std::pair<int, int>> rates = {{44100, 48000}, {96000, 44100}};
+    const int n_channels = 2;
+    for (const auto& [in_rate, out_rate] : rates) {
+        for (const size_t n_samples : BUFFER_SIZES) {
+            const size_t n_frames = n_samples / n_channels;
+            std::vector<float> in(n_samples);
+            std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+            for (float& sample : in)
+                sample = distribution(rng);
+
+            AudioConvert::Resampler resampler(in_rate, out_rate, n_channels);
+            std::vector<float> out(resampler.max_output_frames(n_frames) * n_channels);
+            const Measurement measurement = measure([&]() {
+                resampler.reset();
+                sink = resampler.process(in.data(), n_frames, out.data());
+            }, n_samples);
+            csv.write("resample_" + std::to_string(in_rate) + "_" + std::to_string(out_rate), AudioConvert::get_kernel_set_name(), n_samples, n_samples * sizeof(float), measurement);
+        }
+    }
+}
+
+
+void bench_dsp_kernels(CsvWriter& csv, std::mt19937& rng) {
+    const int n_channels = 2;
+
+    for (const std::string& kernel_set : Dsp::get_supported_kernel_sets()) {
+        Dsp::set_kernel_set(kernel_set);
+
+        for (const size_t n_samples : BUFFER_SIZES) {
+            std::vector<float> a(n_samples), b(n_samples), out(n_samples);
+            std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+            for (size_t i = 0; i < n_samples; i++) {
+                a[i] = distribution(rng);
+                b[i] = distribution(rng);
+            }
+
+            // gains close to 1.0 keep the samples in range while repeating
+            const size_t bytes = n_samples * sizeof(float);
+            const float ramp_step = 1e-3f / n_samples;
+            csv.write("dsp_gain", kernel_set, n_samples, bytes, measure([&]() { Dsp::apply_gain(out, 1.0f); sink = out[0]; }, n_samples));
+            csv.write("dsp_gain_ramp", kernel_set, n_samples, bytes, measure([&]() { Dsp::apply_gain_ramp(out, n_channels, 1.0f, ramp_step); sink = out[0]; }, n_samples));
+            csv.write("dsp_mix", kernel_set, n_samples, 2 * bytes, measure([&]() { Dsp::mix(a, out, 1e-3f); sink = out[0]; }, n_samples));
+            csv.write("dsp_crossfade", kernel_set, n_samples, 2 * bytes, measure([&]() { Dsp::crossfade(a, b, out, n_channels, 0.0f, 2.0f / n_samples); sink = out[0]; }, n_samples));
+            csv.write("dsp_clip", kernel_set, n_samples, bytes, measure([&]() { Dsp::clip(a, 0.9f); sink = a[0]; }, n_samples));
+            csv.write("dsp_levels", kernel_set, n_samples, bytes, measure([&]() { sink = Dsp::measure_levels(b).rms; }, n_samples));
+
+            // `out` holds the planar channels
+            const size_t n_frames = n_samples / n_channels;
+            csv.write("dsp_deinterleave", kernel_set, n_samples, bytes, measure([&]() { Dsp::deinterleave(a.data(), n_channels, out.data(), n_frames, n_frames); sink = out[0]; }, n_samples));
+            csv.write("dsp_interleave", kernel_set, n_samples, bytes, measure([&]() { Dsp::interleave(out.data(), n_frames, n_channels, a.data(), n_frames); sink = a[0]; }, n_samples));
+        }
+    }
+
+    // restore the default
+    Dsp::set_kernel_set(Dsp::get_supported_kernel_sets().front());
+}
+
+
+void bench_channel_sums(CsvWriter& csv, std::mt19937& rng) {
+    const int n_channels = 2;
+
+    for (const size_t n_samples : BUFFER_SIZES) {
+        const size_t n_frames = n_samples / n_channels;
+        std::vector<float> interleaved(n_samples), mono(n_frames);
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        for (float& sample : interleaved)
+            sample = distribution(rng);
+
+        const size_t bytes = n_samples * sizeof(float);
+        csv.write("sum_channels", "library", n_samples, bytes, measure([&]() { Dsp::sum_channels(interleaved.data(), n_channels, mono.data(), n_frames); sink = mono[0]; }, n_samples));
+    }
+}
+
+
+void bench_audio_funcs(CsvWriter& csv, std::mt19937& rng) {
+    const SampleConfig sample_config = {.sample_rate = 44100, .n_channels = 2};
+    ThreadPool thread_pool;
+
+    for (const size_t n_samples : BUFFER_SIZES) {
+        std::vector<float> samples(n_samples);
+        std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+        for (float& sample : samples)
+            sample = distribution(rng);
+
+        const size_t bytes = n_samples * sizeof(float);
+
+        csv.write("peak", "library", n_samples, bytes, measure([&]() { sink = peak(samples); }, n_samples));
+
+        std::vector<float> reference_samples = samples;
+        csv.write("normalize", "reference", n_samples, bytes, measure([&]() { normalize_reference(reference_samples); sink = reference_samples[0]; }, n_samples));
+
+        WaveData wave_data(std::move(samples), sample_config);
+        csv.write("normalize", "library", n_samples, bytes, measure([&]() { normalize(wave_data); sink = wave_data.samples[0]; }, n_samples));
+        csv.write("normalize", "threaded", n_samples, bytes, measure([&]() { Dsp::normalize(wave_data, 1.0f, &thread_pool); sink = wave_data.samples[0]; }, n_samples));
+
+        // sample offsets as used when seeking
+        std::vector<int> int_offsets(n_samples);
+        std::vector<double> double_offsets(n_samples);
+        std::uniform_int_distribution<int> offset_distribution(0, WaveData::max_n_samples / 2);
+        for (size_t i = 0; i < n_samples; i++) {
+            int_offsets[i] = offset_distribution(rng);
+            double_offsets[i] = int_offsets[i] + 0.5;
+        }
+
+        const std::vector<std::pair<std::string, int (*)(const int, const int)>> int_aligns = {
+            {"channel_align", channel_align}, {"channel_align_up", channel_align_up}, {"channel_align_down", channel_align_down}
+        };
+        for (const auto& [name, align] : int_aligns) {
+            csv.write(name + "_int", "library", n_samples, n_samples * sizeof(int), measure([&]() {
+                int sum = 0;
+                for (const int offset : int_offsets)
+                    sum += align(offset, sample_config.n_channels);
+                sink = sum;
+            }, n_samples));
+        }
+
+        const std::vector<std::pair<std::string, int (*)(const double, const int)>> double_aligns = {
+            {"channel_align", channel_align}, {"channel_align_up", channel_align_up}, {"channel_align_down", channel_align_down}
+        };
+        for (const auto& [name, align] : double_aligns) {
+            csv.write(name + "_double", "library", n_samples, n_samples * sizeof(double), measure([&]() {
+                int sum = 0;
+                for (const double offset : double_offsets)
+                    sum += align(offset, sample_config.n_channels);
+                sink = sum;
+            }, n_samples));
+        }
+    }
+}
+
+
+// best of several runs of `load`, which returns the number of output samples
+Measurement measure_loader(const std::function<size_t()>& load) {
+    std::vector<double> times;
+    size_t n_samples = 0;
+    for (int run = 0; run < N_LOADER_RUNS; run++) {
+        const Timer::TimePoint start = Timer::now();
+        n_samples = load();
+        times.push_back(Timer::Duration<Timer::ns>(Timer::now() - start));
+    }
+
+    std::sort(times.begin(), times.end());
+    return {.min = times.front() / n_samples, .median = times[times.size() / 2] / n_samples};
+}
+
+
+void bench_loaders(CsvWriter& csv) {
+    const SampleConfig sample_config = {.sample_rate = 44100, .n_channels = 2};
+    const std::vector<WavFixture::Spec> specs = {
+        {.encoding = WavFixture::Encoding::pcm16, .sample_rate = 44100, .n_channels = 2, .seconds = FIXTURE_SECONDS},
+        {.encoding = WavFixture::Encoding::pcm24, .sample_rate = 44100, .n_channels = 2, .seconds = FIXTURE_SECONDS},
+        {.encoding = WavFixture::Encoding::pcm32, .sample_rate = 44100, .n_channels = 2, .seconds = FIXTURE_SECONDS},
+        {.encoding = WavFixture::Encoding::float32, .sample_rate = 44100, .n_channels = 2, .seconds = FIXTURE_SECONDS},
+        {.encoding = WavFixture::Encoding::pcm16, .sample_rate = 48000, .n_channels = 2, .seconds = FIXTURE_SECONDS},
+        {.encoding = WavFixture::Encoding::pcm16, .sample_rate = 22050, .n_channels = 1, .seconds = FIXTURE_SECONDS}
+    };
+    const std::vector<std::filesystem::path> fixtures = WavFixture::write_all(std::filesystem::temp_directory_path() / "bench_fixtures", specs);
+
+    ThreadPool thread_pool;
+    for (size_t i = 0; i < fixtures.size(); i++) {
+        const std::string path = fixtures[i].string();
+        const std::string name = "load_" + specs[i].name();
+        const size_t file_size = std::filesystem::file_size(fixtures[i]);
+        // throughput in output samples
+        const size_t n_samples = AudioFileLoader::best_loader(path, sample_config).samples.size();
+
+        csv.write(name, "sdl_wav", n_samples, file_size, measure_loader([&]() { return AudioFileLoader::sdl_wav(path, sample_config).samples.size(); }));
+
+        // only usable for float32 files matching the sample config
+        if (AudioFileLoader::mmap_wav(path, sample_config).has_value()) {
+            csv.write(name, "mmap_wav", n_samples, file_size, measure_loader([&]() {
+                const std::optional<WaveData> wave_data = AudioFileLoader::mmap_wav(path, sample_config);
+                // touch every page, as mapping is lazy
+                sink = peak(wave_data->samples);
+                return wave_data->samples.size();
+            }));
+        }
+
+        csv.write(name, "load_async", n_samples, file_size, measure_loader([&]() { return AudioFileLoader::load_async(path, sample_config, thread_pool)->get().samples.size(); }));
+    }
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+    const std::string output_path = (argc > 1 ? argv[1] : DEFAULT_OUTPUT_PATH);
+
+    try {
+        CsvWriter csv(output_path);
+        std::mt19937 rng(0);
+
+        bench_conversion_kernels(csv, rng);
+        bench_resampler(csv, rng);
+        bench_dsp_kernels(csv, rng);
+        bench_channel_sums(csv, rng);
+        bench_audio_funcs(csv, rng);
+        bench_loaders(csv);
+
+        csv.check();
+        Logger::info("Wrote benchmark results to '{}'", output_path);
+    }
+    catch (const std::exception& e) {
+        Logger::fatal("Benchmark failed");
+        Logger::exception(e);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+/* frame-loop benchmark: runs Program headless and uncapped on SDL's dummy drivers for a fixed number of frames
+ * replays a scripted event sequence (dropping synthesized WAV files, stopping playback) and measures loader throughput
+ *   the short files are loaded as mixer voices, the long one is streamed (see Program::STREAM_MIN_LENGTH)
+ * writes JSON with frame-time percentiles, loader throughput and allocation counts
+ * usage: bench_frame_loop [n_frames] [output path] [--cpu]; run from the build directory (`make bench`)
+ *   --cpu renders with the CPU backend into memory instead of with SDL's software renderer
+ */
+
+#include "wav_fixture.hpp"
+
+#include "program.hpp"
+#include "exception.hpp"
+#include "rsc_dir.hpp"
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/audio_file_loader/async_loader.hpp"
+#include "profiling/frame_performance.hpp"
+#include "profiling/timer.hpp"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#ifdef _WIN32
+#include <malloc.h>  // _aligned_malloc(), _aligned_free()
+#endif
+
+#include <algorithm>  // stable_sort(), max()
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>  // EXIT_SUCCESS, EXIT_FAILURE, malloc(), aligned_alloc(), free(), strtoull()
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <new>  // bad_alloc, align_val_t, nothrow_t
+#include <string>
+#include <vector>
+
+
+/* config */
+constexpr uint64_t DEFAULT_N_FRAMES = 2000;
+constexpr const char* DEFAULT_OUTPUT_PATH = "bench_frame_loop.json";
+// frame at which each fixture is dropped on the window
+constexpr uint64_t FIRST_DROP_FRAME = 10;
+constexpr uint64_t DROP_INTERVAL = 20;
+// frame at which playback is stopped ('s'), as a fraction of the run
+constexpr double STOP_AT = 0.75;
+
+
+/* allocation counting
+ * replaces the global operator new, including its aligned and nothrow forms, so all allocations of the program are counted
+ */
+namespace {
+
+std::atomic<uint64_t> n_allocations = 0;
+std::atomic<uint64_t> n_allocated_bytes = 0;
+
+
+struct LoaderResult {
+    std::string name;
+    uint64_t file_size;
+    double load_time;  // milliseconds
+};
+
+
+SDL_Event make_key_event(const SDL_Keycode key) {
+    SDL_Event event = {};
+    event.type = SDL_KEYDOWN;
+    event.key.state = SDL_PRESSED;
+    event.key.keysym.sym = key;
+    return event;
+}
+
+
+std::vector<LoaderResult> bench_loaders(const std::vector<std::filesystem::path>& fixtures, const SampleConfig& sample_config) {
+    ThreadPool thread_pool;
+
+    std::vector<LoaderResult> results;
+    for (const std::filesystem::path& fixture : fixtures) {
+        const Timer::TimePoint start = Timer::now();
+        const WaveData wave_data = AudioFileLoader::load_async(fixture.string(), sample_config, thread_pool)->get();
+        const double load_time = Timer::Duration<Timer::ms>(Timer::now() - start);
+
+        results.push_back({.name = fixture.stem().string(), .file_size = std::filesystem::file_size(fixture), .load_time = load_time});
+    }
+
+    return results;
+}
+
+
+void* counted_malloc(const size_t size) noexcept {
+    n_allocations.fetch_add(1, std::memory_order_relaxed);
+    n_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+
+// over-aligned allocations, e.g. by AlignedAllocator and for alignas() types
+void* counted_aligned_malloc(const size_t size, const std::align_val_t alignment) noexcept {
+    n_allocations.fetch_add(1, std::memory_order_relaxed);
+    n_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+
+    const size_t align = static_cast<size_t>(alignment);
+#ifdef _WIN32
+    return _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+    // aligned_alloc() requires the size to be a non-zero multiple of the alignment
+    return std::aligned_alloc(align, std::max<size_t>(align, (size + align - 1) / align * align));
+#endif
+}
+
+
+void aligned_free(void* const ptr) noexcept {
+#ifdef _WIN32
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+}  // namespace
+
+
+// the array and sized forms not replaced here forward to these by default
+void* operator new(const size_t size) {
+    void* const ptr = counted_malloc(size);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(const size_t size, const std::nothrow_t&) noexcept {
+    return counted_malloc(size);
+}
+
+void* operator new(const size_t size, const std::align_val_t alignment) {
+    void* const ptr = counted_aligned_malloc(size, alignment);
+    if (ptr == nullptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(const size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return counted_aligned_malloc(size, alignment);
+}
+
+void operator delete(void* const ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* const ptr, const size_t /*size*/) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* const ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* const ptr, const std::align_val_t /*alignment*/) noexcept {
+    aligned_free(ptr);
+}
+
+void operator delete(void* const ptr, const size_t /*size*/, const std::align_val_t /*alignment*/) noexcept {
+    aligned_free(ptr);
+}
+
+void operator delete(void* const ptr, const std::align_val_t /*alignment*/, const std::nothrow_t&) noexcept {
+    aligned_free(ptr);
+}
+
+
+int main(int argc, char* argv[]) {
+    const uint64_t n_frames = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : DEFAULT_N_FRAMES);
+    const std::string output_path = (argc > 2 ? argv[2] : DEFAULT_OUTPUT_PATH);
+    const bool cpu_render = (argc > 3 && std::string(argv[3]) == "--cpu");
+    if (n_frames == 0 || argc > 4 || (argc == 4 && !cpu_render)) {
+        std::cerr << "Usage: " << argv[0] << " [n_frames] [output path] [--cpu]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // no window or audio device needed; don't overwrite, so other drivers can be benchmarked through the environment
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+    SDL_setenv("SDL_AUDIODRIVER", "dummy", 0);
+
+    try {
+        RscDir::set("rsc");
+    }
+    catch (const std::exception& e) {
+        Logger::fatal("Failed to set resource directory");
+        Logger::exception(e);
+        return EXIT_FAILURE;
+    }
+
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
+        Logger::fatal("SDL failed to initialize\nSDL error: {}", SDL_GetError());
+        return EXIT_FAILURE;
+    }
+    if (TTF_Init() != 0) {
+        Logger::fatal("SDL's TTF rendering engine failed to initialize\nTTF error: {}", TTF_GetError());
+        return EXIT_FAILURE;
+    }
+
+    int ret = EXIT_SUCCESS;
+    try {
+        const std::vector<std::filesystem::path> fixtures = WavFixture::write_all(std::filesystem::temp_directory_path() / "bench_fixtures", {
+            {.encoding = WavFixture::Encoding::pcm16, .sample_rate = 44100, .n_channels = 2, .seconds = 10.0},
+            {.encoding = WavFixture::Encoding::pcm24, .sample_rate = 48000, .n_channels = 2, .seconds = 10.0},
+            {.encoding = WavFixture::Encoding::float32, .sample_rate = 44100, .n_channels = 2, .seconds = 10.0},
+            {.encoding = WavFixture::Encoding::pcm16, .sample_rate = 22050, .n_channels = 1, .seconds = 10.0},
+            {.encoding = WavFixture::Encoding::pcm16, .sample_rate = 48000, .n_channels = 2, .seconds = 2 * Program::STREAM_MIN_LENGTH}
+        });
+
+        // same sample config as Program
+        const std::vector<LoaderResult> loader_results = bench_loaders(fixtures, {.sample_rate = 44100, .n_channels = 2});
+
+        ProgramOptions options = {.fps_limit = 0.0, .max_frames = n_frames, .headless = true, .event_script = {}, .audio_disk_cache = false, .render_mode = RenderMode::immediate, .render_backend = (cpu_render ? RenderBackend::cpu : RenderBackend::sdl)};
+        for (size_t i = 0; i < fixtures.size(); i++) {
+            SDL_Event event = {};
+            event.type = SDL_DROPFILE;
+            options.event_script.push_back({.frame = FIRST_DROP_FRAME + i * DROP_INTERVAL, .event = event, .dropped_file = fixtures[i].string()});
+        }
+        options.event_script.push_back({.frame = static_cast<uint64_t>(STOP_AT * n_frames), .event = make_key_event(SDLK_s), .dropped_file = ""});
+        std::stable_sort(options.event_script.begin(), options.event_script.end(), [](const ScriptedEvent& a, const ScriptedEvent& b) { return a.frame < b.frame; });
+
+        Program program(options);
+
+        const uint64_t allocations_before = n_allocations.load();
+        const uint64_t allocated_bytes_before = n_allocated_bytes.load();
+        const Timer::TimePoint start = Timer::now();
+        program.main_loop();
+        const double run_time = Timer::Duration<Timer::sec>(Timer::now() - start);
+        const uint64_t allocations = n_allocations.load() - allocations_before;
+        const uint64_t allocated_bytes = n_allocated_bytes.load() - allocated_bytes_before;
+
+        const FramePerformance& frame_perf = program.get_frame_performance();
+        const double run_frames = program.get_n_frames();
+
+        std::ofstream file(output_path);
+        file << "{\n"
+             << "  \"frames\": " << program.get_n_frames() << ",\n"
+             << "  \"idle_frames\": " << frame_perf.get_n_idle_frames() << ",\n"
+             << "  \"render_backend\": \"" << (cpu_render ? "cpu" : "sdl") << "\",\n"
+             << "  \"run_time_s\": " << run_time << ",\n"
+             << "  \"frame_time_ms\": {"
+             << "\"p50\": " << frame_perf.get_frame_time_percentile(50.0)
+             << ", \"p95\": " << frame_perf.get_frame_time_percentile(95.0)
+             << ", \"p99\": " << frame_perf.get_frame_time_percentile(99.0)
+             << ", \"p99.9\": " << frame_perf.get_frame_time_percentile(99.9)
+             << ", \"max\": " << frame_perf.get_max_frame_time() << "},\n"
+             << "  \"one_percent_low_fps\": " << frame_perf.get_one_percent_low_fps() << ",\n"
+             << "  \"loaders\": [";
+        for (size_t i = 0; i < loader_results.size(); i++) {
+            const LoaderResult& result = loader_results[i];
+            file << (i == 0 ? "\n" : ",\n")
+                 << "    {\"fixture\": \"" << result.name << "\", \"bytes\": " << result.file_size
+                 << ", \"load_time_ms\": " << result.load_time
+                 << ", \"mb_per_s\": " << (result.file_size / 1e6) / (result.load_time / 1000.0) << '}';
+        }
+        file << "\n  ],\n"
+             << "  \"allocations\": {\"total\": " << allocations
+             << ", \"bytes\": " << allocated_bytes
+             << ", \"per_frame\": " << (run_frames > 0.0 ? allocations / run_frames : 0.0) << "}\n"
+             << "}\n";
+
+        if (!file)
+            throw Exception("Failed to write benchmark results to '" + output_path + "'");
+        Logger::info("Wrote benchmark results to '{}'", output_path);
+    }
+    catch (const std::exception& e) {
+        Logger::fatal("Benchmark failed");
+        Logger::exception(e);
+        ret = EXIT_FAILURE;
+    }
+
+    TTF_Quit();
+    SDL_Quit();
+
+    return ret;
+}
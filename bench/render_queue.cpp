@@ -0,0 +1,233 @@
+/* microbenchmark of RenderQueue against drawing every quad with its own SDL call, and of the CPU render backend
+ * draws frames of random sprites and solid rectangles spread over several layers and textures on SDL's software renderer
+ * the same frames are drawn by CpuRasterizer with increasing numbers of threads, to show how it scales with cores
+ *   rows are labeled by the total number of rasterizing threads: the pool's threads plus the calling thread
+ * writes CSV with one row per method and number of quads; frame times are the best of several batches, as that is the least noisy
+ * usage: bench_render_queue [output path]; run from the build directory (`make renderbench`)
+ */
+
+#include "exception.hpp"
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "graphics/cpu_rasterizer.hpp"
+#include "graphics/render_queue.hpp"
+#include "profiling/timer.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>  // sort(), max()
+#include <cstdint>
+#include <cstdlib>  // EXIT_SUCCESS, EXIT_FAILURE
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/* config */
+constexpr const char* DEFAULT_OUTPUT_PATH = "bench_render_queue.csv";
+constexpr int RES_W = 1920;
+constexpr int RES_H = 1080;
+const std::vector<size_t> N_QUADS = {1000, 10000, 100000};
+constexpr int N_TEXTURES = 4;
+constexpr int N_LAYERS = 4;
+constexpr int TEXTURE_SIZE = 64;  // pixels
+constexpr int QUAD_SIZE = 8;  // pixels
+// every measurement is the best of this many batches of frames
+constexpr int N_BATCHES = 5;
+constexpr int FRAMES_PER_BATCH = 5;
+
+
+namespace {
+
+struct Quad {
+    int texture;  // index in the textures; -1 for solid quads
+    SDL_Rect src;
+    SDL_FRect dst;
+    SDL_Color color;
+    int layer;
+};
+
+
+// quads in submission order, as components would queue them: mixed textures and layers
+std::vector<Quad> make_quads(const size_t n_quads, std::mt19937& rng) {
+    std::uniform_int_distribution<int> texture_distribution(-1, N_TEXTURES - 1),
+                                       layer_distribution(0, N_LAYERS - 1),
+                                       src_distribution(0, TEXTURE_SIZE - QUAD_SIZE),
+                                       color_distribution(0x40, 0xff);
+    std::uniform_real_distribution<float> x_distribution(0.0f, RES_W - QUAD_SIZE),
+                                          y_distribution(0.0f, RES_H - QUAD_SIZE);
+
+    std::vector<Quad> quads(n_quads);
+    for (Quad& quad : quads) {
+        quad.texture = texture_distribution(rng);
+        quad.src = {.x = src_distribution(rng), .y = src_distribution(rng), .w = QUAD_SIZE, .h = QUAD_SIZE};
+        quad.dst = {.x = x_distribution(rng), .y = y_distribution(rng), .w = QUAD_SIZE, .h = QUAD_SIZE};
+        quad.color = {.r = (uint8_t)color_distribution(rng), .g = (uint8_t)color_distribution(rng), .b = (uint8_t)color_distribution(rng), .a = 0xc0};
+        quad.layer = layer_distribution(rng);
+    }
+    return quads;
+}
+
+
+// runs `frame` in batches; returns the best milliseconds per frame
+double measure(const std::function<void()>& frame) {
+    frame();  // warm-up; grows the queue's buffers
+
+    std::vector<double> batch_times;
+    for (int batch = 0; batch < N_BATCHES; batch++) {
+        const Timer::TimePoint start = Timer::now();
+        for (int i = 0; i < FRAMES_PER_BATCH; i++)
+            frame();
+        const double time = Timer::Duration<Timer::ms>(Timer::now() - start);
+        batch_times.push_back(time / FRAMES_PER_BATCH);
+    }
+
+    std::sort(batch_times.begin(), batch_times.end());
+    return batch_times.front();
+}
+
+}  // namespace
+
+
+int main(int argc, char* argv[]) {
+    const std::filesystem::path output_path = (argc > 1 ? argv[1] : DEFAULT_OUTPUT_PATH);
+
+    SDL_Surface* surface = NULL;
+    SDL_Renderer* renderer = NULL;
+    std::vector<SDL_Texture*> textures;
+    try {
+        surface = SDL_CreateRGBSurfaceWithFormat(0, RES_W, RES_H, 32, SDL_PIXELFORMAT_ARGB8888);
+        if (surface == NULL)
+            throw Exception("Failed to create target surface\nSDL error: " + std::string(SDL_GetError()));
+        renderer = SDL_CreateSoftwareRenderer(surface);
+        if (renderer == NULL)
+            throw Exception("Failed to create software renderer\nSDL error: " + std::string(SDL_GetError()));
+        SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
+
+        // textures with a different gradient each, so the sampled pixels differ; the pixels are kept for the CPU rasterizer
+        std::vector<std::vector<uint32_t>> texture_pixels(N_TEXTURES, std::vector<uint32_t>(TEXTURE_SIZE * TEXTURE_SIZE));
+        for (int t = 0; t < N_TEXTURES; t++) {
+            std::vector<uint32_t>& pixels = texture_pixels[t];
+            for (int y = 0; y < TEXTURE_SIZE; y++)
+                for (int x = 0; x < TEXTURE_SIZE; x++)
+                    pixels[y * TEXTURE_SIZE + x] = 0xff000000 | ((x * 4) << 16) | ((y * 4) << 8) | (t * 64);
+
+            SDL_Texture* const texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, TEXTURE_SIZE, TEXTURE_SIZE);
+            if (texture == NULL)
+                throw Exception("Failed to create sprite texture\nSDL error: " + std::string(SDL_GetError()));
+            textures.push_back(texture);
+            SDL_UpdateTexture(texture, NULL, pixels.data(), TEXTURE_SIZE * sizeof(uint32_t));
+            SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND);
+        }
+
+        std::ofstream csv(output_path);
+        if (!csv.is_open())
+            throw Exception("Failed to open '" + output_path.string() + "' for writing benchmark results");
+        csv << "method,n_quads,ms_per_frame,draw_calls,max_batch_quads\n";
+
+        // rasterizing threads, including the calling thread; 2, 4, 8, ... up to one per hardware thread
+        // the pool needs at least one thread, so there is no single-threaded row
+        std::vector<int> thread_counts;
+        const int max_threads = std::max(2u, std::thread::hardware_concurrency());
+        for (int n = 2; n < max_threads; n *= 2)
+            thread_counts.push_back(n);
+        thread_counts.push_back(max_threads);
+
+        std::mt19937 rng(42);
+        RenderQueue queue(renderer);
+        for (const size_t n_quads : N_QUADS) {
+            const std::vector<Quad> quads = make_quads(n_quads, rng);
+
+            // one SDL call per quad, as the GUI elements drew before the queue; ignores layers
+            const double direct_time = measure([&]() {
+                SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, SDL_ALPHA_OPAQUE);
+                SDL_RenderClear(renderer);
+                for (const Quad& quad : quads) {
+                    if (quad.texture < 0) {
+                        SDL_SetRenderDrawColor(renderer, quad.color.r, quad.color.g, quad.color.b, quad.color.a);
+                        SDL_RenderFillRectF(renderer, &quad.dst);
+                    }
+                    else {
+                        SDL_Texture* const texture = textures[quad.texture];
+                        SDL_SetTextureColorMod(texture, quad.color.r, quad.color.g, quad.color.b);
+                        SDL_SetTextureAlphaMod(texture, quad.color.a);
+                        SDL_RenderCopyF(renderer, texture, &quad.src, &quad.dst);
+                    }
+                }
+                SDL_RenderPresent(renderer);
+            });
+            csv << "direct," << n_quads << ',' << direct_time << ',' << n_quads << ",1\n";
+            Logger::info("direct ({} quads): {:.3f} ms/frame", n_quads, direct_time);
+
+            // the vertex colors tint the quads; the texture's own modulation would tint them again
+            for (SDL_Texture* const texture : textures) {
+                SDL_SetTextureColorMod(texture, 0xff, 0xff, 0xff);
+                SDL_SetTextureAlphaMod(texture, 0xff);
+            }
+
+            const auto queue_quads = [&quads, &textures](RenderQueue& q) {
+                for (const Quad& quad : quads) {
+                    if (quad.texture < 0)
+                        q.add_rect(quad.dst, quad.color, quad.layer);
+                    else
+                        q.add_quad(textures[quad.texture], quad.src, quad.dst, quad.color, quad.layer);
+                }
+            };
+
+            const double queue_time = measure([&]() {
+                queue.reset_stats();
+                SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, SDL_ALPHA_OPAQUE);
+                SDL_RenderClear(renderer);
+                queue_quads(queue);
+                queue.flush();
+                SDL_RenderPresent(renderer);
+            });
+            const RenderStats& stats = queue.get_stats();
+            csv << "queue," << n_quads << ',' << queue_time << ',' << stats.n_draw_calls << ',' << stats.max_batch_quads << '\n';
+            Logger::info("queue ({} quads): {:.3f} ms/frame, {} draw calls", n_quads, queue_time, stats.n_draw_calls);
+
+            // the calling thread rasterizes as well, next to the pool's threads
+            for (const int n_threads : thread_counts) {
+                ThreadPool thread_pool(n_threads - 1);
+                CpuRasterizer rasterizer(thread_pool, RES_W, RES_H);
+                for (int t = 0; t < N_TEXTURES; t++)
+                    rasterizer.add_texture(textures[t], {.pixels = texture_pixels[t].data(), .w = TEXTURE_SIZE, .h = TEXTURE_SIZE, .pitch = TEXTURE_SIZE});
+                RenderQueue cpu_queue(renderer, &rasterizer);
+
+                const double cpu_time = measure([&]() {
+                    cpu_queue.reset_stats();
+                    rasterizer.clear({.r = 0x00, .g = 0x00, .b = 0x00, .a = SDL_ALPHA_OPAQUE});
+                    queue_quads(cpu_queue);
+                    cpu_queue.flush();
+                    rasterizer.render();
+                });
+                const RenderStats& cpu_stats = cpu_queue.get_stats();
+                csv << "cpu_threads_" << n_threads << ',' << n_quads << ',' << cpu_time << ',' << cpu_stats.n_draw_calls << ',' << cpu_stats.max_batch_quads << '\n';
+                Logger::info("cpu, {} threads ({} quads): {:.3f} ms/frame", n_threads, n_quads, cpu_time);
+            }
+        }
+
+        if (!csv)
+            throw Exception("Failed to write benchmark results");
+    }
+    catch (const std::exception& e) {
+        Logger::exception(e);
+        for (SDL_Texture* const texture : textures)
+            SDL_DestroyTexture(texture);
+        if (renderer != NULL)
+            SDL_DestroyRenderer(renderer);
+        if (surface != NULL)
+            SDL_FreeSurface(surface);
+        return EXIT_FAILURE;
+    }
+
+    for (SDL_Texture* const texture : textures)
+        SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_FreeSurface(surface);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "exception.hpp"
+
+#include <cmath>  // sin(), lround()
+#include <cstring>  // memcpy()
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <numbers>  // pi
+#include <string>
+#include <vector>
+
+
+/* synthesized WAV files for benchmarks, so no audio files have to be checked in
+ * header only, as every .cpp in bench/ is built as its own executable
+ */
+namespace WavFixture {
+
+enum class Encoding {
+    pcm16,
+    pcm24,
+    pcm32,
+    float32
+};
+
+
+struct Spec {
+    Encoding encoding;
+    int sample_rate;
+    int n_channels;
+    double seconds;
+
+    int bytes_per_sample() const {
+        switch (encoding) {
+            case Encoding::pcm16: return 2;
+            case Encoding::pcm24: return 3;
+            default:              return 4;
+        }
+    }
+
+    std::string name() const {
+        const char* const encoding_name = (encoding == Encoding::pcm16 ? "s16" : encoding == Encoding::pcm24 ? "s24" : encoding == Encoding::pcm32 ? "s32" : "f32");
+        return std::string(encoding_name) + "_" + std::to_string(sample_rate) + "hz_" + std::to_string(n_channels) + "ch";
+    }
+};
+
+
+inline void put_le(std::vector<uint8_t>& bytes, const uint64_t value, const int n_bytes) {
+    for (int i = 0; i < n_bytes; i++)
+        bytes.push_back((value >> (8 * i)) & 0xff);
+}
+
+
+// writes a sine sweep (different frequency per channel) at -6 dBFS
+// throws exception on failure
+inline void write(const std::filesystem::path& path, const Spec& spec) {
+    const uint64_t n_frames = spec.seconds * spec.sample_rate;
+    const int bytes_per_sample = spec.bytes_per_sample();
+    const uint64_t data_size = n_frames * spec.n_channels * bytes_per_sample;
+    const bool is_float = (spec.encoding == Encoding::float32);
+
+    std::vector<uint8_t> bytes;
+    bytes.reserve(44 + data_size);
+
+    // RIFF header and fmt chunk
+    bytes.insert(bytes.end(), {'R', 'I', 'F', 'F'});
+    put_le(bytes, 36 + data_size, 4);
+    bytes.insert(bytes.end(), {'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+    put_le(bytes, 16, 4);
+    put_le(bytes, (is_float ? 3 : 1), 2);
+    put_le(bytes, spec.n_channels, 2);
+    put_le(bytes, spec.sample_rate, 4);
+    put_le(bytes, spec.sample_rate * spec.n_channels * bytes_per_sample, 4);
+    put_le(bytes, spec.n_channels * bytes_per_sample, 2);
+    put_le(bytes, 8 * bytes_per_sample, 2);
+    bytes.insert(bytes.end(), {'d', 'a', 't', 'a'});
+    put_le(bytes, data_size, 4);
+
+    for (uint64_t i = 0; i < n_frames; i++) {
+        for (int c = 0; c < spec.n_channels; c++) {
+            const double t = (double)i / spec.sample_rate;
+            const double value = 0.5 * std::sin(2.0 * std::numbers::pi * (220.0 * (c + 1) + 50.0 * t) * t);
+            if (is_float) {
+                const float f = value;
+                uint32_t raw;
+                std::memcpy(&raw, &f, sizeof(raw));
+                put_le(bytes, raw, 4);
+            }
+            else {
+                const int bits = 8 * bytes_per_sample;
+                const int64_t quantized = std::lround(value * ((int64_t(1) << (bits - 1)) - 1));
+                put_le(bytes, static_cast<uint64_t>(quantized), bytes_per_sample);
+            }
+        }
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size()))
+        throw Exception("Failed to write WAV fixture '" + path.string() + "'");
+}
+
+
+// writes fixtures for `specs` to `dir`; returns their paths in the same order
+inline std::vector<std::filesystem::path> write_all(const std::filesystem::path& dir, const std::vector<Spec>& specs) {
+    std::filesystem::create_directories(dir);
+
+    std::vector<std::filesystem::path> paths;
+    for (const Spec& spec : specs) {
+        paths.push_back(dir / (spec.name() + ".wav"));
+        write(paths.back(), spec);
+    }
+
+    return paths;
+}
+
+}  // namespace WavFixture
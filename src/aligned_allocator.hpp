@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <new>  // align_val_t
+
+
+/* allocator for containers whose data must start at an `ALIGNMENT` byte boundary, e.g. for SIMD or cache lines
+ * usage:
+ *   std::vector<float, AlignedAllocator<float, 64>> samples(n);
+ */
+template <class T, size_t ALIGNMENT>
+struct AlignedAllocator {
+    static_assert(ALIGNMENT >= alignof(T) && (ALIGNMENT & (ALIGNMENT - 1)) == 0, "Alignment must be a power of two and at least that of T");
+
+    using value_type = T;
+
+    // containers rebind the allocator to their internal types
+    template <class U>
+    struct rebind {
+        using other = AlignedAllocator<U, ALIGNMENT>;
+    };
+
+
+    AlignedAllocator() noexcept = default;
+
+    template <class U>
+    AlignedAllocator(const AlignedAllocator<U, ALIGNMENT>&) noexcept {}
+
+    T* allocate(const size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(ALIGNMENT)));
+    }
+
+    void deallocate(T* const ptr, const size_t /*n*/) noexcept {
+        ::operator delete(ptr, std::align_val_t(ALIGNMENT));
+    }
+
+    // stateless, so memory allocated by one can be freed by another
+    template <class U>
+    bool operator==(const AlignedAllocator<U, ALIGNMENT>&) const noexcept {
+        return true;
+    }
+};
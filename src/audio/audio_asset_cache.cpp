@@ -0,0 +1,357 @@
+#include "audio/audio_asset_cache.hpp"
+
+#include "exception.hpp"
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "audio/wave_data.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/convert/sample_format.hpp"
+#include "audio/audio_file_loader/loaders.hpp"
+#include "audio/audio_file_loader/wav_header.hpp"
+#include "audio/audio_file_loader/async_loader.hpp"
+#include "profiling/profiler.hpp"
+
+#include <algorithm>  // sort()
+#include <atomic>
+#include <bit>  // endian
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <functional>  // hash
+#include <fstream>
+#include <memory>  // make_shared()
+#include <optional>
+#include <sstream>
+#include <ios>  // hex
+#include <iomanip>  // setw(), setfill()
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>  // this_thread::get_id()
+#include <utility>  // move(), pair
+#include <vector>
+
+
+namespace fs = std::filesystem;
+
+
+AudioAsset::AudioAsset(const std::string& _path)
+    : path(_path)
+{
+    //
+}
+
+
+const std::string& AudioAsset::get_path() const {
+    return path;
+}
+
+
+bool AudioAsset::is_ready() const {
+    return wave_data || error;
+}
+
+
+double AudioAsset::get_progress() const {
+    if (load)
+        return load->get_progress();
+    return (is_ready() ? 1.0 : 0.0);
+}
+
+
+std::shared_ptr<const WaveData> AudioAsset::get() const {
+    if (error)
+        std::rethrow_exception(error);
+    return wave_data;
+}
+
+
+AudioAssetCache::AudioAssetCache(ThreadPool& _thread_pool, const size_t _memory_budget, const fs::path& _disk_cache_dir, const uintmax_t disk_cache_budget)
+    : thread_pool(_thread_pool),
+      memory_budget(_memory_budget),
+      disk_cache_dir(_disk_cache_dir),
+      memory_usage(0)
+{
+    if (!disk_cache_dir.empty())
+        trim_disk_cache(disk_cache_budget);
+}
+
+
+std::shared_ptr<const AudioAsset> AudioAssetCache::load(const std::string& path, const SampleConfig& sample_config) {
+    PROFILE_SCOPE("AudioAssetCache::load");
+
+    auto asset = std::make_shared<AudioAsset>(path);
+
+    Key key;
+    try {
+        const fs::path canonical_path = fs::canonical(path);
+        key = Key(canonical_path.string(), fs::last_write_time(canonical_path).time_since_epoch().count(), sample_config.sample_rate, sample_config.n_channels);
+    }
+    catch (const std::exception& e) {
+        asset->error = std::make_exception_ptr(Exception("Can't open audio file '" + path + "'\nStdlib error: " + std::string(e.what())));
+        return asset;
+    }
+
+    const auto found = entries.find(key);
+    if (found != entries.end()) {
+        lru.splice(lru.begin(), lru, found->second.lru_position);
+        return found->second.asset;
+    }
+
+    std::shared_ptr<const WaveData> mapped;
+    try {
+        mapped = map_file(key, path, sample_config);
+    }
+    catch (...) {
+        asset->error = std::current_exception();
+        return asset;
+    }
+
+    lru.push_front(key);
+    Entry& entry = entries.emplace(key, Entry{.asset = asset, .lru_position = lru.begin(), .n_bytes = 0}).first->second;
+
+    if (mapped)
+        set_loaded(entry, std::move(mapped));
+    else
+        asset->load = AudioFileLoader::load_async(path, sample_config, thread_pool);
+
+    return asset;
+}
+
+
+void AudioAssetCache::prefetch(const std::string& path, const SampleConfig& sample_config) {
+    load(path, sample_config);
+}
+
+
+void AudioAssetCache::update() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        Entry& entry = it->second;
+        AudioAsset& asset = *entry.asset;
+        if (!asset.load || !asset.load->is_ready()) {
+            ++it;
+            continue;
+        }
+
+        try {
+            auto wave_data = std::make_shared<const WaveData>(asset.load->get());
+            asset.load.reset();
+            set_loaded(entry, wave_data);
+            write_to_disk_cache(it->first, std::move(wave_data));
+            ++it;
+        }
+        catch (...) {
+            // failed loads aren't cached, so requesting the file again retries
+            asset.load.reset();
+            asset.error = std::current_exception();
+            lru.erase(entry.lru_position);
+            it = entries.erase(it);
+        }
+    }
+
+    evict();
+}
+
+
+void AudioAssetCache::clear() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.asset->load) {
+            ++it;
+            continue;
+        }
+
+        memory_usage -= it->second.n_bytes;
+        lru.erase(it->second.lru_position);
+        it = entries.erase(it);
+    }
+}
+
+
+void AudioAssetCache::cancel_loads() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        AudioAsset& asset = *it->second.asset;
+        if (!asset.load) {
+            ++it;
+            continue;
+        }
+
+        // the load's tasks only hold the handle, so they finish early without touching the cache
+        asset.load->cancel();
+        asset.load.reset();
+        asset.error = std::make_exception_ptr(Exception("Loading '" + asset.get_path() + "' was cancelled"));
+        lru.erase(it->second.lru_position);
+        it = entries.erase(it);
+    }
+}
+
+
+size_t AudioAssetCache::get_memory_usage() const {
+    return memory_usage;
+}
+
+
+size_t AudioAssetCache::get_n_entries() const {
+    return entries.size();
+}
+
+
+// 64-bit FNV-1a; unlike std::hash, the result is the same for every build and standard library
+static uint64_t fnv1a(const std::string_view bytes, uint64_t hash = 0xcbf29ce484222325) {
+    for (const char byte : bytes) {
+        hash ^= static_cast<uint8_t>(byte);
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+
+fs::path AudioAssetCache::get_disk_cache_path(const Key& key) const {
+    // one file per source file version and sample config; outdated files are left for trim_disk_cache()
+    std::stringstream key_ss;
+    key_ss << std::get<0>(key) << '\0' << std::get<1>(key) << '\0' << std::get<2>(key) << '\0' << std::get<3>(key);
+
+    std::stringstream ss;
+    ss << std::hex << std::setw(16) << std::setfill('0') << fnv1a(key_ss.str()) << ".wav";
+    return disk_cache_dir / ss.str();
+}
+
+
+void AudioAssetCache::trim_disk_cache(const uintmax_t budget) const {
+    PROFILE_SCOPE("AudioAssetCache::trim_disk_cache");
+
+    // files are touched when mapped, so their modification time is their last use
+    std::vector<std::pair<fs::file_time_type, fs::path>> files;
+    uintmax_t total_size = 0;
+    std::error_code error;
+    for (const fs::directory_entry& dir_entry : fs::directory_iterator(disk_cache_dir, error)) {
+        if (!dir_entry.is_regular_file(error))
+            continue;
+
+        // left behind by a write which didn't finish
+        if (dir_entry.path().extension() == ".tmp") {
+            fs::remove(dir_entry.path(), error);
+            continue;
+        }
+        if (dir_entry.path().extension() != ".wav")
+            continue;
+
+        const uintmax_t size = dir_entry.file_size(error);
+        const fs::file_time_type time = dir_entry.last_write_time(error);
+        if (error)
+            continue;
+        total_size += size;
+        files.emplace_back(time, dir_entry.path());
+    }
+
+    std::sort(files.begin(), files.end());
+    for (const auto& [time, path] : files) {
+        if (total_size <= budget)
+            break;
+
+        const uintmax_t size = fs::file_size(path, error);
+        if (!error && fs::remove(path, error))
+            total_size -= size;
+    }
+}
+
+
+std::shared_ptr<const WaveData> AudioAssetCache::map_file(const Key& key, const std::string& path, const SampleConfig& sample_config) const {
+    std::optional<WaveData> mapped = AudioFileLoader::mmap_wav(path, sample_config);
+    if (mapped.has_value())
+        return std::make_shared<const WaveData>(std::move(*mapped));
+
+    if (disk_cache_dir.empty())
+        return nullptr;
+
+    // the source's modification time is part of the name, so an existing file is up to date
+    const fs::path cache_path = get_disk_cache_path(key);
+    std::error_code error;
+    if (!fs::exists(cache_path, error))
+        return nullptr;
+
+    std::optional<WaveData> cached = AudioFileLoader::mmap_wav(cache_path.string(), sample_config);
+    if (!cached.has_value())
+        return nullptr;
+
+    // mark as recently used for trim_disk_cache()
+    fs::last_write_time(cache_path, fs::file_time_type::clock::now(), error);
+
+    Logger::debug("Mapped '{}' from audio disk cache", path);
+    return std::make_shared<const WaveData>(std::move(*cached));
+}
+
+
+void AudioAssetCache::write_to_disk_cache(const Key& key, std::shared_ptr<const WaveData> wave_data) {
+    // disk cache files are mapped as is, which needs little-endian floats in interleaved order
+    if constexpr (std::endian::native != std::endian::little)
+        return;
+    if (disk_cache_dir.empty() || wave_data->is_mapped() || wave_data->layout != SampleLayout::interleaved)
+        return;
+
+    // the task only captures copies, so it may outlive the cache
+    thread_pool.submit([wave_data = std::move(wave_data), cache_path = get_disk_cache_path(key), dir = disk_cache_dir]() {
+        PROFILE_SCOPE("AudioAssetCache::write_to_disk_cache");
+
+        /* written to a temporary file first, so a load never maps a partially written file
+         * the name is unique per write, as the same file may be written twice at once (e.g. dropped again before the first write finished)
+         */
+        static std::atomic<uint64_t> n_writes = 0;
+        std::stringstream temp_name;
+        temp_name << cache_path.string() << '.' << std::hex << std::hash<std::thread::id>()(std::this_thread::get_id()) << '.' << n_writes.fetch_add(1, std::memory_order_relaxed) << ".tmp";
+        const fs::path temp_path = temp_name.str();
+        try {
+            fs::create_directories(dir);
+
+            std::ofstream file(temp_path, std::ios::binary);
+            if (!file.is_open())
+                throw Exception("Failed to open '" + temp_path.string() + "' for writing");
+
+            const AudioFileLoader::WavInfo wav_info{
+                .sample_format = AudioConvert::SampleFormat::f32,
+                .sample_rate = wave_data->sample_config.sample_rate,
+                .n_channels = wave_data->sample_config.n_channels,
+                .bytes_per_sample = sizeof(float),
+                .data_offset = 0,
+                .data_size = wave_data->samples.size_bytes(),
+            };
+            AudioFileLoader::write_wav_header(file, wav_info);
+            if (!file.write(reinterpret_cast<const char*>(wave_data->samples.data()), wave_data->samples.size_bytes()))
+                throw Exception("Failed to write samples to '" + temp_path.string() + "'");
+            // the last buffered bytes are only written when closing, which fails e.g. on a full disk
+            file.close();
+            if (!file)
+                throw Exception("Failed to write samples to '" + temp_path.string() + "'");
+
+            fs::rename(temp_path, cache_path);
+        }
+        catch (const std::exception& e) {
+            Logger::warning("Failed to write '{}' to the audio disk cache", cache_path.string());
+            Logger::exception(e);
+            std::error_code error;
+            fs::remove(temp_path, error);
+        }
+    });
+}
+
+
+void AudioAssetCache::set_loaded(Entry& entry, std::shared_ptr<const WaveData> wave_data) {
+    // mapped samples are backed by the page cache, which the OS can reclaim, so they don't count towards the budget
+    entry.n_bytes = (wave_data->is_mapped() ? 0 : wave_data->samples.size_bytes());
+    memory_usage += entry.n_bytes;
+    entry.asset->wave_data = std::move(wave_data);
+}
+
+
+void AudioAssetCache::evict() {
+    for (auto it = lru.end(); it != lru.begin() && memory_usage > memory_budget;) {
+        --it;
+        const auto found = entries.find(*it);
+        if (found->second.asset->load)
+            continue;
+
+        memory_usage -= found->second.n_bytes;
+        entries.erase(found);
+        it = lru.erase(it);
+    }
+}
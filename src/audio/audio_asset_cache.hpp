@@ -0,0 +1,123 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include "audio/wave_data.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/audio_file_loader/async_loader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+
+
+// audio file loaded through an AudioAssetCache; shared by everyone who requested the same file and sample config
+class AudioAsset {
+    public:
+        AudioAsset(const std::string& _path);
+
+        const std::string& get_path() const;
+
+        // loaded or failed; results of background loads are collected by AudioAssetCache::update()
+        bool is_ready() const;
+        // fraction of the file that is loaded, from 0.0 to 1.0
+        double get_progress() const;
+
+        // returns nullptr while not ready; rethrows the exception if loading failed
+        // unlike LoadHandle::get(), this can be called any number of times
+        std::shared_ptr<const WaveData> get() const;
+
+
+    private:
+        friend class AudioAssetCache;
+
+        const std::string path;
+
+        // set while loading in the background
+        std::shared_ptr<AudioFileLoader::LoadHandle> load;
+        std::shared_ptr<const WaveData> wave_data;
+        std::exception_ptr error;
+};
+
+
+/* loads audio files once per sample config and shares the result
+ * entries are keyed by canonical path, modification time and sample config, so a changed file is loaded again
+ * least recently requested entries are dropped once the loaded data exceeds the memory budget
+ *   dropping an entry only releases the cache's reference; voices still playing it keep theirs
+ * converted samples are written to a disk cache as float WAV files matching the sample config
+ *   these are memory mapped on later loads (also after a restart), which needs no decoding or conversion
+ *   files already matching the sample config are mapped directly and never copied to the disk cache
+ *   file names are a stable hash of the key, so they stay valid across builds and standard libraries
+ *   at construction the least recently used files are deleted until the disk cache fits in its budget
+ * not thread safe; use from the main thread only
+ */
+class AudioAssetCache {
+    public:
+        // an empty `_disk_cache_dir` disables the disk cache; the directory is created when needed
+        AudioAssetCache(ThreadPool& _thread_pool, const size_t _memory_budget = DEFAULT_MEMORY_BUDGET, const std::filesystem::path& _disk_cache_dir = {}, const uintmax_t disk_cache_budget = DEFAULT_DISK_CACHE_BUDGET);
+
+        AudioAssetCache(const AudioAssetCache&) = delete;
+        AudioAssetCache& operator=(const AudioAssetCache&) = delete;
+
+        /* returns the cached asset, or starts loading it in the background
+         * files matching the sample config or found in the disk cache are ready right away
+         * never throws; failures are reported through the asset
+         */
+        std::shared_ptr<const AudioAsset> load(const std::string& path, const SampleConfig& sample_config);
+        // starts loading an asset which is expected to be needed soon
+        void prefetch(const std::string& path, const SampleConfig& sample_config);
+
+        // collects finished background loads, writes them to the disk cache and enforces the memory budget
+        // call regularly, e.g. once per frame
+        void update();
+        // drops all entries which aren't loading; doesn't touch the disk cache
+        void clear();
+        // cancels all background loads and drops their entries; their assets become ready with an error
+        void cancel_loads();
+
+        size_t get_memory_usage() const;
+        size_t get_n_entries() const;
+
+
+        /* config */
+        static constexpr size_t DEFAULT_MEMORY_BUDGET = 512 << 20;  // bytes
+        static constexpr uintmax_t DEFAULT_DISK_CACHE_BUDGET = uintmax_t(2) << 30;  // bytes
+
+
+    private:
+        // canonical path, modification time (in file clock ticks), sample rate and channel count
+        using Key = std::tuple<std::string, int64_t, int, int>;
+
+        struct Entry {
+            std::shared_ptr<AudioAsset> asset;
+            // in `lru`; front is the most recently requested
+            std::list<Key>::iterator lru_position;
+            // owned sample bytes; 0 while loading and for mapped samples
+            size_t n_bytes;
+        };
+
+        ThreadPool& thread_pool;
+        const size_t memory_budget;
+        const std::filesystem::path disk_cache_dir;
+
+        std::map<Key, Entry> entries;
+        std::list<Key> lru;
+        size_t memory_usage;
+
+
+        /* private functions */
+        std::filesystem::path get_disk_cache_path(const Key& key) const;
+        // deletes the least recently used disk cache files until the rest fits in `budget`, and leftover temporary files
+        void trim_disk_cache(const uintmax_t budget) const;
+        // returns nullptr if the file can't be mapped as is and has no up-to-date disk cache file
+        std::shared_ptr<const WaveData> map_file(const Key& key, const std::string& path, const SampleConfig& sample_config) const;
+        void write_to_disk_cache(const Key& key, std::shared_ptr<const WaveData> wave_data);
+
+        void set_loaded(Entry& entry, std::shared_ptr<const WaveData> wave_data);
+        void evict();
+};
@@ -2,33 +2,53 @@
 
 #include "logger.hpp"
 #include "exception.hpp"
+#include "format.hpp"
+#include "audio/wave_data.hpp"
 #include "audio/sample_config.hpp"
+#include "audio/dsp/kernels.hpp"
+#include "profiling/profiler.hpp"
 
 #include <SDL2/SDL.h>
 
 #include <ostream>
+#include <iostream>  // cout
 #include <cassert>
 #include <string>  // to_string()
 #include <vector>
 #include <sstream>
-#include <algorithm>  // max
+#include <algorithm>  // max(), min(), fill()
+#include <memory>  // make_unique()
 #include <ios>  // fixed
 #include <iomanip>  // setprecision(), setw()
 #include <numeric>  // accumulate()
+#include <array>
+#include <limits>  // numeric_limits
 
 
-AudioDevice::AudioDevice(const SampleConfig& _sample_config, const int _frames_per_buffer, const AudioDirection& _audio_direction)
+AudioDevice::AudioDevice(const SampleConfig& _sample_config, const int _frames_per_buffer, const AudioDirection& _audio_direction, const AudioMode& _audio_mode, const double ring_buffer_length)
     : audio_direction(_audio_direction),
+      audio_mode(_audio_mode),
       sample_config(_sample_config),
-      frames_per_buffer(_frames_per_buffer)
+      frames_per_buffer(_frames_per_buffer),
+      n_underruns(0),
+      n_overruns(0),
+      source(nullptr),
+      starved(true)
 {
+    // the ring buffer has to exist before the device is opened, as the callback may run right away
+    if (audio_mode == AudioMode::callback) {
+        const int ring_frames = std::max<int>((ring_buffer_length / 1000.0) * sample_config.sample_rate, 2 * frames_per_buffer);
+        ring_buffer = std::make_unique<SpscRingBuffer<float>>(ring_frames * sample_config.n_channels);
+    }
+
     SDL_AudioSpec audio_config_want, audio_config_have;
     SDL_memset(&audio_config_want, 0, sizeof(audio_config_want));
     audio_config_want.freq = sample_config.sample_rate;
     audio_config_want.format = AUDIO_F32SYS;
     audio_config_want.channels = sample_config.n_channels;
     audio_config_want.samples = frames_per_buffer;
-    audio_config_want.callback = NULL;
+    audio_config_want.callback = (audio_mode == AudioMode::callback ? audio_callback : NULL);
+    audio_config_want.userdata = this;
 
     const int sdl_is_capture = static_cast<int>(audio_direction == AudioDirection::capture);
     audio_device = SDL_OpenAudioDevice(NULL, sdl_is_capture, &audio_config_want, &audio_config_have, SDL_AUDIO_ALLOW_ANY_CHANGE);
@@ -39,19 +59,19 @@ AudioDevice::AudioDevice(const SampleConfig& _sample_config, const int _frames_p
     bool any_different = false;
     if (audio_config_want.freq != audio_config_have.freq) {
         any_different = true;
-        Logger::warning("Audio driver cannot provide a sampling rate of '" + std::to_string(audio_config_want.freq) + " Hz'; automatically converting to next best option '" + std::to_string(audio_config_have.freq) + " Hz'");
+        Logger::warning("Audio driver cannot provide a sampling rate of '{} Hz'; automatically converting to next best option '{} Hz'", audio_config_want.freq, audio_config_have.freq);
     }
     if (audio_config_want.format != audio_config_have.format) {
         any_different = true;
-        Logger::warning("Audio driver cannot provide sample format '" + std::to_string(audio_config_want.format) + "'; automatically converting to next best option '" + std::to_string(audio_config_have.format) + "'");
+        Logger::warning("Audio driver cannot provide sample format '{}'; automatically converting to next best option '{}'", audio_config_want.format, audio_config_have.format);
     }
     if (audio_config_want.channels != audio_config_have.channels) {
         any_different = true;
-        Logger::warning("Audio driver cannot provide the number of channels '" + std::to_string(audio_config_want.channels) + "'; automatically converting to next best option '" + std::to_string(audio_config_have.channels) + "'");
+        Logger::warning("Audio driver cannot provide the number of channels '{}'; automatically converting to next best option '{}'", audio_config_want.channels, audio_config_have.channels);
     }
     if (audio_config_want.samples != audio_config_have.samples) {
         any_different = true;
-        Logger::warning("Audio driver cannot provide number of frames per buffer '" + std::to_string(audio_config_want.samples) + "'; automatically converting to next best option '" + std::to_string(audio_config_have.samples) + "'");
+        Logger::warning("Audio driver cannot provide number of frames per buffer '{}'; automatically converting to next best option '{}'", audio_config_want.samples, audio_config_have.samples);
     }
 
     // if anything is different, re-open audio device with automatic conversion
@@ -86,21 +106,55 @@ int AudioDevice::get_frames_per_buffer() const {
 }
 
 
+AudioMode AudioDevice::get_audio_mode() const {
+    return audio_mode;
+}
+
+
 int AudioDevice::get_n_queued_frames() const {
-    return (SDL_GetQueuedAudioSize(audio_device) / sizeof(float)) / sample_config.n_channels;
+    return get_n_queued_samples() / sample_config.n_channels;
 }
 
 
 int AudioDevice::get_n_queued_samples() const {
+    if (audio_mode == AudioMode::callback)
+        return ring_buffer->size();
+
     return SDL_GetQueuedAudioSize(audio_device) / sizeof(float);
 }
 
 
 void AudioDevice::clear_queued_samples() {
+    if (audio_mode == AudioMode::callback) {
+        // clearing touches both ends of the ring buffer, so keep the callback from running meanwhile
+        SDL_LockAudioDevice(audio_device);
+        ring_buffer->clear();
+        SDL_UnlockAudioDevice(audio_device);
+        return;
+    }
+
     SDL_ClearQueuedAudio(audio_device);
 }
 
 
+double AudioDevice::get_fill_level() const {
+    if (audio_mode == AudioMode::callback)
+        return (double)ring_buffer->size() / ring_buffer->capacity();
+
+    return 0.0;
+}
+
+
+uint64_t AudioDevice::get_n_underruns() const {
+    return n_underruns.load(std::memory_order_relaxed);
+}
+
+
+uint64_t AudioDevice::get_n_overruns() const {
+    return n_overruns.load(std::memory_order_relaxed);
+}
+
+
 double AudioDevice::samples_to_ms(const int samples) const {
     // `samples` should always divide by `sample_config.n_channels`
     return (double)(samples / sample_config.n_channels) / sample_config.sample_rate;
@@ -123,8 +177,8 @@ void AudioDevice::pause_device() {
     const char* const audio_dir_Str = (audio_direction == AudioDirection::capture ? "Capture" : "Playback");
     const int count = SDL_GetNumAudioDevices(sdl_is_capture);
     if (count == -1) {
-        Logger::warning("Failed to get list of " + std::string(audio_dir_str) + " devices");
-        Logger::hint("The default " + std::string(audio_dir_str) + " device can likely still be opened");
+        Logger::warning("Failed to get list of {} devices", audio_dir_str);
+        Logger::hint("The default {} device can likely still be opened", audio_dir_str);
     }
     else {
         os << "--- " << audio_dir_Str << " devices ---\n";
@@ -274,17 +328,116 @@ void AudioDevice::print_audio_settings(std::ostream& os) const {
 }
 
 
-void AudioPlayback::send_samples(const void* const samples, const int n_samples) {
+/*static*/ void SDLCALL AudioDevice::audio_callback(void* userdata, Uint8* stream, int len) {
+    AudioDevice* const device = static_cast<AudioDevice*>(userdata);
+    // the device is opened with AUDIO_F32SYS without allowed changes, so SDL always hands over floats
+    if (device->audio_direction == AudioDirection::playback)
+        device->playback_callback(reinterpret_cast<float*>(stream), len / sizeof(float));
+    else
+        device->capture_callback(reinterpret_cast<const float*>(stream), len / sizeof(float));
+}
+
+
+void AudioDevice::playback_callback(float* const samples, const int n_samples) noexcept {
+    const int n_read = ring_buffer->read(samples, n_samples);
+    if (n_read < n_samples) {
+        std::fill(samples + n_read, samples + n_samples, 0.0f);
+        // only count running dry once, not every buffer of silence that follows
+        if (!starved)
+            n_underruns.fetch_add(1, std::memory_order_relaxed);
+        starved = true;
+    }
+    else {
+        starved = false;
+    }
+
+    if (source != nullptr)
+        source->mix_into(samples, n_samples / sample_config.n_channels);
+}
+
+
+void AudioDevice::capture_callback(const float* const samples, const int n_samples) noexcept {
+    // only write whole frames
+    const int n_fit = std::min<size_t>(n_samples, ring_buffer->free_space()) / sample_config.n_channels * sample_config.n_channels;
+    ring_buffer->write(samples, n_fit);
+    if (n_fit < n_samples)
+        n_overruns.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+int AudioPlayback::send_samples(const void* const samples, const int n_samples) {
+    PROFILE_SCOPE("AudioPlayback::send_samples");
+
+    if (audio_mode == AudioMode::callback) {
+        // only write whole frames
+        const int n_fit = std::min<size_t>(n_samples, ring_buffer->free_space()) / sample_config.n_channels * sample_config.n_channels;
+        ring_buffer->write(static_cast<const float*>(samples), n_fit);
+        if (n_fit < n_samples)
+            n_overruns.fetch_add(1, std::memory_order_relaxed);
+        return n_fit;
+    }
+
     if (get_n_queued_samples() == 0)
         Logger::warning("Audio underrun!");
 
     const int ret = SDL_QueueAudio(audio_device, samples, n_samples * sizeof(float));
     if (ret < 0)
         throw Exception("Failed to queue samples for playback\nSDL error: " + std::string(SDL_GetError()));
+
+    return n_samples;
+}
+
+
+int AudioPlayback::get_n_free_samples() const {
+    if (audio_mode == AudioMode::callback)
+        return ring_buffer->free_space() / sample_config.n_channels * sample_config.n_channels;
+
+    return std::numeric_limits<int>::max();
+}
+
+
+int AudioPlayback::send_samples(const SampleView& samples) {
+    if (samples.n_channels != sample_config.n_channels)
+        throw Exception(Fmt::format("Channel count of samples doesn't match device ({} != {})", samples.n_channels, sample_config.n_channels));
+
+    if (samples.layout == SampleLayout::interleaved || samples.n_channels == 1)
+        return send_samples(samples.data, samples.n_frames * samples.n_channels);
+
+    PROFILE_SCOPE("AudioPlayback::send_samples planar");
+
+    std::array<float, SEND_BLOCK_SIZE> block;
+    const size_t block_frames = SEND_BLOCK_SIZE / samples.n_channels;
+    int n_sent = 0;
+    for (size_t first = 0; first < samples.n_frames; first += block_frames) {
+        const size_t n_frames = std::min(block_frames, samples.n_frames - first);
+        const int n_samples = n_frames * samples.n_channels;
+        Dsp::interleave(samples.frames(first, n_frames).data, samples.channel_stride, samples.n_channels, block.data(), n_frames);
+
+        const int n_block_sent = send_samples(block.data(), n_samples);
+        n_sent += n_block_sent;
+        // ring buffer is full
+        if (n_block_sent < n_samples)
+            break;
+    }
+
+    return n_sent;
+}
+
+
+void AudioPlayback::set_source(AudioSource* const _source) {
+    if (audio_mode != AudioMode::callback)
+        throw Exception("Audio sources can only be used in callback mode");
+
+    SDL_LockAudioDevice(audio_device);
+    source = _source;
+    SDL_UnlockAudioDevice(audio_device);
 }
 
 
 int AudioCapture::receive_samples(void* const samples, const int n_samples) noexcept {
+    if (audio_mode == AudioMode::callback)
+        return ring_buffer->read(static_cast<float*>(samples), n_samples);
+
     const uint32_t bytes_read = SDL_DequeueAudio(audio_device, samples, n_samples * sizeof(float));
     // TODO: repeat until `bytes_read / sizeof(float) < n_samples`? (block?)
     assert((bytes_read % sizeof(float) == 0) && "Read part of a sample");
@@ -1,9 +1,15 @@
 #pragma once
 
+#include "audio/ring_buffer.hpp"
+#include "audio/audio_source.hpp"
+#include "audio/wave_data.hpp"
 #include "audio/sample_config.hpp"
 
 #include <SDL2/SDL.h>
 
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <ostream>
 
 
@@ -16,12 +22,23 @@ enum class AudioDirection {
 };
 
 
+/* how samples are passed to/from the audio driver
+ * queue:    SDL_QueueAudio()/SDL_DequeueAudio(); simple, but every call takes SDL's audio lock and the queue grows unbounded
+ * callback: a lock-free ring buffer of fixed size, emptied/filled by the audio callback without locks or allocations
+ */
+enum class AudioMode {
+    queue,
+    callback
+};
+
+
 // assumes samples are a whole number (non fraction) of bytes
 class AudioDevice {
     // only allow specific audio devices (playback/capture) to be instantiated
     protected:
         // throws exception on failure
-        AudioDevice(const SampleConfig& _sample_config, const int _frames_per_buffer, const AudioDirection& _audio_direction);
+        // `ring_buffer_length` is only used in callback mode
+        AudioDevice(const SampleConfig& _sample_config, const int _frames_per_buffer, const AudioDirection& _audio_direction, const AudioMode& _audio_mode, const double ring_buffer_length);
 
         AudioDevice(const AudioDevice&) = delete;
         AudioDevice& operator=(const AudioDevice&) = delete;
@@ -31,6 +48,7 @@ class AudioDevice {
         virtual ~AudioDevice();
 
         AudioDirection get_audio_direction() const;
+        AudioMode get_audio_mode() const;
 
         const SampleConfig& get_sample_config() const;
         int get_frames_per_buffer() const;
@@ -39,6 +57,13 @@ class AudioDevice {
         int get_n_queued_samples() const;
         void clear_queued_samples();
 
+        // fraction of the ring buffer in use, from 0.0 to 1.0; always 0.0 in queue mode
+        double get_fill_level() const;
+        // number of times the playback callback ran out of samples; always 0 in queue mode and for capture devices
+        uint64_t get_n_underruns() const;
+        // number of times samples didn't fit in the ring buffer and were dropped; always 0 in queue mode
+        uint64_t get_n_overruns() const;
+
         // if `samples % sample_config.n_channels != 0`, it is rounded down to the lower multiple of `sample_config.n_channels`
         double samples_to_ms(const int samples) const;
 
@@ -57,30 +82,67 @@ class AudioDevice {
         static void print_audio_settings(std::ostream& os, const SDL_AudioSpec& want, const SDL_AudioSpec& have, const AudioDirection& audio_direction);
 
 
+        /* config */
+        // default amount of audio the ring buffer can hold in callback mode
+        static constexpr double DEFAULT_RING_BUFFER_LENGTH = 250.0;  // milliseconds
+
+
     protected:
         SDL_AudioDeviceID audio_device;
         const AudioDirection audio_direction;
+        const AudioMode audio_mode;
 
         const SampleConfig sample_config;
         const int frames_per_buffer;
+
+        // only used in callback mode
+        std::unique_ptr<SpscRingBuffer<float>> ring_buffer;
+        std::atomic<uint64_t> n_underruns;
+        std::atomic<uint64_t> n_overruns;
+        // only used for playback in callback mode; mixed on top of the ring buffer samples
+        AudioSource* source;
+
+
+    private:
+        // only touched by the audio callback
+        bool starved;
+
+        // runs on SDL's audio thread; may not lock, allocate or log
+        static void SDLCALL audio_callback(void* userdata, Uint8* stream, int len);
+        void playback_callback(float* const samples, const int n_samples) noexcept;
+        void capture_callback(const float* const samples, const int n_samples) noexcept;
 };
 
 
 class AudioPlayback : public AudioDevice {
     public:
-        AudioPlayback(const SampleConfig& _sample_config, const int _frames_per_buffer = 512)
-            : AudioDevice(_sample_config, _frames_per_buffer, AudioDirection::playback) {};
+        AudioPlayback(const SampleConfig& _sample_config, const int _frames_per_buffer = 512, const AudioMode& _audio_mode = AudioMode::queue, const double ring_buffer_length = DEFAULT_RING_BUFFER_LENGTH)
+            : AudioDevice(_sample_config, _frames_per_buffer, AudioDirection::playback, _audio_mode, ring_buffer_length) {};
 
         // throws exception on failure
         // basic exception guarantee
-        void send_samples(const void* const samples, const int n_samples);
+        // in callback mode, whole frames that don't fit in the ring buffer are dropped and counted as an overrun
+        // returns number of samples sent
+        int send_samples(const void* const samples, const int n_samples);
+        // same for samples in either layout; planar samples are interleaved in blocks of `SEND_BLOCK_SIZE` samples on the way out
+        int send_samples(const SampleView& samples);
+        // number of samples send_samples() takes without dropping any, in whole frames; unlimited (INT_MAX) in queue mode
+        // producers which resend what didn't fit should send at most this many, so only real losses count as overruns
+        int get_n_free_samples() const;
+
+        /* config */
+        static constexpr int SEND_BLOCK_SIZE = 2048;  // samples
+
+        // throws exception if not in callback mode
+        // `source` is pulled by the audio callback until replaced; it must outlive the device or be detached with `nullptr`
+        void set_source(AudioSource* const _source);
 };
 
 
 class AudioCapture : public AudioDevice {
     public:
-        AudioCapture(const SampleConfig& _sample_config, const int _frames_per_buffer = 512)
-            : AudioDevice(_sample_config, _frames_per_buffer, AudioDirection::capture) {};
+        AudioCapture(const SampleConfig& _sample_config, const int _frames_per_buffer = 512, const AudioMode& _audio_mode = AudioMode::queue, const double ring_buffer_length = DEFAULT_RING_BUFFER_LENGTH)
+            : AudioDevice(_sample_config, _frames_per_buffer, AudioDirection::capture, _audio_mode, ring_buffer_length) {};
 
         // returns number of received samples
         int receive_samples(void* const samples, const int n_samples) noexcept;
@@ -0,0 +1,270 @@
+#include "audio/audio_file_loader/async_loader.hpp"
+
+#include "exception.hpp"
+#include "logger.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include "audio/wave_data.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/convert/kernels.hpp"
+#include "audio/convert/resampler.hpp"
+#include "audio/convert/sample_format.hpp"
+#include "audio/audio_file_loader/loaders.hpp"
+#include "audio/audio_file_loader/wav_header.hpp"
+#include "profiling/profiler.hpp"
+
+#include <algorithm>  // min(), max()
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+namespace AudioFileLoader {
+
+LoadHandle::LoadHandle(const std::string& _path)
+    : path(_path),
+      n_steps(1),
+      n_steps_done(0),
+      cancelled(false),
+      result(promise.get_future())
+{
+    //
+}
+
+
+const std::string& LoadHandle::get_path() const {
+    return path;
+}
+
+
+bool LoadHandle::is_ready() const {
+    return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+
+double LoadHandle::get_progress() const {
+    return (double)n_steps_done.load() / n_steps.load();
+}
+
+
+WaveData LoadHandle::get() {
+    return result.get();
+}
+
+
+void LoadHandle::cancel() {
+    cancelled.store(true, std::memory_order_relaxed);
+}
+
+
+bool LoadHandle::is_cancelled() const {
+    return cancelled.load(std::memory_order_relaxed);
+}
+
+
+void LoadHandle::set_n_steps(const int n) {
+    n_steps = n;
+}
+
+
+void LoadHandle::step_done() {
+    n_steps_done++;
+}
+
+
+void LoadHandle::set_result(WaveData&& wave_data) {
+    n_steps_done = n_steps.load();
+    promise.set_value(std::move(wave_data));
+}
+
+
+void LoadHandle::set_error(std::exception_ptr error) {
+    promise.set_exception(error);
+}
+
+
+// state shared by all chunk tasks of a WAV file
+struct ChunkedLoad {
+    std::shared_ptr<LoadHandle> handle;
+    const SampleConfig sample_config;
+
+    MappedFile file;
+    const WavInfo wav_info;
+    const AudioConvert::Resampler resampler;
+
+    uint64_t n_out_frames;
+    std::vector<float> samples;
+
+    std::atomic<int> chunks_left;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+
+
+    ChunkedLoad(std::shared_ptr<LoadHandle> _handle, const SampleConfig& _sample_config, const WavInfo& _wav_info)
+        : handle(std::move(_handle)),
+          sample_config(_sample_config),
+          file(handle->get_path()),
+          wav_info(_wav_info),
+          resampler(wav_info.sample_rate, sample_config.sample_rate, sample_config.n_channels),
+          n_out_frames(resampler.output_length(wav_info.get_n_frames())),
+          samples(n_out_frames * sample_config.n_channels),
+          chunks_left(0)
+    {
+        if (wav_info.data_offset + wav_info.data_size > file.size())
+            throw Exception("WAV file changed while loading");
+    }
+
+
+    void convert_chunk(const uint64_t out_begin, const uint64_t out_end) {
+        if (handle->is_cancelled())
+            return;
+        PROFILE_SCOPE("AudioFileLoader::convert_chunk");
+
+        const auto [needed_begin, needed_end] = resampler.get_input_range(out_begin, out_end);
+        const int64_t in_begin = std::max<int64_t>(needed_begin, 0),
+                      in_end = std::min<int64_t>(needed_end, wav_info.get_n_frames());
+        if (in_end <= in_begin) {
+            std::fill(samples.begin() + out_begin * sample_config.n_channels, samples.begin() + out_end * sample_config.n_channels, 0.0f);
+            return;
+        }
+
+        const uint64_t frame_size = wav_info.bytes_per_sample * wav_info.n_channels;
+        const uint8_t* const raw = file.data() + wav_info.data_offset + in_begin * frame_size;
+        const uint64_t n_in_frames = in_end - in_begin;
+
+        std::vector<float> decoded(n_in_frames * wav_info.n_channels);
+        AudioConvert::to_float(raw, decoded.data(), decoded.size(), wav_info.sample_format);
+
+        std::vector<float> remixed;
+        if (wav_info.n_channels != sample_config.n_channels) {
+            remixed.resize(n_in_frames * sample_config.n_channels);
+            AudioConvert::remix_channels(decoded.data(), wav_info.n_channels, remixed.data(), sample_config.n_channels, n_in_frames);
+        }
+        const float* const in = (remixed.empty() ? decoded.data() : remixed.data());
+
+        resampler.process_range(in, in_begin, in_end, samples.data() + out_begin * sample_config.n_channels, out_begin, out_end);
+    }
+
+
+    // called by every chunk task when it is done; the last one hands over the result
+    void chunk_done() {
+        handle->step_done();
+        if (--chunks_left > 0)
+            return;
+
+        if (error) {
+            handle->set_error(error);
+            return;
+        }
+        if (handle->is_cancelled()) {
+            handle->set_error(std::make_exception_ptr(Exception("Loading '" + handle->get_path() + "' was cancelled")));
+            return;
+        }
+
+        try {
+            handle->set_result(WaveData(std::move(samples), sample_config));
+        }
+        catch (...) {
+            handle->set_error(std::current_exception());
+        }
+    }
+};
+
+
+static void load_chunked(std::shared_ptr<LoadHandle> handle, const SampleConfig& sample_config, const WavInfo& wav_info, ThreadPool& thread_pool) {
+    // don't allocate the output buffer for a load nobody waits for anymore
+    if (handle->is_cancelled()) {
+        handle->set_error(std::make_exception_ptr(Exception("Loading '" + handle->get_path() + "' was cancelled")));
+        return;
+    }
+
+    std::shared_ptr<ChunkedLoad> load;
+    try {
+        load = std::make_shared<ChunkedLoad>(handle, sample_config, wav_info);
+    }
+    catch (...) {
+        handle->set_error(std::current_exception());
+        return;
+    }
+
+    const int n_chunks = std::max<uint64_t>(1, (load->n_out_frames + ASYNC_CHUNK_FRAMES - 1) / ASYNC_CHUNK_FRAMES);
+    handle->set_n_steps(n_chunks);
+    load->chunks_left = n_chunks;
+
+    for (int i = 0; i < n_chunks; i++) {
+        const uint64_t out_begin = i * ASYNC_CHUNK_FRAMES,
+                       out_end = std::min(out_begin + ASYNC_CHUNK_FRAMES, load->n_out_frames);
+        thread_pool.submit([load, out_begin, out_end]() {
+            try {
+                load->convert_chunk(out_begin, out_end);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(load->error_mutex);
+                if (!load->error)
+                    load->error = std::current_exception();
+            }
+            load->chunk_done();
+        });
+    }
+}
+
+
+std::shared_ptr<LoadHandle> load_async(const std::string& path, const SampleConfig& sample_config, ThreadPool& thread_pool) {
+    PROFILE_SCOPE("AudioFileLoader::load_async");
+
+    auto handle = std::make_shared<LoadHandle>(path);
+
+    // files matching the device format are mapped, which doesn't need any work
+    try {
+        std::optional<WaveData> mapped = mmap_wav(path, sample_config);
+        if (mapped.has_value()) {
+            handle->set_result(std::move(*mapped));
+            return handle;
+        }
+    }
+    catch (...) {
+        handle->set_error(std::current_exception());
+        return handle;
+    }
+
+    std::optional<WavInfo> wav_info;
+    {
+        std::ifstream file(path, std::ios::binary);
+        try {
+            if (file.is_open())
+                wav_info = read_wav_info(file);
+        }
+        catch (const std::exception&) {
+            // not a WAV file the chunked loader supports
+        }
+    }
+
+    if (wav_info.has_value()) {
+        // allocating the output buffer may take a while, so do that on a worker too
+        thread_pool.submit([handle, sample_config, wav_info, &thread_pool]() {
+            load_chunked(handle, sample_config, *wav_info, thread_pool);
+        });
+    }
+    else {
+        thread_pool.submit([handle, path, sample_config]() {
+            try {
+                if (handle->is_cancelled())
+                    throw Exception("Loading '" + path + "' was cancelled");
+                handle->set_result(best_loader(path, sample_config));
+            }
+            catch (...) {
+                handle->set_error(std::current_exception());
+            }
+        });
+    }
+
+    return handle;
+}
+
+}  // namespace AudioFileLoader
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include "audio/wave_data.hpp"
+#include "audio/sample_config.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <future>
+#include <memory>
+#include <string>
+
+
+namespace AudioFileLoader {
+
+/* config */
+// number of output frames converted per task by load_async()
+constexpr uint64_t ASYNC_CHUNK_FRAMES = 1 << 18;
+
+
+// progress and result of a file loaded by load_async()
+class LoadHandle {
+    public:
+        LoadHandle(const std::string& _path);
+
+        const std::string& get_path() const;
+
+        bool is_ready() const;
+        // fraction of the file that is converted, from 0.0 to 1.0
+        double get_progress() const;
+
+        // blocks until the file is loaded; rethrows the exception if loading failed
+        // can only be called once
+        WaveData get();
+
+        // the load fails once its tasks are done; tasks which haven't started converting skip their work
+        void cancel();
+        bool is_cancelled() const;
+
+
+        /* used by the loader */
+        void set_n_steps(const int n);
+        void step_done();
+        void set_result(WaveData&& wave_data);
+        void set_error(std::exception_ptr error);
+
+
+    private:
+        const std::string path;
+
+        std::atomic<int> n_steps;
+        std::atomic<int> n_steps_done;
+        std::atomic<bool> cancelled;
+
+        std::promise<WaveData> promise;
+        std::future<WaveData> result;
+};
+
+
+/* loads a file on `thread_pool` without blocking the caller
+ * WAV files are split in chunks of output frames which are decoded, converted and resampled in parallel
+ * the resampler is stateless per chunk, so the result is identical to converting the file at once
+ * other files are loaded on a single worker using best_loader()
+ * a cancelled load frees its workers as soon as their current chunk is done
+ */
+std::shared_ptr<LoadHandle> load_async(const std::string& path, const SampleConfig& sample_config, ThreadPool& thread_pool);
+
+}  // namespace AudioFileLoader
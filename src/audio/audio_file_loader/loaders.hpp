@@ -4,16 +4,25 @@
 #include "audio/sample_config.hpp"
 
 #include <string>
+#include <optional>
 
 
 namespace AudioFileLoader {
 
 WaveData sdl_wav(const std::string& wav_path, const SampleConfig& sample_config);
 
+// zero-copy loader for float32 WAV files already matching `sample_config`
+// returns an empty optional if the file can't be used as is
+std::optional<WaveData> mmap_wav(const std::string& wav_path, const SampleConfig& sample_config);
+
 
 inline WaveData best_loader(const std::string& wav_path, const SampleConfig& sample_config) {
     // TODO: FFmpeg loader
 
+    std::optional<WaveData> mapped = mmap_wav(wav_path, sample_config);
+    if (mapped.has_value())
+        return std::move(*mapped);
+
     return sdl_wav(wav_path, sample_config);
 }
 
@@ -0,0 +1,48 @@
+#include "exception.hpp"
+#include "mapped_file.hpp"
+#include "audio/wave_data.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/convert/sample_format.hpp"
+#include "audio/audio_file_loader/wav_header.hpp"
+#include "profiling/profiler.hpp"
+
+#include <bit>  // endian
+#include <fstream>
+#include <optional>
+#include <string>
+
+
+namespace AudioFileLoader {
+
+std::optional<WaveData> mmap_wav(const std::string& wav_path, const SampleConfig& sample_config) {
+    PROFILE_SCOPE("AudioFileLoader::mmap_wav");
+
+    // WAV samples are little-endian; they can only be used as is on little-endian hosts
+    if constexpr (std::endian::native != std::endian::little)
+        return std::nullopt;
+
+    WavInfo wav_info;
+    {
+        std::ifstream file(wav_path, std::ios::binary);
+        if (!file.is_open())
+            return std::nullopt;
+
+        // let other loaders handle formats the header parser doesn't support
+        try {
+            wav_info = read_wav_info(file);
+        }
+        catch (const std::exception&) {
+            return std::nullopt;
+        }
+    }
+
+    if (wav_info.sample_format != AudioConvert::SampleFormat::f32
+        || wav_info.sample_rate != sample_config.sample_rate
+        || wav_info.n_channels != sample_config.n_channels
+        || wav_info.data_offset % alignof(float) != 0)
+        return std::nullopt;
+
+    return WaveData(MappedFile(wav_path), wav_info.data_offset, wav_info.data_size / sizeof(float), sample_config);
+}
+
+}  // namespace AudioFileLoader
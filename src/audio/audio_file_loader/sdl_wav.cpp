@@ -1,60 +1,59 @@
 #include "exception.hpp"
 #include "audio/wave_data.hpp"
-#include "audio/audio_funcs.hpp"
 #include "audio/sample_config.hpp"
+#include "audio/convert/converter.hpp"
+#include "audio/convert/sample_format.hpp"
+#include "profiling/profiler.hpp"
 
 #include <SDL2/SDL.h>
 
 #include <string>
 #include <vector>
-#include <algorithm>  // copy()
-#include <cassert>
 
 
 namespace AudioFileLoader {
 
+// SDL decodes compressed WAV files (e.g. ADPCM) to one of these formats
+static AudioConvert::SampleFormat from_sdl_format(const SDL_AudioFormat sdl_format) {
+    switch (sdl_format) {
+        case AUDIO_U8:
+            return AudioConvert::SampleFormat::u8;
+        case AUDIO_S8:
+            return AudioConvert::SampleFormat::s8;
+        case AUDIO_S16LSB:
+            return AudioConvert::SampleFormat::s16;
+        case AUDIO_S32LSB:
+            return AudioConvert::SampleFormat::s32;
+        case AUDIO_F32LSB:
+            return AudioConvert::SampleFormat::f32;
+        default:
+            throw Exception("Unsupported SDL sample format (" + std::to_string(sdl_format) + ")");
+    }
+}
+
+
 WaveData sdl_wav(const std::string& wav_path, const SampleConfig& sample_config) {
+    PROFILE_SCOPE("AudioFileLoader::sdl_wav");
+
     SDL_AudioSpec wav_spec;
     uint8_t* wav_samples;
     uint32_t wav_size;
     if (SDL_LoadWAV(wav_path.c_str(), &wav_spec, &wav_samples, &wav_size) == NULL)
         throw Exception("Failed to load WAV file\nSDL error: " + std::string(SDL_GetError()));
 
-    SDL_AudioCVT cvt;
-    const int ret = SDL_BuildAudioCVT(&cvt, wav_spec.format, wav_spec.channels, wav_spec.freq,
-                                      AUDIO_F32SYS, sample_config.n_channels, sample_config.sample_rate);
-
-    if (ret < 0) {
-        SDL_FreeWAV(wav_samples);
-        throw Exception("Failed to convert WAV to audio device sample specification\nSDL error: " + std::string(SDL_GetError()));
+    std::vector<float> samples;
+    try {
+        const AudioConvert::SampleFormat wav_format = from_sdl_format(wav_spec.format);
+        const size_t n_frames = wav_size / (AudioConvert::bytes_per_sample(wav_format) * wav_spec.channels);
+        samples = AudioConvert::convert(wav_samples, n_frames, wav_format, wav_spec.channels, wav_spec.freq, sample_config);
     }
-    else if (ret == 0) {
-        // no conversion needed
-        const float* const f_wav_samples = reinterpret_cast<float*>(wav_samples);
-        std::vector<float> samples(f_wav_samples, f_wav_samples + (wav_size / sizeof(float)));
+    catch (...) {
         SDL_FreeWAV(wav_samples);
-        return WaveData(std::move(samples), sample_config);
-        // return WaveData(std::vector<float>(wav_samples, wav_samples + (wav_size / sizeof(float))), sample_config);
+        throw;
     }
-    // else {  // if (ret >= 1) {
-        // conversion needed
-        cvt.len = wav_size;
-        assert(((unsigned int)(cvt.len * cvt.len_mult) >= wav_size) && "Buffer should at least be large enough to hold all samples in WAV file");
-        std::vector<float> samples((cvt.len * cvt.len_mult) / sizeof(float));
-        const float* const f_wav_samples = reinterpret_cast<float*>(wav_samples);
-        std::copy(f_wav_samples, f_wav_samples + (wav_size / sizeof(float)), samples.begin());
-        cvt.buf = reinterpret_cast<uint8_t*>(samples.data());
-
-        SDL_ConvertAudio(&cvt);
-
-        // sometimes, `out_size % sample_config.n_channels != 0`
-        // round down to be sure we don't read out of bounds
-        const int out_size = channel_align_down((cvt.len * cvt.len_ratio) / sizeof(float), sample_config.n_channels);
-        samples.resize(out_size);
 
-        SDL_FreeWAV(wav_samples);
-        return WaveData(std::move(samples), sample_config);
-    // }
+    SDL_FreeWAV(wav_samples);
+    return WaveData(std::move(samples), sample_config);
 }
 
 }  // namespace AudioFileLoader
@@ -0,0 +1,161 @@
+#include "audio/audio_file_loader/wav_header.hpp"
+
+#include "exception.hpp"
+#include "audio/convert/sample_format.hpp"
+
+#include <cstdint>
+#include <algorithm>  // min()
+#include <cstring>  // memcmp(), memcpy()
+#include <istream>
+#include <ostream>
+#include <string>
+#include <optional>
+
+
+namespace AudioFileLoader {
+
+// WAV files are little-endian; read byte by byte to be independent of host endianness
+static uint16_t read_u16(const uint8_t* const bytes) {
+    return bytes[0] | (bytes[1] << 8);
+}
+
+
+static uint32_t read_u32(const uint8_t* const bytes) {
+    return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+
+static void write_u16(uint8_t* const bytes, const uint16_t value) {
+    bytes[0] = value & 0xff;
+    bytes[1] = value >> 8;
+}
+
+
+static void write_u32(uint8_t* const bytes, const uint32_t value) {
+    for (int i = 0; i < 4; i++)
+        bytes[i] = (value >> (8 * i)) & 0xff;
+}
+
+
+static void read_exact(std::istream& file, uint8_t* const bytes, const std::streamsize n_bytes, const char* const what) {
+    if (!file.read(reinterpret_cast<char*>(bytes), n_bytes))
+        throw Exception("Unexpected end of WAV file while reading " + std::string(what));
+}
+
+
+WavInfo read_wav_info(std::istream& file) {
+    // determine file size to validate chunk sizes
+    file.seekg(0, std::ios::end);
+    const uint64_t file_size = file.tellg();
+    file.seekg(0, std::ios::beg);
+
+    uint8_t riff_header[12];
+    read_exact(file, riff_header, sizeof(riff_header), "RIFF header");
+    if (std::memcmp(riff_header, "RIFF", 4) != 0 || std::memcmp(riff_header + 8, "WAVE", 4) != 0)
+        throw Exception("Not a RIFF WAVE file");
+
+    std::optional<WavInfo> info;
+    while (true) {
+        uint8_t chunk_header[8];
+        read_exact(file, chunk_header, sizeof(chunk_header), "chunk header");
+        const uint32_t chunk_size = read_u32(chunk_header + 4);
+
+        if (std::memcmp(chunk_header, "fmt ", 4) == 0) {
+            if (chunk_size < 16 || chunk_size > 64)
+                throw Exception("Invalid WAV format chunk size (" + std::to_string(chunk_size) + ")");
+
+            uint8_t fmt[64];
+            read_exact(file, fmt, chunk_size, "format chunk");
+
+            uint16_t format_tag = read_u16(fmt);
+            const int n_channels = read_u16(fmt + 2);
+            const int sample_rate = read_u32(fmt + 4);
+            const int bits_per_sample = read_u16(fmt + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE stores the actual format tag in the first two bytes of the sub-format GUID
+            if (format_tag == 0xfffe) {
+                if (chunk_size < 40)
+                    throw Exception("Invalid extensible WAV format chunk");
+                format_tag = read_u16(fmt + 24);
+            }
+
+            if (n_channels <= 0 || sample_rate <= 0)
+                throw Exception("Invalid WAV channel count or sample rate");
+
+            AudioConvert::SampleFormat sample_format;
+            if (format_tag == 1 && bits_per_sample == 8)
+                sample_format = AudioConvert::SampleFormat::u8;
+            else if (format_tag == 1 && bits_per_sample == 16)
+                sample_format = AudioConvert::SampleFormat::s16;
+            else if (format_tag == 1 && bits_per_sample == 24)
+                sample_format = AudioConvert::SampleFormat::s24;
+            else if (format_tag == 1 && bits_per_sample == 32)
+                sample_format = AudioConvert::SampleFormat::s32;
+            else if (format_tag == 3 && bits_per_sample == 32)
+                sample_format = AudioConvert::SampleFormat::f32;
+            else if (format_tag == 3 && bits_per_sample == 64)
+                sample_format = AudioConvert::SampleFormat::f64;
+            else
+                throw Exception("Unsupported WAV sample format (format tag " + std::to_string(format_tag) + ", " + std::to_string(bits_per_sample) + " bits)");
+
+            info = WavInfo{
+                .sample_format = sample_format,
+                .sample_rate = sample_rate,
+                .n_channels = n_channels,
+                .bytes_per_sample = bits_per_sample / 8,
+                .data_offset = 0,
+                .data_size = 0,
+            };
+        }
+        else if (std::memcmp(chunk_header, "data", 4) == 0) {
+            if (!info.has_value())
+                throw Exception("WAV data chunk precedes format chunk");
+
+            info->data_offset = file.tellg();
+            // streamed WAV files may not know their length; clamp to what is actually in the file
+            info->data_size = std::min<uint64_t>(chunk_size, file_size - info->data_offset);
+            // drop trailing partial frame
+            const uint64_t frame_size = info->bytes_per_sample * info->n_channels;
+            info->data_size -= info->data_size % frame_size;
+
+            if (info->data_size == 0)
+                throw Exception("WAV file contains no samples");
+
+            return *info;
+        }
+        else {
+            // skip unknown chunk; chunks are padded to an even size
+            file.seekg(chunk_size + (chunk_size & 1), std::ios::cur);
+        }
+    }
+}
+
+
+void write_wav_header(std::ostream& file, const WavInfo& wav_info) {
+    if (wav_info.data_size > UINT32_MAX - 36)
+        throw Exception("Sample data is too large for a WAV file");
+    if (wav_info.sample_format == AudioConvert::SampleFormat::s8)
+        throw Exception("WAV files can't contain signed 8 bit samples");
+
+    const bool is_float = (wav_info.sample_format == AudioConvert::SampleFormat::f32 || wav_info.sample_format == AudioConvert::SampleFormat::f64);
+    const uint32_t frame_size = wav_info.bytes_per_sample * wav_info.n_channels;
+
+    uint8_t header[44];
+    std::memcpy(header, "RIFF", 4);
+    write_u32(header + 4, 36 + wav_info.data_size);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    write_u32(header + 16, 16);
+    write_u16(header + 20, is_float ? 3 : 1);
+    write_u16(header + 22, wav_info.n_channels);
+    write_u32(header + 24, wav_info.sample_rate);
+    write_u32(header + 28, wav_info.sample_rate * frame_size);
+    write_u16(header + 32, frame_size);
+    write_u16(header + 34, wav_info.bytes_per_sample * 8);
+    std::memcpy(header + 36, "data", 4);
+    write_u32(header + 40, wav_info.data_size);
+
+    if (!file.write(reinterpret_cast<const char*>(header), sizeof(header)))
+        throw Exception("Failed to write WAV header");
+}
+
+}  // namespace AudioFileLoader
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "audio/convert/sample_format.hpp"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+
+namespace AudioFileLoader {
+
+struct WavInfo {
+    AudioConvert::SampleFormat sample_format;
+    int sample_rate;
+    int n_channels;
+    int bytes_per_sample;
+
+    // location of the sample data in the file (in bytes)
+    uint64_t data_offset;
+    uint64_t data_size;
+
+    uint64_t get_n_frames() const {
+        return data_size / (bytes_per_sample * n_channels);
+    }
+};
+
+
+// parses the RIFF header of a little-endian PCM or IEEE float WAV file
+// on success, `file` is positioned at the start of the sample data
+// throws exception on failure or on unsupported (e.g. compressed) files
+WavInfo read_wav_info(std::istream& file);
+
+// writes a canonical 44 byte header for `wav_info`, to be followed by `wav_info.data_size` bytes of little-endian samples
+// `data_offset` is ignored; only PCM and IEEE float formats can be written
+// throws exception on failure
+void write_wav_header(std::ostream& file, const WavInfo& wav_info);
+
+}  // namespace AudioFileLoader
@@ -0,0 +1,89 @@
+#include "audio/audio_file_loader/wav_stream.hpp"
+
+#include "exception.hpp"
+#include "audio/audio_device.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/convert/converter.hpp"
+#include "audio/audio_file_loader/wav_header.hpp"
+#include "profiling/profiler.hpp"
+
+#include <algorithm>  // min(), max()
+#include <fstream>
+#include <string>
+
+
+namespace AudioFileLoader {
+
+// reads the header before the converter is constructed, as it depends on the file's format
+static WavInfo open_wav(std::ifstream& file, const std::string& wav_path) {
+    if (!file.is_open())
+        throw Exception("Failed to open WAV file '" + wav_path + "'");
+
+    return read_wav_info(file);
+}
+
+
+WavStream::WavStream(const std::string& wav_path, const SampleConfig& _sample_config)
+    : file(wav_path, std::ios::binary),
+      wav_info(open_wav(file, wav_path)),
+      sample_config(_sample_config),
+      bytes_left(wav_info.data_size),
+      finished(false),
+      converter(wav_info.sample_format, wav_info.n_channels, wav_info.sample_rate, sample_config),
+      pending_begin(0),
+      pending_end(0)
+{
+    raw_chunk.resize(CHUNK_FRAMES * wav_info.n_channels * wav_info.bytes_per_sample);
+    const size_t max_out_frames = std::max(converter.max_output_frames(CHUNK_FRAMES), converter.max_flush_frames());
+    out_chunk.resize(max_out_frames * sample_config.n_channels);
+}
+
+
+bool WavStream::top_up(AudioPlayback& playback, const double target_latency) {
+    PROFILE_SCOPE("WavStream::top_up");
+
+    const int target_frames = (target_latency / 1000.0) * sample_config.sample_rate;
+
+    while (playback.get_n_queued_frames() < target_frames) {
+        if (pending_begin == pending_end) {
+            if (finished)
+                break;
+            pending_begin = 0;
+            pending_end = decode_chunk();
+            continue;
+        }
+
+        // in callback mode only send what fits in the ring buffer, as the rest would count as an overrun; it is sent first on the next call
+        const int n_samples = std::min(pending_end - pending_begin, playback.get_n_free_samples());
+        if (n_samples == 0)
+            break;
+        pending_begin += playback.send_samples(out_chunk.data() + pending_begin, n_samples);
+    }
+
+    return !is_finished();
+}
+
+
+bool WavStream::is_finished() const {
+    return finished && pending_begin == pending_end;
+}
+
+
+int WavStream::decode_chunk() {
+    PROFILE_SCOPE("WavStream::decode_chunk");
+
+    if (bytes_left == 0) {
+        finished = true;
+        return converter.flush(out_chunk.data()) * sample_config.n_channels;
+    }
+
+    const uint64_t n_bytes = std::min<uint64_t>(bytes_left, raw_chunk.size());
+    if (!file.read(reinterpret_cast<char*>(raw_chunk.data()), n_bytes))
+        throw Exception("Failed to read samples from WAV file");
+    bytes_left -= n_bytes;
+
+    const size_t n_frames = n_bytes / (wav_info.bytes_per_sample * wav_info.n_channels);
+    return converter.process(raw_chunk.data(), n_frames, out_chunk.data()) * sample_config.n_channels;
+}
+
+}  // namespace AudioFileLoader
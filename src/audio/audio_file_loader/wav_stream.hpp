@@ -0,0 +1,66 @@
+#pragma once
+
+#include "audio/audio_device.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/convert/converter.hpp"
+#include "audio/audio_file_loader/wav_header.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+namespace AudioFileLoader {
+
+/* incrementally decodes a WAV file and feeds it to an `AudioPlayback`
+ * only a fixed size chunk of the file is held in memory at any time
+ * call top_up() every frame to keep the playback queue filled
+ */
+class WavStream {
+    public:
+        // only reads the header; throws exception on failure
+        WavStream(const std::string& wav_path, const SampleConfig& _sample_config);
+
+        WavStream(const WavStream&) = delete;
+        WavStream& operator=(const WavStream&) = delete;
+
+        // decodes and queues chunks until at least `target_latency` milliseconds of audio are queued in `playback`
+        // returns false once the whole file has been queued
+        // stops early if `playback` has no room for more samples (its ring buffer is full in callback mode); nothing is dropped
+        // throws exception on failure
+        bool top_up(AudioPlayback& playback, const double target_latency);
+
+        // true once the whole file has been queued
+        bool is_finished() const;
+
+
+        /* config */
+        // number of frames decoded at once
+        static constexpr int CHUNK_FRAMES = 4096;
+
+
+    private:
+        std::ifstream file;
+        WavInfo wav_info;
+        const SampleConfig sample_config;
+
+        uint64_t bytes_left;
+        bool finished;
+
+        // converts from the file's format/channels/rate to `sample_config`
+        AudioConvert::Converter converter;
+
+        // reused chunk buffers
+        std::vector<uint8_t> raw_chunk;
+        std::vector<float> out_chunk;
+        // samples [`pending_begin`, `pending_end`) of `out_chunk` are decoded, but not yet taken by the playback
+        int pending_begin, pending_end;
+
+
+        // decodes and converts the next chunk into `out_chunk`; returns number of samples written
+        // at end of file, the remaining converter output is flushed and `finished` is set
+        int decode_chunk();
+};
+
+}  // namespace AudioFileLoader
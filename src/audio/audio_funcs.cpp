@@ -1,8 +1,11 @@
 #include "audio_funcs.hpp"
 
 #include "audio/wave_data.hpp"
+#include "audio/dsp/kernels.hpp"
+#include "audio/dsp/wave_ops.hpp"
 
 #include <cmath>
+#include <span>
 
 
 int channel_align(const int sample_offset, const int n_channels) {
@@ -70,14 +73,11 @@ int channel_align_down(const double sample_offset, const int n_channels) {
 }
 
 
+float peak(const std::span<const float> samples) {
+    return Dsp::measure_level_sums(samples).peak;
+}
+
+
 void normalize(WaveData& wave_data) {
-    float max_value = 0.0;
-    for (const float sample : wave_data.samples) {
-        if (std::abs(sample) > max_value)
-            max_value = sample;
-    }
-
-    const float factor = 1.0f / max_value;
-    for (float& sample : wave_data.samples)
-        sample *= factor;
+    Dsp::normalize(wave_data);
 }
@@ -2,6 +2,8 @@
 
 #include "audio/wave_data.hpp"
 
+#include <span>
+
 
 // TODO: namespace
 
@@ -13,4 +15,8 @@ int channel_align_up(const double sample_offset, const int n_channels);
 int channel_align_down(const int sample_offset, const int n_channels);
 int channel_align_down(const double sample_offset, const int n_channels);
 
+// largest magnitude of `samples`; NaN samples give an unspecified result
+float peak(const std::span<const float> samples);
+// scales samples so the peak magnitude is 1.0; silence is left as is
+// see audio/dsp/wave_ops.hpp for more processing and multithreaded versions
 void normalize(WaveData& wave_data);
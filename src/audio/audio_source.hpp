@@ -0,0 +1,13 @@
+#pragma once
+
+
+// something producing audio inside the playback callback, e.g. a mixer
+class AudioSource {
+    public:
+        virtual ~AudioSource() = default;
+
+        /* adds `n_frames` frames of interleaved float samples to `out`, in the device's sample config
+         * runs on SDL's audio thread; may not lock, allocate or log
+         */
+        virtual void mix_into(float* const out, const int n_frames) noexcept = 0;
+};
@@ -0,0 +1,80 @@
+#include "audio/convert/converter.hpp"
+
+#include "audio/sample_config.hpp"
+#include "audio/convert/kernels.hpp"
+#include "audio/convert/resampler.hpp"
+#include "audio/convert/sample_format.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>  // min()
+
+
+namespace AudioConvert {
+
+Converter::Converter(const SampleFormat _in_format, const int _in_channels, const int in_rate, const SampleConfig& out_config)
+    : in_format(_in_format),
+      in_channels(_in_channels),
+      out_channels(out_config.n_channels),
+      resampler(in_rate, out_config.sample_rate, out_config.n_channels)
+{
+    //
+}
+
+
+size_t Converter::max_output_frames(const size_t n_in_frames) const {
+    return resampler.max_output_frames(n_in_frames);
+}
+
+
+size_t Converter::max_flush_frames() const {
+    return resampler.max_flush_frames();
+}
+
+
+size_t Converter::process(const uint8_t* const raw, const size_t n_in_frames, float* const out) {
+    if (float_buffer.size() < n_in_frames * in_channels)
+        float_buffer.resize(n_in_frames * in_channels);
+    to_float(raw, float_buffer.data(), n_in_frames * in_channels, in_format);
+
+    // remixing before resampling means the resampler works on the output channel count
+    const float* remixed = float_buffer.data();
+    if (in_channels != out_channels) {
+        if (remix_buffer.size() < n_in_frames * out_channels)
+            remix_buffer.resize(n_in_frames * out_channels);
+        remix_channels(float_buffer.data(), in_channels, remix_buffer.data(), out_channels, n_in_frames);
+        remixed = remix_buffer.data();
+    }
+
+    return resampler.process(remixed, n_in_frames, out);
+}
+
+
+size_t Converter::flush(float* const out) {
+    return resampler.flush(out);
+}
+
+
+std::vector<float> convert(const uint8_t* const raw, const size_t n_in_frames, const SampleFormat in_format, const int in_channels, const int in_rate, const SampleConfig& out_config) {
+    Converter converter(in_format, in_channels, in_rate, out_config);
+
+    // convert in blocks to bound the size of the intermediate buffers
+    constexpr size_t BLOCK_FRAMES = 1 << 16;
+    const size_t n_blocks = (n_in_frames + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+    const size_t capacity = converter.max_output_frames(n_in_frames) + n_blocks + converter.max_flush_frames();
+    std::vector<float> out(capacity * out_config.n_channels);
+
+    const size_t in_frame_size = bytes_per_sample(in_format) * in_channels;
+    size_t n_out_frames = 0;
+    for (size_t offset = 0; offset < n_in_frames; offset += BLOCK_FRAMES) {
+        const size_t block_frames = std::min(BLOCK_FRAMES, n_in_frames - offset);
+        n_out_frames += converter.process(raw + offset * in_frame_size, block_frames, out.data() + n_out_frames * out_config.n_channels);
+    }
+    n_out_frames += converter.flush(out.data() + n_out_frames * out_config.n_channels);
+    out.resize(n_out_frames * out_config.n_channels);
+
+    return out;
+}
+
+}  // namespace AudioConvert
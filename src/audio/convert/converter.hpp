@@ -0,0 +1,51 @@
+#pragma once
+
+#include "audio/sample_config.hpp"
+#include "audio/convert/sample_format.hpp"
+#include "audio/convert/resampler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace AudioConvert {
+
+/* streaming conversion of raw interleaved samples to float32 at a given `SampleConfig`
+ * steps: sample format -> float32, channel remixing, resampling
+ * scratch buffers grow to the largest block seen and are reused afterwards
+ */
+class Converter {
+    public:
+        // throws exception on invalid configuration
+        Converter(const SampleFormat _in_format, const int _in_channels, const int in_rate, const SampleConfig& out_config);
+
+        // upper bound on number of frames produced by a process() call on `n_in_frames` input frames
+        size_t max_output_frames(const size_t n_in_frames) const;
+        // upper bound on number of frames produced by flush()
+        size_t max_flush_frames() const;
+
+        // converts `n_in_frames` raw frames; `out` must hold at least `max_output_frames(n_in_frames)` frames
+        // returns number of frames written
+        size_t process(const uint8_t* const raw, const size_t n_in_frames, float* const out);
+        // emits the remaining frames after the last input; `out` must hold at least `max_flush_frames()` frames
+        size_t flush(float* const out);
+
+
+    private:
+        const SampleFormat in_format;
+        const int in_channels;
+        const int out_channels;
+
+        Resampler resampler;
+
+        std::vector<float> float_buffer;
+        std::vector<float> remix_buffer;
+};
+
+
+// converts a complete buffer of `n_in_frames` raw frames to `out_config`
+// the result has exactly `Resampler::output_length(n_in_frames)` frames
+std::vector<float> convert(const uint8_t* const raw, const size_t n_in_frames, const SampleFormat in_format, const int in_channels, const int in_rate, const SampleConfig& out_config);
+
+}  // namespace AudioConvert
@@ -0,0 +1,358 @@
+#include "audio/convert/kernels.hpp"
+
+#include "exception.hpp"
+#include "cpu_features.hpp"
+#include "audio/convert/sample_format.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>  // memcpy()
+#include <algorithm>  // min(), copy()
+#include <bit>  // endian
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AUDIO_CONVERT_X86
+#include <immintrin.h>
+#endif
+
+
+namespace AudioConvert {
+
+static constexpr float S16_SCALE = 1.0f / 32768.0f;
+static constexpr float S32_SCALE = 1.0f / 2147483648.0f;
+
+
+/* scalar kernels; reading byte by byte makes them independent of host endianness */
+static void s16_to_float_scalar(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    for (size_t i = 0; i < n_samples; i++)
+        out[i] = (int16_t)(raw[2 * i] | (raw[2 * i + 1] << 8)) * S16_SCALE;
+}
+
+
+static void s24_to_float_scalar(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    for (size_t i = 0; i < n_samples; i++) {
+        const uint8_t* const s = raw + 3 * i;
+        // place in upper 24 bits of an int32 to sign extend
+        const int32_t value = (int32_t)(((uint32_t)s[0] << 8) | ((uint32_t)s[1] << 16) | ((uint32_t)s[2] << 24));
+        out[i] = value * S32_SCALE;
+    }
+}
+
+
+static void s32_to_float_scalar(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    for (size_t i = 0; i < n_samples; i++) {
+        const uint8_t* const s = raw + 4 * i;
+        const int32_t value = (int32_t)(s[0] | (s[1] << 8) | (s[2] << 16) | ((uint32_t)s[3] << 24));
+        out[i] = value * S32_SCALE;
+    }
+}
+
+
+static void f64_to_float_scalar(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    for (size_t i = 0; i < n_samples; i++) {
+        uint64_t bits = 0;
+        for (int b = 7; b >= 0; b--)
+            bits = (bits << 8) | raw[8 * i + b];
+        double value;
+        std::memcpy(&value, &bits, sizeof(double));
+        out[i] = (float)value;
+    }
+}
+
+
+static void stereo_to_mono_scalar(const float* const in, float* const out, const size_t n_frames) {
+    for (size_t i = 0; i < n_frames; i++)
+        out[i] = (in[2 * i] + in[2 * i + 1]) * 0.5f;
+}
+
+
+static void mono_to_stereo_scalar(const float* const in, float* const out, const size_t n_frames) {
+    for (size_t i = 0; i < n_frames; i++) {
+        out[2 * i] = in[i];
+        out[2 * i + 1] = in[i];
+    }
+}
+
+
+#ifdef AUDIO_CONVERT_X86
+/* SSE2 kernels; x86 is little-endian, so raw samples can be loaded directly */
+__attribute__((target("sse2")))
+static void s16_to_float_sse2(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    const __m128 scale = _mm_set1_ps(S16_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= n_samples; i += 8) {
+        const __m128i s16 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + 2 * i));
+        // duplicate into both halves of an int32 and shift back to sign extend
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(s16, s16), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(s16, s16), 16);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    s16_to_float_scalar(raw + 2 * i, out + i, n_samples - i);
+}
+
+
+__attribute__((target("sse2")))
+static void s24_to_float_sse2(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    const __m128 scale = _mm_set1_ps(S32_SCALE);
+    size_t i = 0;
+    // SSE2 has no byte shuffle; byte shifts put sample k at the start of its own register, and unpacking gathers their first dwords
+    // every iteration loads 16 bytes for 12, so stop while at least 16 bytes remain
+    for (; 3 * i + 16 <= 3 * n_samples; i += 4) {
+        const __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + 3 * i));
+        const __m128i s01 = _mm_unpacklo_epi32(packed, _mm_srli_si128(packed, 3));
+        const __m128i s23 = _mm_unpacklo_epi32(_mm_srli_si128(packed, 6), _mm_srli_si128(packed, 9));
+        // the upper byte of each dword belongs to the next sample; shifting it out places the sample in the upper 24 bits to sign extend
+        const __m128i s32 = _mm_slli_epi32(_mm_unpacklo_epi64(s01, s23), 8);
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(s32), scale));
+    }
+    s24_to_float_scalar(raw + 3 * i, out + i, n_samples - i);
+}
+
+
+__attribute__((target("sse2")))
+static void s32_to_float_sse2(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    const __m128 scale = _mm_set1_ps(S32_SCALE);
+    size_t i = 0;
+    for (; i + 4 <= n_samples; i += 4) {
+        const __m128i s32 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + 4 * i));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(s32), scale));
+    }
+    s32_to_float_scalar(raw + 4 * i, out + i, n_samples - i);
+}
+
+
+__attribute__((target("sse2")))
+static void f64_to_float_sse2(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    size_t i = 0;
+    for (; i + 4 <= n_samples; i += 4) {
+        const __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<const double*>(raw + 8 * i)));
+        const __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<const double*>(raw + 8 * i + 16)));
+        _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+    }
+    f64_to_float_scalar(raw + 8 * i, out + i, n_samples - i);
+}
+
+
+__attribute__((target("sse2")))
+static void stereo_to_mono_sse2(const float* const in, float* const out, const size_t n_frames) {
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 4 <= n_frames; i += 4) {
+        const __m128 a = _mm_loadu_ps(in + 2 * i);
+        const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+        const __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(out + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+    }
+    stereo_to_mono_scalar(in + 2 * i, out + i, n_frames - i);
+}
+
+
+__attribute__((target("sse2")))
+static void mono_to_stereo_sse2(const float* const in, float* const out, const size_t n_frames) {
+    size_t i = 0;
+    for (; i + 4 <= n_frames; i += 4) {
+        const __m128 mono = _mm_loadu_ps(in + i);
+        _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(mono, mono));
+        _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(mono, mono));
+    }
+    mono_to_stereo_scalar(in + i, out + 2 * i, n_frames - i);
+}
+
+
+/* AVX2 kernels */
+__attribute__((target("avx2")))
+static void s16_to_float_avx2(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    const __m256 scale = _mm256_set1_ps(S16_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= n_samples; i += 8) {
+        const __m256i s32 = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + 2 * i)));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s32), scale));
+    }
+    s16_to_float_scalar(raw + 2 * i, out + i, n_samples - i);
+}
+
+
+__attribute__((target("avx2")))
+static void s24_to_float_avx2(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    const __m256 scale = _mm256_set1_ps(S32_SCALE);
+    // move the 3 bytes of each sample to the upper 3 bytes of an int32 (-1 zeroes the byte)
+    const __m256i shuffle = _mm256_setr_epi8(
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+        -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11
+    );
+    size_t i = 0;
+    // every iteration loads 16 bytes at offset 12, so stop while at least 28 bytes remain
+    for (; 3 * i + 28 <= 3 * n_samples; i += 8) {
+        const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + 3 * i));
+        const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(raw + 3 * i + 12));
+        const __m256i packed = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        const __m256i s32 = _mm256_shuffle_epi8(packed, shuffle);
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s32), scale));
+    }
+    s24_to_float_scalar(raw + 3 * i, out + i, n_samples - i);
+}
+
+
+__attribute__((target("avx2")))
+static void s32_to_float_avx2(const uint8_t* const raw, float* const out, const size_t n_samples) {
+    const __m256 scale = _mm256_set1_ps(S32_SCALE);
+    size_t i = 0;
+    for (; i + 8 <= n_samples; i += 8) {
+        const __m256i s32 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(raw + 4 * i));
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s32), scale));
+    }
+    s32_to_float_scalar(raw + 4 * i, out + i, n_samples - i);
+}
+#endif  // AUDIO_CONVERT_X86
+
+
+struct KernelSet {
+    const char* name;
+    void (*s16_to_float)(const uint8_t* const, float* const, const size_t);
+    void (*s24_to_float)(const uint8_t* const, float* const, const size_t);
+    void (*s32_to_float)(const uint8_t* const, float* const, const size_t);
+    void (*f64_to_float)(const uint8_t* const, float* const, const size_t);
+    void (*stereo_to_mono)(const float* const, float* const, const size_t);
+    void (*mono_to_stereo)(const float* const, float* const, const size_t);
+};
+
+
+// fastest first
+static std::vector<KernelSet> get_supported_kernel_set_list() {
+    std::vector<KernelSet> kernel_sets;
+#ifdef AUDIO_CONVERT_X86
+    if (CpuFeatures::has_avx2())
+        kernel_sets.push_back({"avx2", s16_to_float_avx2, s24_to_float_avx2, s32_to_float_avx2, f64_to_float_sse2, stereo_to_mono_sse2, mono_to_stereo_sse2});
+    if (CpuFeatures::has_sse2())
+        kernel_sets.push_back({"sse2", s16_to_float_sse2, s24_to_float_sse2, s32_to_float_sse2, f64_to_float_sse2, stereo_to_mono_sse2, mono_to_stereo_sse2});
+#endif
+
+    kernel_sets.push_back({"scalar", s16_to_float_scalar, s24_to_float_scalar, s32_to_float_scalar, f64_to_float_scalar, stereo_to_mono_scalar, mono_to_stereo_scalar});
+    return kernel_sets;
+}
+
+
+// mutable for set_kernel_set()
+static KernelSet& get_kernel_set() {
+    static KernelSet kernel_set = get_supported_kernel_set_list().front();
+    return kernel_set;
+}
+
+
+void to_float(const uint8_t* const raw, float* const out, const size_t n_samples, const SampleFormat sample_format) {
+    const KernelSet& kernels = get_kernel_set();
+
+    switch (sample_format) {
+        case SampleFormat::u8:
+            for (size_t i = 0; i < n_samples; i++)
+                out[i] = (raw[i] - 128) * (1.0f / 128.0f);
+            break;
+
+        case SampleFormat::s8:
+            for (size_t i = 0; i < n_samples; i++)
+                out[i] = (int8_t)raw[i] * (1.0f / 128.0f);
+            break;
+
+        case SampleFormat::s16:
+            kernels.s16_to_float(raw, out, n_samples);
+            break;
+
+        case SampleFormat::s24:
+            kernels.s24_to_float(raw, out, n_samples);
+            break;
+
+        case SampleFormat::s32:
+            kernels.s32_to_float(raw, out, n_samples);
+            break;
+
+        case SampleFormat::f32:
+            if constexpr (std::endian::native == std::endian::little)
+                std::memcpy(out, raw, n_samples * sizeof(float));
+            else {
+                for (size_t i = 0; i < n_samples; i++) {
+                    const uint8_t* const s = raw + 4 * i;
+                    const uint32_t bits = s[0] | (s[1] << 8) | (s[2] << 16) | ((uint32_t)s[3] << 24);
+                    std::memcpy(out + i, &bits, sizeof(float));
+                }
+            }
+            break;
+
+        case SampleFormat::f64:
+            kernels.f64_to_float(raw, out, n_samples);
+            break;
+    }
+}
+
+
+void remix_channels(const float* const in, const int in_channels, float* const out, const int out_channels, const size_t n_frames) {
+    if (in_channels == out_channels) {
+        std::copy(in, in + n_frames * in_channels, out);
+        return;
+    }
+
+    const KernelSet& kernels = get_kernel_set();
+    if (in_channels == 2 && out_channels == 1) {
+        kernels.stereo_to_mono(in, out, n_frames);
+        return;
+    }
+    if (in_channels == 1 && out_channels == 2) {
+        kernels.mono_to_stereo(in, out, n_frames);
+        return;
+    }
+
+    // generic cases
+    if (out_channels == 1) {
+        const float scale = 1.0f / in_channels;
+        for (size_t i = 0; i < n_frames; i++) {
+            float sum = 0.0f;
+            for (int c = 0; c < in_channels; c++)
+                sum += in[i * in_channels + c];
+            out[i] = sum * scale;
+        }
+    }
+    else if (in_channels == 1) {
+        for (size_t i = 0; i < n_frames; i++)
+            for (int c = 0; c < out_channels; c++)
+                out[i * out_channels + c] = in[i];
+    }
+    else {
+        const int shared_channels = std::min(in_channels, out_channels);
+        for (size_t i = 0; i < n_frames; i++) {
+            for (int c = 0; c < shared_channels; c++)
+                out[i * out_channels + c] = in[i * in_channels + c];
+            for (int c = shared_channels; c < out_channels; c++)
+                out[i * out_channels + c] = 0.0f;
+        }
+    }
+}
+
+
+const char* get_kernel_set_name() {
+    return get_kernel_set().name;
+}
+
+
+std::vector<std::string> get_supported_kernel_sets() {
+    std::vector<std::string> names;
+    for (const KernelSet& kernel_set : get_supported_kernel_set_list())
+        names.push_back(kernel_set.name);
+    return names;
+}
+
+
+void set_kernel_set(const std::string& name) {
+    for (const KernelSet& kernel_set : get_supported_kernel_set_list()) {
+        if (kernel_set.name == name) {
+            get_kernel_set() = kernel_set;
+            return;
+        }
+    }
+
+    throw Exception("Audio conversion kernel set '" + name + "' is not supported by this CPU");
+}
+
+}  // namespace AudioConvert
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "audio/convert/sample_format.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/* sample format and channel conversion kernels
+ * the fastest implementation supported by the CPU (AVX2, SSE2 or scalar) is selected at runtime
+ */
+namespace AudioConvert {
+
+// converts `n_samples` raw samples to float32 in [-1.0, 1.0]
+// `raw` doesn't need to be aligned
+void to_float(const uint8_t* const raw, float* const out, const size_t n_samples, const SampleFormat sample_format);
+
+/* converts `n_frames` interleaved frames from `in_channels` to `out_channels` channels
+ *   mono to many: the mono channel is copied to every output channel
+ *   many to mono: all input channels are averaged
+ *   otherwise:    shared channels are copied; extra input channels are dropped and extra output channels are silent
+ * `in` and `out` may not overlap
+ */
+void remix_channels(const float* const in, const int in_channels, float* const out, const int out_channels, const size_t n_frames);
+
+// name of the selected kernel set; for logging and benchmarks
+const char* get_kernel_set_name();
+
+// names of the kernel sets the CPU supports, fastest first; the first is selected by default
+std::vector<std::string> get_supported_kernel_sets();
+/* selects a kernel set by name, e.g. to compare them in benchmarks
+ * throws exception if the CPU doesn't support it
+ * not thread safe; only call while no conversions are running
+ */
+void set_kernel_set(const std::string& name);
+
+}  // namespace AudioConvert
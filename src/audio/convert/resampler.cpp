@@ -0,0 +1,276 @@
+#include "audio/convert/resampler.hpp"
+
+#include "exception.hpp"
+#include "cpu_features.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <numeric>  // gcd()
+#include <algorithm>  // min(), max(), copy(), fill()
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RESAMPLER_X86
+#include <immintrin.h>
+#endif
+
+
+namespace AudioConvert {
+
+// `n` is a multiple of 8
+static float dot_scalar(const float* const a, const float* const b, const int n) {
+    // independent accumulators allow the compiler to vectorize/pipeline
+    float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < n; i += 4)
+        for (int j = 0; j < 4; j++)
+            sum[j] += a[i + j] * b[i + j];
+
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+
+#ifdef RESAMPLER_X86
+__attribute__((target("sse2")))
+static float dot_sse2(const float* const a, const float* const b, const int n) {
+    __m128 sum0 = _mm_setzero_ps(),
+           sum1 = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 8) {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+
+    __m128 sum = _mm_add_ps(sum0, sum1);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+
+__attribute__((target("avx2")))
+static float dot_avx2(const float* const a, const float* const b, const int n) {
+    __m256 sum = _mm256_setzero_ps();
+    for (int i = 0; i < n; i += 8)
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    return _mm_cvtss_f32(half);
+}
+#endif  // RESAMPLER_X86
+
+
+// zeroth order modified Bessel function of the first kind
+static double bessel_i0(const double x) {
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+
+Resampler::Resampler(const int in_rate, const int out_rate, const int _n_channels)
+    : n_channels(_n_channels)
+{
+    if (in_rate <= 0 || out_rate <= 0 || n_channels <= 0)
+        throw Exception("Invalid resampler configuration (" + std::to_string(in_rate) + " Hz -> " + std::to_string(out_rate) + " Hz, " + std::to_string(n_channels) + " channels)");
+
+    const int divisor = std::gcd(in_rate, out_rate);
+    L = out_rate / divisor;
+    M = in_rate / divisor;
+    // with more phases than `MAX_PHASES`, the fractional position is quantized
+    n_phases = std::min<uint64_t>(L, MAX_PHASES);
+
+    // the lowered cutoff widens the sinc by the downsampling ratio, so the filter has to grow with it to keep its shape
+    const double downsampling = std::max(1.0, (double)M / L);
+    n_taps = std::min<int>(MAX_TAPS, (int)std::ceil(BASE_TAPS * downsampling / 8.0) * 8);
+    half_taps = n_taps / 2;
+
+    dot = dot_scalar;
+#ifdef RESAMPLER_X86
+    if (CpuFeatures::has_avx2())
+        dot = dot_avx2;
+    else if (CpuFeatures::has_sse2())
+        dot = dot_sse2;
+#endif
+
+    // when downsampling, lower the cutoff to the output's Nyquist frequency
+    const double cutoff = CUTOFF * std::min(1.0, (double)L / M);
+    const double window_norm = bessel_i0(KAISER_BETA);
+    coefficients.resize((size_t)n_phases * n_taps);
+    for (int p = 0; p < n_phases; p++) {
+        const double fraction = (double)p / n_phases;
+        double sum = 0.0;
+        for (int k = 0; k < n_taps; k++) {
+            // distance from the output position to input frame `k` of the filter
+            const double d = fraction + (half_taps - 1) - k;
+            const double x = M_PI * cutoff * d;
+            const double sinc = (std::abs(x) < 1e-9 ? 1.0 : std::sin(x) / x);
+            const double w = d / half_taps;
+            const double window = (std::abs(w) >= 1.0 ? 0.0 : bessel_i0(KAISER_BETA * std::sqrt(1.0 - w * w)) / window_norm);
+            coefficients[(size_t)p * n_taps + k] = sinc * window;
+            sum += sinc * window;
+        }
+
+        // unity gain at DC for every phase
+        for (int k = 0; k < n_taps; k++)
+            coefficients[(size_t)p * n_taps + k] /= sum;
+    }
+
+    reset();
+}
+
+
+size_t Resampler::max_output_frames(const size_t n_in_frames) const {
+    return (n_in_frames * L) / M + 1;
+}
+
+
+size_t Resampler::max_flush_frames() const {
+    return max_output_frames(n_taps);
+}
+
+
+uint64_t Resampler::output_length(const uint64_t n_in_frames) const {
+    return (n_in_frames * L + M - 1) / M;
+}
+
+
+size_t Resampler::process(const float* const in, const size_t n_in_frames, float* const out) {
+    if (is_passthrough()) {
+        std::copy(in, in + n_in_frames * n_channels, out);
+        total_in += n_in_frames;
+        return n_in_frames;
+    }
+
+    append_history(in, n_in_frames);
+    return produce(out, UINT64_MAX);
+}
+
+
+size_t Resampler::flush(float* const out) {
+    if (is_passthrough())
+        return 0;
+
+    // pad with silence, so the filter can reach past the last input frame
+    for (std::vector<float>& channel : history)
+        channel.resize(channel.size() + half_taps, 0.0f);
+
+    return produce(out, output_length(total_in));
+}
+
+
+void Resampler::reset() {
+    // start with silence before the first input frame, so the first output is centered on it
+    history.assign(n_channels, std::vector<float>(half_taps - 1, 0.0f));
+    history_start = -(half_taps - 1);
+    next_out = 0;
+    total_in = 0;
+}
+
+
+std::pair<int64_t, int64_t> Resampler::get_input_range(const uint64_t out_begin, const uint64_t out_end) const {
+    if (out_end <= out_begin)
+        return {0, 0};
+
+    if (is_passthrough())
+        return {out_begin, out_end};
+
+    return {first_input(out_begin), first_input(out_end - 1) + n_taps};
+}
+
+
+void Resampler::process_range(const float* const in, const int64_t in_begin, const int64_t in_end, float* const out, const uint64_t out_begin, const uint64_t out_end) const {
+    if (out_end <= out_begin)
+        return;
+
+    const auto [start, end] = get_input_range(out_begin, out_end);
+
+    // gather the needed input frames per channel; frames outside of the input are silent
+    std::vector<std::vector<float>> channels(n_channels, std::vector<float>(end - start, 0.0f));
+    const int64_t copy_begin = std::max(start, in_begin),
+                  copy_end = std::min(end, in_end);
+    for (int64_t i = copy_begin; i < copy_end; i++)
+        for (int c = 0; c < n_channels; c++)
+            channels[c][i - start] = in[(i - in_begin) * n_channels + c];
+
+    if (is_passthrough()) {
+        for (int64_t i = 0; i < end - start; i++)
+            for (int c = 0; c < n_channels; c++)
+                out[i * n_channels + c] = channels[c][i];
+        return;
+    }
+
+    compute(channels.data(), start, out_begin, out_end, out);
+}
+
+
+bool Resampler::is_passthrough() const {
+    return L == M;
+}
+
+
+int Resampler::get_n_taps() const {
+    return n_taps;
+}
+
+
+int64_t Resampler::first_input(const uint64_t t) const {
+    return (int64_t)((t * M) / L) - (half_taps - 1);
+}
+
+
+void Resampler::compute(const std::vector<float>* const channels, const int64_t start, const uint64_t t_begin, const uint64_t t_end, float* out) const {
+    for (uint64_t t = t_begin; t < t_end; t++) {
+        const uint64_t phase = (((t * M) % L) * n_phases) / L;
+        const float* const taps = coefficients.data() + phase * n_taps;
+        const int64_t offset = first_input(t) - start;
+
+        for (int c = 0; c < n_channels; c++)
+            *out++ = dot(channels[c].data() + offset, taps, n_taps);
+    }
+}
+
+
+void Resampler::append_history(const float* const in, const size_t n_in_frames) {
+    for (int c = 0; c < n_channels; c++) {
+        std::vector<float>& channel = history[c];
+        const size_t old_size = channel.size();
+        channel.resize(old_size + n_in_frames);
+        for (size_t i = 0; i < n_in_frames; i++)
+            channel[old_size + i] = in[i * n_channels + c];
+    }
+    total_in += n_in_frames;
+}
+
+
+size_t Resampler::produce(float* const out, const uint64_t t_limit) {
+    // produce every output frame whose filter only needs frames in the history
+    const int64_t history_end = history_start + (int64_t)history[0].size();
+    uint64_t t_end = next_out;
+    while (t_end < t_limit && first_input(t_end) + n_taps <= history_end)
+        t_end++;
+
+    compute(history.data(), history_start, next_out, t_end, out);
+    const size_t n_frames = t_end - next_out;
+    next_out = t_end;
+
+    // drop input frames no future output frame needs
+    const int64_t keep_from = std::min(first_input(next_out), history_end);
+    if (keep_from > history_start) {
+        for (std::vector<float>& channel : history)
+            channel.erase(channel.begin(), channel.begin() + (keep_from - history_start));
+        history_start = keep_from;
+    }
+
+    return n_frames;
+}
+
+}  // namespace AudioConvert
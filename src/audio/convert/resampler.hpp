@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>  // pair
+
+
+namespace AudioConvert {
+
+/* polyphase band-limited (Kaiser windowed sinc) sample rate converter for interleaved float32 frames
+ * the rate ratio is reduced to `out_rate / in_rate = L / M`; every output frame uses one of at most `MAX_PHASES` filter phases
+ * when downsampling, the cutoff is lowered to the output's Nyquist frequency and the filter is lengthened by the same ratio
+ *   so the transition band stays as steep relative to the output rate, instead of aliasing at large ratios
+ * the filter dot product uses AVX2 or SSE2 if the CPU supports it
+ *
+ * process()/flush() are for streaming and keep the filter history between calls
+ * process_range() is stateless and computes any range of the output of resampling a complete signal
+ *   splitting the output in ranges gives exactly the same result as resampling the signal at once
+ *   so ranges can be computed independently (e.g. in parallel) from a window of the input
+ * both produce `output_length(n_in_frames)` frames in total
+ */
+class Resampler {
+    public:
+        Resampler(const int in_rate, const int out_rate, const int _n_channels);
+
+        // upper bound on number of frames produced by a process() call on `n_in_frames` input frames
+        size_t max_output_frames(const size_t n_in_frames) const;
+        // upper bound on number of frames produced by flush()
+        size_t max_flush_frames() const;
+        // total number of output frames when resampling `n_in_frames` input frames
+        uint64_t output_length(const uint64_t n_in_frames) const;
+
+        // `out` must hold at least `max_output_frames(n_in_frames)` frames; returns number of frames written
+        size_t process(const float* const in, const size_t n_in_frames, float* const out);
+        // emits the remaining output after the last input; `out` must hold at least `max_flush_frames()` frames
+        size_t flush(float* const out);
+        // forget streaming state to start a new stream
+        void reset();
+
+        // input frames [first, second) needed to compute output frames [`out_begin`, `out_end`)
+        // the range may extend past the start and end of the signal
+        std::pair<int64_t, int64_t> get_input_range(const uint64_t out_begin, const uint64_t out_end) const;
+
+        // writes output frames [`out_begin`, `out_end`) to `out`
+        // `in` contains input frames [`in_begin`, `in_end`) and all frames outside of it are considered silent
+        // so `in` should cover get_input_range(), except where that extends past the start or end of the signal
+        void process_range(const float* const in, const int64_t in_begin, const int64_t in_end, float* const out, const uint64_t out_begin, const uint64_t out_end) const;
+
+        bool is_passthrough() const;
+        // filter length per phase
+        int get_n_taps() const;
+
+
+        /* config */
+        // filter length per phase without downsampling; multiplied by the downsampling ratio, rounded up to a multiple of 8
+        static constexpr int BASE_TAPS = 32;
+        // keeps the filter bounded at extreme ratios (beyond 32x), where the transition band widens again
+        static constexpr int MAX_TAPS = 1024;
+        static constexpr int MAX_PHASES = 1024;
+        // fraction of the lowest Nyquist frequency passed; the rest is the filter's transition band
+        static constexpr double CUTOFF = 0.91;
+        static constexpr double KAISER_BETA = 8.0;
+
+
+    private:
+        const int n_channels;
+        uint64_t L, M;  // out_rate / in_rate = L / M
+        int n_phases;
+        int n_taps, half_taps;
+
+        // `n_phases` rows of `n_taps` coefficients
+        std::vector<float> coefficients;
+        float (*dot)(const float* const, const float* const, const int);
+
+        // streaming state
+        std::vector<std::vector<float>> history;  // input per channel
+        int64_t history_start;  // input frame index of first frame in history
+        uint64_t next_out;  // next output frame index to produce
+        uint64_t total_in;  // number of input frames received
+
+
+        // input frame index of the first input frame used for output frame `t`
+        int64_t first_input(const uint64_t t) const;
+
+        // computes output frames [`t_begin`, `t_end`) from planar input where `channels[c][0]` is input frame `start`
+        void compute(const std::vector<float>* const channels, const int64_t start, const uint64_t t_begin, const uint64_t t_end, float* out) const;
+
+        void append_history(const float* const in, const size_t n_in_frames);
+        size_t produce(float* const out, const uint64_t t_limit);
+};
+
+}  // namespace AudioConvert
@@ -0,0 +1,37 @@
+#pragma once
+
+
+namespace AudioConvert {
+
+// raw little-endian sample encodings which can be converted to float32
+enum class SampleFormat {
+    u8,
+    s8,
+    s16,
+    s24,  // packed in 3 bytes
+    s32,
+    f32,
+    f64
+};
+
+
+constexpr int bytes_per_sample(const SampleFormat sample_format) {
+    switch (sample_format) {
+        case SampleFormat::u8:
+        case SampleFormat::s8:
+            return 1;
+        case SampleFormat::s16:
+            return 2;
+        case SampleFormat::s24:
+            return 3;
+        case SampleFormat::s32:
+        case SampleFormat::f32:
+            return 4;
+        case SampleFormat::f64:
+            return 8;
+    }
+
+    return 0;
+}
+
+}  // namespace AudioConvert
@@ -0,0 +1,642 @@
+#include "audio/dsp/kernels.hpp"
+
+#include "exception.hpp"
+#include "cpu_features.hpp"
+
+#include <algorithm>  // min(), max()
+#include <bit>  // bit_cast()
+#include <cmath>  // sqrt()
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define DSP_X86
+#include <immintrin.h>
+#endif
+
+// horizontal max and add are only available on AArch64
+#if defined(__aarch64__)
+#define DSP_NEON
+#include <arm_neon.h>
+#endif
+
+
+namespace Dsp {
+
+// squares are summed in float within a block and then added to a double, which keeps long sums accurate
+// must be a multiple of 8
+static constexpr size_t LEVEL_BLOCK = 4096;
+
+
+/* scalar kernels; plain loops, so the compiler can vectorize most of them for the baseline instruction set */
+static void gain_scalar(float* const samples, const size_t n_samples, const float gain) {
+    for (size_t i = 0; i < n_samples; i++)
+        samples[i] *= gain;
+}
+
+
+static void gain_ramp_scalar(float* const samples, const size_t n_frames, const int n_channels, const float start_gain, const float gain_step) {
+    for (size_t f = 0; f < n_frames; f++) {
+        const float gain = start_gain + gain_step * (float)f;
+        for (int c = 0; c < n_channels; c++)
+            samples[f * n_channels + c] *= gain;
+    }
+}
+
+
+static void mix_scalar(const float* const in, float* const out, const size_t n_samples, const float gain) {
+    for (size_t i = 0; i < n_samples; i++)
+        out[i] += in[i] * gain;
+}
+
+
+static void crossfade_scalar(const float* const from, const float* const to, float* const out, const size_t n_frames, const int n_channels, const float start_t, const float t_step) {
+    for (size_t f = 0; f < n_frames; f++) {
+        const float t = start_t + t_step * (float)f;
+        for (int c = 0; c < n_channels; c++) {
+            const size_t i = f * n_channels + c;
+            out[i] = from[i] + (to[i] - from[i]) * t;
+        }
+    }
+}
+
+
+static void clip_scalar(float* const samples, const size_t n_samples, const float limit) {
+    for (size_t i = 0; i < n_samples; i++)
+        samples[i] = std::min(std::max(samples[i], -limit), limit);
+}
+
+
+static LevelSums level_sums_scalar(const float* const samples, const size_t n_samples) {
+    // with the sign bit cleared, floats order like their bit patterns as unsigned integers
+    // an integer max reduction is branchless and vectorizes without -ffast-math, unlike a float one
+    uint32_t max_bits = 0;
+    double sum_squares = 0.0;
+    for (size_t block = 0; block < n_samples; block += LEVEL_BLOCK) {
+        const size_t block_end = std::min(n_samples, block + LEVEL_BLOCK);
+        float block_sum = 0.0f;
+        for (size_t i = block; i < block_end; i++) {
+            max_bits = std::max(max_bits, std::bit_cast<uint32_t>(samples[i]) & 0x7fffffffu);
+            block_sum += samples[i] * samples[i];
+        }
+        sum_squares += block_sum;
+    }
+
+    return {.peak = std::bit_cast<float>(max_bits), .sum_squares = sum_squares, .n_samples = n_samples};
+}
+
+
+static void deinterleave_stereo_scalar(const float* const in, float* const left, float* const right, const size_t n_frames) {
+    for (size_t i = 0; i < n_frames; i++) {
+        left[i] = in[2 * i];
+        right[i] = in[2 * i + 1];
+    }
+}
+
+
+static void interleave_stereo_scalar(const float* const left, const float* const right, float* const out, const size_t n_frames) {
+    for (size_t i = 0; i < n_frames; i++) {
+        out[2 * i] = left[i];
+        out[2 * i + 1] = right[i];
+    }
+}
+
+
+#ifdef DSP_X86
+/* SSE2 kernels */
+__attribute__((target("sse2")))
+static void gain_sse2(float* const samples, const size_t n_samples, const float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 4 <= n_samples; i += 4)
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+    gain_scalar(samples + i, n_samples - i, gain);
+}
+
+
+// ramps are vectorized if a vector holds whole frames; every lane gets the gain of its frame
+__attribute__((target("sse2")))
+static void gain_ramp_sse2(float* const samples, const size_t n_frames, const int n_channels, const float start_gain, const float gain_step) {
+    if (4 % n_channels != 0) {
+        gain_ramp_scalar(samples, n_frames, n_channels, start_gain, gain_step);
+        return;
+    }
+
+    const size_t frames_per_vector = 4 / n_channels;
+    const __m128 lane_steps = _mm_mul_ps(_mm_set1_ps(gain_step), _mm_setr_ps(0, 1 / n_channels, 2 / n_channels, 3 / n_channels));
+    size_t f = 0;
+    for (; f + frames_per_vector <= n_frames; f += frames_per_vector) {
+        const __m128 g = _mm_add_ps(_mm_set1_ps(start_gain + gain_step * (float)f), lane_steps);
+        float* const frame = samples + f * n_channels;
+        _mm_storeu_ps(frame, _mm_mul_ps(_mm_loadu_ps(frame), g));
+    }
+    gain_ramp_scalar(samples + f * n_channels, n_frames - f, n_channels, start_gain + gain_step * (float)f, gain_step);
+}
+
+
+__attribute__((target("sse2")))
+static void mix_sse2(const float* const in, float* const out, const size_t n_samples, const float gain) {
+    const __m128 g = _mm_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 4 <= n_samples; i += 4)
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_loadu_ps(out + i), _mm_mul_ps(_mm_loadu_ps(in + i), g)));
+    mix_scalar(in + i, out + i, n_samples - i, gain);
+}
+
+
+__attribute__((target("sse2")))
+static void crossfade_sse2(const float* const from, const float* const to, float* const out, const size_t n_frames, const int n_channels, const float start_t, const float t_step) {
+    if (4 % n_channels != 0) {
+        crossfade_scalar(from, to, out, n_frames, n_channels, start_t, t_step);
+        return;
+    }
+
+    const size_t frames_per_vector = 4 / n_channels;
+    const __m128 lane_steps = _mm_mul_ps(_mm_set1_ps(t_step), _mm_setr_ps(0, 1 / n_channels, 2 / n_channels, 3 / n_channels));
+    size_t f = 0;
+    for (; f + frames_per_vector <= n_frames; f += frames_per_vector) {
+        const __m128 t = _mm_add_ps(_mm_set1_ps(start_t + t_step * (float)f), lane_steps);
+        const size_t i = f * n_channels;
+        const __m128 a = _mm_loadu_ps(from + i);
+        _mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(to + i), a), t)));
+    }
+    const size_t i = f * n_channels;
+    crossfade_scalar(from + i, to + i, out + i, n_frames - f, n_channels, start_t + t_step * (float)f, t_step);
+}
+
+
+__attribute__((target("sse2")))
+static void clip_sse2(float* const samples, const size_t n_samples, const float limit) {
+    const __m128 high = _mm_set1_ps(limit);
+    const __m128 low = _mm_set1_ps(-limit);
+    size_t i = 0;
+    for (; i + 4 <= n_samples; i += 4)
+        _mm_storeu_ps(samples + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(samples + i), low), high));
+    clip_scalar(samples + i, n_samples - i, limit);
+}
+
+
+__attribute__((target("sse2")))
+static LevelSums level_sums_sse2(const float* const samples, const size_t n_samples) {
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 peak = _mm_setzero_ps();
+    double sum_squares = 0.0;
+
+    const size_t n_vectorized = n_samples - n_samples % 4;
+    for (size_t block = 0; block < n_vectorized; block += LEVEL_BLOCK) {
+        const size_t block_end = std::min(n_vectorized, block + LEVEL_BLOCK);
+        __m128 sums = _mm_setzero_ps();
+        for (size_t i = block; i < block_end; i += 4) {
+            const __m128 x = _mm_loadu_ps(samples + i);
+            peak = _mm_max_ps(peak, _mm_and_ps(x, abs_mask));
+            sums = _mm_add_ps(sums, _mm_mul_ps(x, x));
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, sums);
+        sum_squares += (double)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    alignas(16) float peaks[4];
+    _mm_store_ps(peaks, peak);
+    const LevelSums vectorized = {.peak = std::max(std::max(peaks[0], peaks[1]), std::max(peaks[2], peaks[3])), .sum_squares = sum_squares, .n_samples = n_vectorized};
+    return combine(vectorized, level_sums_scalar(samples + n_vectorized, n_samples - n_vectorized));
+}
+
+
+__attribute__((target("sse2")))
+static void deinterleave_stereo_sse2(const float* const in, float* const left, float* const right, const size_t n_frames) {
+    size_t i = 0;
+    for (; i + 4 <= n_frames; i += 4) {
+        const __m128 a = _mm_loadu_ps(in + 2 * i);
+        const __m128 b = _mm_loadu_ps(in + 2 * i + 4);
+        _mm_storeu_ps(left + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+        _mm_storeu_ps(right + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+    }
+    deinterleave_stereo_scalar(in + 2 * i, left + i, right + i, n_frames - i);
+}
+
+
+__attribute__((target("sse2")))
+static void interleave_stereo_sse2(const float* const left, const float* const right, float* const out, const size_t n_frames) {
+    size_t i = 0;
+    for (; i + 4 <= n_frames; i += 4) {
+        const __m128 l = _mm_loadu_ps(left + i);
+        const __m128 r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(out + 2 * i, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(out + 2 * i + 4, _mm_unpackhi_ps(l, r));
+    }
+    interleave_stereo_scalar(left + i, right + i, out + 2 * i, n_frames - i);
+}
+
+
+/* AVX2 kernels; AVX2 is needed for cross-lane permutes */
+__attribute__((target("avx2")))
+static void gain_avx2(float* const samples, const size_t n_samples, const float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= n_samples; i += 8)
+        _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+    gain_sse2(samples + i, n_samples - i, gain);
+}
+
+
+__attribute__((target("avx2")))
+static __m256 lane_frames_avx2(const int n_channels) {
+    return _mm256_setr_ps(0, 1 / n_channels, 2 / n_channels, 3 / n_channels, 4 / n_channels, 5 / n_channels, 6 / n_channels, 7 / n_channels);
+}
+
+
+__attribute__((target("avx2")))
+static void gain_ramp_avx2(float* const samples, const size_t n_frames, const int n_channels, const float start_gain, const float gain_step) {
+    if (8 % n_channels != 0) {
+        gain_ramp_scalar(samples, n_frames, n_channels, start_gain, gain_step);
+        return;
+    }
+
+    const size_t frames_per_vector = 8 / n_channels;
+    const __m256 lane_steps = _mm256_mul_ps(_mm256_set1_ps(gain_step), lane_frames_avx2(n_channels));
+    size_t f = 0;
+    for (; f + frames_per_vector <= n_frames; f += frames_per_vector) {
+        const __m256 g = _mm256_add_ps(_mm256_set1_ps(start_gain + gain_step * (float)f), lane_steps);
+        float* const frame = samples + f * n_channels;
+        _mm256_storeu_ps(frame, _mm256_mul_ps(_mm256_loadu_ps(frame), g));
+    }
+    gain_ramp_scalar(samples + f * n_channels, n_frames - f, n_channels, start_gain + gain_step * (float)f, gain_step);
+}
+
+
+__attribute__((target("avx2")))
+static void mix_avx2(const float* const in, float* const out, const size_t n_samples, const float gain) {
+    const __m256 g = _mm256_set1_ps(gain);
+    size_t i = 0;
+    for (; i + 8 <= n_samples; i += 8)
+        _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), g)));
+    mix_sse2(in + i, out + i, n_samples - i, gain);
+}
+
+
+__attribute__((target("avx2")))
+static void crossfade_avx2(const float* const from, const float* const to, float* const out, const size_t n_frames, const int n_channels, const float start_t, const float t_step) {
+    if (8 % n_channels != 0) {
+        crossfade_scalar(from, to, out, n_frames, n_channels, start_t, t_step);
+        return;
+    }
+
+    const size_t frames_per_vector = 8 / n_channels;
+    const __m256 lane_steps = _mm256_mul_ps(_mm256_set1_ps(t_step), lane_frames_avx2(n_channels));
+    size_t f = 0;
+    for (; f + frames_per_vector <= n_frames; f += frames_per_vector) {
+        const __m256 t = _mm256_add_ps(_mm256_set1_ps(start_t + t_step * (float)f), lane_steps);
+        const size_t i = f * n_channels;
+        const __m256 a = _mm256_loadu_ps(from + i);
+        _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(to + i), a), t)));
+    }
+    const size_t i = f * n_channels;
+    crossfade_scalar(from + i, to + i, out + i, n_frames - f, n_channels, start_t + t_step * (float)f, t_step);
+}
+
+
+__attribute__((target("avx2")))
+static void clip_avx2(float* const samples, const size_t n_samples, const float limit) {
+    const __m256 high = _mm256_set1_ps(limit);
+    const __m256 low = _mm256_set1_ps(-limit);
+    size_t i = 0;
+    for (; i + 8 <= n_samples; i += 8)
+        _mm256_storeu_ps(samples + i, _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(samples + i), low), high));
+    clip_sse2(samples + i, n_samples - i, limit);
+}
+
+
+__attribute__((target("avx2")))
+static LevelSums level_sums_avx2(const float* const samples, const size_t n_samples) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 peak = _mm256_setzero_ps();
+    double sum_squares = 0.0;
+
+    const size_t n_vectorized = n_samples - n_samples % 8;
+    for (size_t block = 0; block < n_vectorized; block += LEVEL_BLOCK) {
+        const size_t block_end = std::min(n_vectorized, block + LEVEL_BLOCK);
+        __m256 sums = _mm256_setzero_ps();
+        for (size_t i = block; i < block_end; i += 8) {
+            const __m256 x = _mm256_loadu_ps(samples + i);
+            peak = _mm256_max_ps(peak, _mm256_and_ps(x, abs_mask));
+            sums = _mm256_add_ps(sums, _mm256_mul_ps(x, x));
+        }
+
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, sums);
+        for (const float lane : lanes)
+            sum_squares += lane;
+    }
+
+    alignas(32) float peaks[8];
+    _mm256_store_ps(peaks, peak);
+    const LevelSums vectorized = {.peak = *std::max_element(peaks, peaks + 8), .sum_squares = sum_squares, .n_samples = n_vectorized};
+    return combine(vectorized, level_sums_scalar(samples + n_vectorized, n_samples - n_vectorized));
+}
+
+
+__attribute__((target("avx2")))
+static void deinterleave_stereo_avx2(const float* const in, float* const left, float* const right, const size_t n_frames) {
+    size_t i = 0;
+    for (; i + 8 <= n_frames; i += 8) {
+        const __m256 a = _mm256_loadu_ps(in + 2 * i);
+        const __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+        // shuffles work within 128-bit lanes, giving frames 0 1 4 5 | 2 3 6 7; the permute restores the order
+        const __m256 l = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m256 r = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm256_storeu_ps(left + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(l), _MM_SHUFFLE(3, 1, 2, 0))));
+        _mm256_storeu_ps(right + i, _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(r), _MM_SHUFFLE(3, 1, 2, 0))));
+    }
+    deinterleave_stereo_sse2(in + 2 * i, left + i, right + i, n_frames - i);
+}
+
+
+__attribute__((target("avx2")))
+static void interleave_stereo_avx2(const float* const left, const float* const right, float* const out, const size_t n_frames) {
+    size_t i = 0;
+    for (; i + 8 <= n_frames; i += 8) {
+        const __m256 l = _mm256_loadu_ps(left + i);
+        const __m256 r = _mm256_loadu_ps(right + i);
+        // unpacks work within 128-bit lanes, giving frames 0 1 | 4 5 and 2 3 | 6 7
+        const __m256 lo = _mm256_unpacklo_ps(l, r);
+        const __m256 hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(out + 2 * i, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + 2 * i + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    interleave_stereo_sse2(left + i, right + i, out + 2 * i, n_frames - i);
+}
+#endif  // DSP_X86
+
+
+#ifdef DSP_NEON
+/* NEON kernels */
+static void gain_neon(float* const samples, const size_t n_samples, const float gain) {
+    const float32x4_t g = vdupq_n_f32(gain);
+    size_t i = 0;
+    for (; i + 4 <= n_samples; i += 4)
+        vst1q_f32(samples + i, vmulq_f32(vld1q_f32(samples + i), g));
+    gain_scalar(samples + i, n_samples - i, gain);
+}
+
+
+static float32x4_t lane_frames_neon(const int n_channels) {
+    const float lane_frames[4] = {0.0f, (float)(1 / n_channels), (float)(2 / n_channels), (float)(3 / n_channels)};
+    return vld1q_f32(lane_frames);
+}
+
+
+static void gain_ramp_neon(float* const samples, const size_t n_frames, const int n_channels, const float start_gain, const float gain_step) {
+    if (4 % n_channels != 0) {
+        gain_ramp_scalar(samples, n_frames, n_channels, start_gain, gain_step);
+        return;
+    }
+
+    const size_t frames_per_vector = 4 / n_channels;
+    const float32x4_t lane_steps = vmulq_f32(vdupq_n_f32(gain_step), lane_frames_neon(n_channels));
+    size_t f = 0;
+    for (; f + frames_per_vector <= n_frames; f += frames_per_vector) {
+        const float32x4_t g = vaddq_f32(vdupq_n_f32(start_gain + gain_step * (float)f), lane_steps);
+        float* const frame = samples + f * n_channels;
+        vst1q_f32(frame, vmulq_f32(vld1q_f32(frame), g));
+    }
+    gain_ramp_scalar(samples + f * n_channels, n_frames - f, n_channels, start_gain + gain_step * (float)f, gain_step);
+}
+
+
+static void mix_neon(const float* const in, float* const out, const size_t n_samples, const float gain) {
+    const float32x4_t g = vdupq_n_f32(gain);
+    size_t i = 0;
+    for (; i + 4 <= n_samples; i += 4)
+        vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_f32(vld1q_f32(in + i), g)));
+    mix_scalar(in + i, out + i, n_samples - i, gain);
+}
+
+
+static void crossfade_neon(const float* const from, const float* const to, float* const out, const size_t n_frames, const int n_channels, const float start_t, const float t_step) {
+    if (4 % n_channels != 0) {
+        crossfade_scalar(from, to, out, n_frames, n_channels, start_t, t_step);
+        return;
+    }
+
+    const size_t frames_per_vector = 4 / n_channels;
+    const float32x4_t lane_steps = vmulq_f32(vdupq_n_f32(t_step), lane_frames_neon(n_channels));
+    size_t f = 0;
+    for (; f + frames_per_vector <= n_frames; f += frames_per_vector) {
+        const float32x4_t t = vaddq_f32(vdupq_n_f32(start_t + t_step * (float)f), lane_steps);
+        const size_t i = f * n_channels;
+        const float32x4_t a = vld1q_f32(from + i);
+        vst1q_f32(out + i, vaddq_f32(a, vmulq_f32(vsubq_f32(vld1q_f32(to + i), a), t)));
+    }
+    const size_t i = f * n_channels;
+    crossfade_scalar(from + i, to + i, out + i, n_frames - f, n_channels, start_t + t_step * (float)f, t_step);
+}
+
+
+static void clip_neon(float* const samples, const size_t n_samples, const float limit) {
+    const float32x4_t high = vdupq_n_f32(limit);
+    const float32x4_t low = vdupq_n_f32(-limit);
+    size_t i = 0;
+    for (; i + 4 <= n_samples; i += 4)
+        vst1q_f32(samples + i, vminq_f32(vmaxq_f32(vld1q_f32(samples + i), low), high));
+    clip_scalar(samples + i, n_samples - i, limit);
+}
+
+
+static LevelSums level_sums_neon(const float* const samples, const size_t n_samples) {
+    float32x4_t peak = vdupq_n_f32(0.0f);
+    double sum_squares = 0.0;
+
+    const size_t n_vectorized = n_samples - n_samples % 4;
+    for (size_t block = 0; block < n_vectorized; block += LEVEL_BLOCK) {
+        const size_t block_end = std::min(n_vectorized, block + LEVEL_BLOCK);
+        float32x4_t sums = vdupq_n_f32(0.0f);
+        for (size_t i = block; i < block_end; i += 4) {
+            const float32x4_t x = vld1q_f32(samples + i);
+            peak = vmaxq_f32(peak, vabsq_f32(x));
+            sums = vaddq_f32(sums, vmulq_f32(x, x));
+        }
+        sum_squares += vaddvq_f32(sums);
+    }
+
+    const LevelSums vectorized = {.peak = vmaxvq_f32(peak), .sum_squares = sum_squares, .n_samples = n_vectorized};
+    return combine(vectorized, level_sums_scalar(samples + n_vectorized, n_samples - n_vectorized));
+}
+
+
+static void deinterleave_stereo_neon(const float* const in, float* const left, float* const right, const size_t n_frames) {
+    size_t i = 0;
+    for (; i + 4 <= n_frames; i += 4) {
+        const float32x4x2_t frames = vld2q_f32(in + 2 * i);
+        vst1q_f32(left + i, frames.val[0]);
+        vst1q_f32(right + i, frames.val[1]);
+    }
+    deinterleave_stereo_scalar(in + 2 * i, left + i, right + i, n_frames - i);
+}
+
+
+static void interleave_stereo_neon(const float* const left, const float* const right, float* const out, const size_t n_frames) {
+    size_t i = 0;
+    for (; i + 4 <= n_frames; i += 4) {
+        const float32x4x2_t frames = {{vld1q_f32(left + i), vld1q_f32(right + i)}};
+        vst2q_f32(out + 2 * i, frames);
+    }
+    interleave_stereo_scalar(left + i, right + i, out + 2 * i, n_frames - i);
+}
+#endif  // DSP_NEON
+
+
+struct KernelSet {
+    const char* name;
+    void (*gain)(float* const, const size_t, const float);
+    void (*gain_ramp)(float* const, const size_t, const int, const float, const float);
+    void (*mix)(const float* const, float* const, const size_t, const float);
+    void (*crossfade)(const float* const, const float* const, float* const, const size_t, const int, const float, const float);
+    void (*clip)(float* const, const size_t, const float);
+    LevelSums (*level_sums)(const float* const, const size_t);
+    void (*deinterleave_stereo)(const float* const, float* const, float* const, const size_t);
+    void (*interleave_stereo)(const float* const, const float* const, float* const, const size_t);
+};
+
+
+// fastest first
+static std::vector<KernelSet> get_supported_kernel_set_list() {
+    std::vector<KernelSet> kernel_sets;
+#ifdef DSP_X86
+    if (CpuFeatures::has_avx2())
+        kernel_sets.push_back({"avx2", gain_avx2, gain_ramp_avx2, mix_avx2, crossfade_avx2, clip_avx2, level_sums_avx2, deinterleave_stereo_avx2, interleave_stereo_avx2});
+    if (CpuFeatures::has_sse2())
+        kernel_sets.push_back({"sse2", gain_sse2, gain_ramp_sse2, mix_sse2, crossfade_sse2, clip_sse2, level_sums_sse2, deinterleave_stereo_sse2, interleave_stereo_sse2});
+#endif
+#ifdef DSP_NEON
+    if (CpuFeatures::has_neon())
+        kernel_sets.push_back({"neon", gain_neon, gain_ramp_neon, mix_neon, crossfade_neon, clip_neon, level_sums_neon, deinterleave_stereo_neon, interleave_stereo_neon});
+#endif
+
+    kernel_sets.push_back({"scalar", gain_scalar, gain_ramp_scalar, mix_scalar, crossfade_scalar, clip_scalar, level_sums_scalar, deinterleave_stereo_scalar, interleave_stereo_scalar});
+    return kernel_sets;
+}
+
+
+/* selected kernel set; mutable for set_kernel_set()
+ * constant initialized to the scalar set, and replaced by the fastest set during dynamic initialization
+ * so the first kernel call, which may be on the audio thread, doesn't allocate or take a static initialization guard
+ */
+static constinit KernelSet kernel_set = {"scalar", gain_scalar, gain_ramp_scalar, mix_scalar, crossfade_scalar, clip_scalar, level_sums_scalar, deinterleave_stereo_scalar, interleave_stereo_scalar};
+[[maybe_unused]] static const bool kernel_set_selected = (kernel_set = get_supported_kernel_set_list().front(), true);
+
+
+Levels to_levels(const LevelSums& sums) {
+    return {.peak = sums.peak, .rms = (sums.n_samples > 0 ? (float)std::sqrt(sums.sum_squares / sums.n_samples) : 0.0f)};
+}
+
+
+void apply_gain(const std::span<float> samples, const float gain) {
+    kernel_set.gain(samples.data(), samples.size(), gain);
+}
+
+
+void apply_gain_ramp(const std::span<float> samples, const int n_channels, const float start_gain, const float gain_step) {
+    kernel_set.gain_ramp(samples.data(), samples.size() / n_channels, n_channels, start_gain, gain_step);
+}
+
+
+void mix(const std::span<const float> in, const std::span<float> out, const float gain) {
+    kernel_set.mix(in.data(), out.data(), std::min(in.size(), out.size()), gain);
+}
+
+
+void crossfade(const std::span<const float> from, const std::span<const float> to, const std::span<float> out, const int n_channels, const float start_t, const float t_step) {
+    const size_t n_samples = std::min({from.size(), to.size(), out.size()});
+    kernel_set.crossfade(from.data(), to.data(), out.data(), n_samples / n_channels, n_channels, start_t, t_step);
+}
+
+
+void clip(const std::span<float> samples, const float limit) {
+    kernel_set.clip(samples.data(), samples.size(), limit);
+}
+
+
+LevelSums measure_level_sums(const std::span<const float> samples) {
+    return kernel_set.level_sums(samples.data(), samples.size());
+}
+
+
+Levels measure_levels(const std::span<const float> samples) {
+    return to_levels(measure_level_sums(samples));
+}
+
+
+void deinterleave(const float* const in, const int n_channels, float* const out, const size_t channel_stride, const size_t n_frames) {
+    if (n_channels == 2) {
+        kernel_set.deinterleave_stereo(in, out, out + channel_stride, n_frames);
+        return;
+    }
+
+    for (int c = 0; c < n_channels; c++) {
+        float* const channel = out + c * channel_stride;
+        for (size_t i = 0; i < n_frames; i++)
+            channel[i] = in[i * n_channels + c];
+    }
+}
+
+
+void interleave(const float* const in, const size_t channel_stride, const int n_channels, float* const out, const size_t n_frames) {
+    if (n_channels == 2) {
+        kernel_set.interleave_stereo(in, in + channel_stride, out, n_frames);
+        return;
+    }
+
+    for (int c = 0; c < n_channels; c++) {
+        const float* const channel = in + c * channel_stride;
+        for (size_t i = 0; i < n_frames; i++)
+            out[i * n_channels + c] = channel[i];
+    }
+}
+
+
+void sum_channels(const float* const in, const int n_channels, float* const out, const size_t n_frames) {
+    if (n_channels == 2) {
+        for (size_t i = 0; i < n_frames; i++)
+            out[i] = in[2 * i] + in[2 * i + 1];
+        return;
+    }
+
+    for (size_t i = 0; i < n_frames; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < n_channels; c++)
+            sum += in[i * n_channels + c];
+        out[i] = sum;
+    }
+}
+
+
+const char* get_kernel_set_name() {
+    return kernel_set.name;
+}
+
+
+std::vector<std::string> get_supported_kernel_sets() {
+    std::vector<std::string> names;
+    for (const KernelSet& supported : get_supported_kernel_set_list())
+        names.push_back(supported.name);
+    return names;
+}
+
+
+void set_kernel_set(const std::string& name) {
+    for (const KernelSet& supported : get_supported_kernel_set_list()) {
+        if (supported.name == name) {
+            kernel_set = supported;
+            return;
+        }
+    }
+
+    throw Exception("DSP kernel set '" + name + "' is not supported by this CPU");
+}
+
+}  // namespace Dsp
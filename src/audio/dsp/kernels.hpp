@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string>
+#include <vector>
+
+
+/* sample processing kernels on raw float spans
+ * the fastest implementation supported by the CPU (AVX2, SSE2, NEON or scalar) is selected at runtime
+ * kernels don't allocate or lock, so they can be used on the audio thread
+ * for the same operations on WaveData (optionally multithreaded), see audio/dsp/wave_ops.hpp
+ */
+namespace Dsp {
+
+// partial level measurement; partials of consecutive ranges can be combined with combine()
+struct LevelSums {
+    float peak;  // largest magnitude
+    double sum_squares;
+    size_t n_samples;
+};
+
+struct Levels {
+    float peak;
+    float rms;
+};
+
+
+inline LevelSums combine(const LevelSums& a, const LevelSums& b) {
+    return {.peak = (a.peak > b.peak ? a.peak : b.peak), .sum_squares = a.sum_squares + b.sum_squares, .n_samples = a.n_samples + b.n_samples};
+}
+
+Levels to_levels(const LevelSums& sums);
+
+
+void apply_gain(const std::span<float> samples, const float gain);
+/* multiplies interleaved frames by a linear ramp; frame `f` is multiplied by `start_gain + f * gain_step`
+ * used for fades; `samples.size()` must be a multiple of `n_channels`
+ */
+void apply_gain_ramp(const std::span<float> samples, const int n_channels, const float start_gain, const float gain_step);
+// `out += in * gain`; `in` and `out` must have the same size
+void mix(const std::span<const float> in, const std::span<float> out, const float gain);
+/* `out = from + (to - from) * t` with `t` ramping per frame like apply_gain_ramp()
+ * linear crossfade from `from` to `to`; all spans must have the same size and `out` may be `from` or `to`
+ */
+void crossfade(const std::span<const float> from, const std::span<const float> to, const std::span<float> out, const int n_channels, const float start_t, const float t_step);
+// limits samples to [-limit, limit]
+void clip(const std::span<float> samples, const float limit = 1.0f);
+
+// peak and RMS in a single pass; NaN samples give an unspecified peak
+LevelSums measure_level_sums(const std::span<const float> samples);
+Levels measure_levels(const std::span<const float> samples);
+
+
+/* channel layout conversion between interleaved samples and planar channels `channel_stride` samples apart
+ * stereo uses SIMD kernels, as it is the common case at the device boundary; other channel counts are plain loops
+ * `in` and `out` may not overlap
+ */
+void deinterleave(const float* const in, const int n_channels, float* const out, const size_t channel_stride, const size_t n_frames);
+void interleave(const float* const in, const size_t channel_stride, const int n_channels, float* const out, const size_t n_frames);
+// sum of all channels of each frame (not the average, unlike AudioConvert::remix_channels())
+void sum_channels(const float* const in, const int n_channels, float* const out, const size_t n_frames);
+
+
+// name of the selected kernel set; for logging and benchmarks
+const char* get_kernel_set_name();
+
+// names of the kernel sets the CPU supports, fastest first; the first is selected by default
+std::vector<std::string> get_supported_kernel_sets();
+/* selects a kernel set by name, e.g. to compare them in benchmarks
+ * throws exception if the CPU doesn't support it
+ * not thread safe; only call while no kernels are running
+ */
+void set_kernel_set(const std::string& name);
+
+}  // namespace Dsp
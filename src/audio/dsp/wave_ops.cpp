@@ -0,0 +1,224 @@
+#include "audio/dsp/wave_ops.hpp"
+
+#include "exception.hpp"
+#include "thread_pool.hpp"
+#include "audio/wave_data.hpp"
+#include "audio/dsp/kernels.hpp"
+
+#include <algorithm>  // min(), max(), copy()
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <span>
+#include <string>  // to_string()
+#include <type_traits>  // is_void_v
+#include <utility>  // move()
+#include <vector>
+
+
+namespace Dsp {
+
+namespace {
+
+/* calls `process(begin, end)` on parts of [0, `n_samples`), on `thread_pool` if worth it
+ * parts start at a whole frame and a cache line, so no two threads write to the same line
+ * returns the results in order of the parts
+ */
+template <class Process>
+auto for_each_part(const size_t n_samples, const int n_channels, ThreadPool* const thread_pool, const Process& process) {
+    using Result = decltype(process(size_t(0), size_t(0)));
+
+    size_t n_parts = 1;
+    if (thread_pool != nullptr && n_samples >= PARALLEL_THRESHOLD)
+        n_parts = std::max<size_t>(1, std::min<size_t>(thread_pool->get_n_threads() + 1, n_samples / PARALLEL_MIN_PART));
+
+    // 16 floats per cache line
+    const size_t alignment = 16 * n_channels;
+    const size_t min_part_size = (n_samples + n_parts - 1) / n_parts;
+    const size_t part_size = (min_part_size + alignment - 1) / alignment * alignment;
+
+    std::vector<std::future<Result>> futures;
+    for (size_t part = 1; part < n_parts; part++) {
+        const size_t begin = std::min(n_samples, part * part_size);
+        const size_t end = std::min(n_samples, begin + part_size);
+        futures.push_back(thread_pool->submit_with_future([&process, begin, end]() { return process(begin, end); }));
+    }
+
+    // the calling thread takes the first part instead of only waiting
+    if constexpr (std::is_void_v<Result>) {
+        process(0, std::min(n_samples, part_size));
+        for (std::future<Result>& future : futures)
+            future.get();
+    }
+    else {
+        std::vector<Result> results;
+        results.push_back(process(0, std::min(n_samples, part_size)));
+        for (std::future<Result>& future : futures)
+            results.push_back(future.get());
+        return results;
+    }
+}
+
+
+void check_formats(const WaveData& a, const WaveData& b) {
+    if (a.sample_config.sample_rate != b.sample_config.sample_rate || a.sample_config.n_channels != b.sample_config.n_channels)
+        throw Exception("Sample configs of wave data don't match");
+    if (a.layout != b.layout)
+        throw Exception("Sample layouts of wave data don't match");
+}
+
+
+// samples per frame in `samples`; parts of planar samples don't need to start at a frame
+int get_frame_size(const WaveData& wave_data) {
+    return (wave_data.layout == SampleLayout::interleaved ? wave_data.sample_config.n_channels : 1);
+}
+
+
+/* contiguous runs of frames: all channels at once for interleaved samples, or every channel on its own (as mono) for planar samples
+ * run `r` of two views with the same layout and channel count covers the same channels
+ */
+int get_n_runs(const SampleView& view) {
+    return (view.layout == SampleLayout::interleaved ? 1 : view.n_channels);
+}
+
+int get_run_channels(const SampleView& view) {
+    return (view.layout == SampleLayout::interleaved ? view.n_channels : 1);
+}
+
+std::span<float> get_run(const SampleView& view, const int run) {
+    return (view.layout == SampleLayout::interleaved ? view.interleaved() : view.channel(run));
+}
+
+}  // namespace
+
+
+void apply_gain(WaveData& wave_data, const float gain, ThreadPool* const thread_pool) {
+    // planar padding stays silent
+    const std::span<float> samples = wave_data.samples;
+    for_each_part(samples.size(), get_frame_size(wave_data), thread_pool, [&](const size_t begin, const size_t end) {
+        apply_gain(samples.subspan(begin, end - begin), gain);
+    });
+}
+
+
+void clip(WaveData& wave_data, const float limit, ThreadPool* const thread_pool) {
+    const std::span<float> samples = wave_data.samples;
+    for_each_part(samples.size(), get_frame_size(wave_data), thread_pool, [&](const size_t begin, const size_t end) {
+        clip(samples.subspan(begin, end - begin), limit);
+    });
+}
+
+
+Levels measure_levels(const WaveData& wave_data, ThreadPool* const thread_pool) {
+    const std::span<const float> samples = wave_data.samples;
+    const std::vector<LevelSums> parts = for_each_part(samples.size(), get_frame_size(wave_data), thread_pool, [&](const size_t begin, const size_t end) {
+        return measure_level_sums(samples.subspan(begin, end - begin));
+    });
+
+    LevelSums sums = parts.front();
+    for (size_t i = 1; i < parts.size(); i++)
+        sums = combine(sums, parts[i]);
+    // silent planar padding adds nothing to the peak and sum, but shouldn't count as samples
+    sums.n_samples = wave_data.get_n_frames() * wave_data.sample_config.n_channels;
+    return to_levels(sums);
+}
+
+
+void normalize(WaveData& wave_data, const float target_peak, ThreadPool* const thread_pool) {
+    const float peak = measure_levels(wave_data, thread_pool).peak;
+    if (peak == 0.0f)
+        return;
+
+    apply_gain(wave_data, target_peak / peak, thread_pool);
+}
+
+
+void fade_in(WaveData& wave_data, const uint64_t n_frames) {
+    const uint64_t fade_frames = std::min<uint64_t>(n_frames, wave_data.get_n_frames());
+    if (fade_frames == 0)
+        return;
+
+    const SampleView view = wave_data.view().frames(0, fade_frames);
+    for (int r = 0; r < get_n_runs(view); r++)
+        apply_gain_ramp(get_run(view, r), get_run_channels(view), 0.0f, 1.0f / fade_frames);
+}
+
+
+void fade_out(WaveData& wave_data, const uint64_t n_frames) {
+    const uint64_t fade_frames = std::min<uint64_t>(n_frames, wave_data.get_n_frames());
+    if (fade_frames == 0)
+        return;
+
+    // the last frame is silent
+    const float step = 1.0f / std::max<uint64_t>(1, fade_frames - 1);
+    const SampleView view = wave_data.view().frames(wave_data.get_n_frames() - fade_frames, fade_frames);
+    for (int r = 0; r < get_n_runs(view); r++)
+        apply_gain_ramp(get_run(view, r), get_run_channels(view), 1.0f, -step);
+}
+
+
+void mix(const WaveData& in, WaveData& out, const float gain, const uint64_t out_offset, ThreadPool* const thread_pool) {
+    check_formats(in, out);
+
+    if (out_offset >= out.get_n_frames())
+        return;
+
+    const uint64_t n_frames = std::min<uint64_t>(in.get_n_frames(), out.get_n_frames() - out_offset);
+    const SampleView in_view = in.view().frames(0, n_frames);
+    const SampleView out_view = out.view().frames(out_offset, n_frames);
+    for (int r = 0; r < get_n_runs(out_view); r++) {
+        const std::span<const float> in_run = get_run(in_view, r);
+        const std::span<float> out_run = get_run(out_view, r);
+        for_each_part(in_run.size(), get_run_channels(out_view), thread_pool, [&](const size_t begin, const size_t end) {
+            mix(in_run.subspan(begin, end - begin), out_run.subspan(begin, end - begin), gain);
+        });
+    }
+}
+
+
+WaveData crossfade(const WaveData& first, const WaveData& second, const uint64_t overlap_frames) {
+    check_formats(first, second);
+
+    if (overlap_frames > first.get_n_frames() || overlap_frames > second.get_n_frames())
+        throw Exception("Crossfade overlap of " + std::to_string(overlap_frames) + " frames is longer than the wave data");
+
+    const uint64_t first_solo = first.get_n_frames() - overlap_frames;
+    WaveData joined(first.get_n_frames() + second.get_n_frames() - overlap_frames, first.sample_config, first.layout);
+
+    const SampleView first_view = first.view();
+    const SampleView second_view = second.view();
+    const SampleView joined_view = joined.view();
+    const int n_channels = get_run_channels(joined_view);
+    for (int r = 0; r < get_n_runs(joined_view); r++) {
+        const std::span<const float> first_run = get_run(first_view, r);
+        const std::span<const float> second_run = get_run(second_view, r);
+        const std::span<float> joined_run = get_run(joined_view, r);
+
+        const size_t solo = first_solo * n_channels;
+        const size_t overlap = overlap_frames * n_channels;
+        std::copy(first_run.begin(), first_run.begin() + solo, joined_run.begin());
+        if (overlap > 0)
+            crossfade(first_run.subspan(solo), second_run.first(overlap), joined_run.subspan(solo, overlap), n_channels, 0.0f, 1.0f / overlap_frames);
+        std::copy(second_run.begin() + overlap, second_run.end(), joined_run.begin() + solo + overlap);
+    }
+
+    return joined;
+}
+
+
+WaveData to_layout(const WaveData& wave_data, const SampleLayout layout) {
+    const SampleView in = wave_data.view();
+    WaveData converted(in.n_frames, wave_data.sample_config, layout);
+    const SampleView out = converted.view();
+
+    if (in.layout == out.layout)
+        std::copy(wave_data.samples.begin(), wave_data.samples.end(), converted.samples.begin());
+    else if (out.layout == SampleLayout::planar)
+        deinterleave(in.data, in.n_channels, out.data, out.channel_stride, in.n_frames);
+    else
+        interleave(in.data, in.channel_stride, in.n_channels, out.data, in.n_frames);
+
+    return converted;
+}
+
+}  // namespace Dsp
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include "audio/wave_data.hpp"
+#include "audio/dsp/kernels.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+
+/* DSP kernels applied to WaveData
+ * functions taking a `thread_pool` split buffers of at least `PARALLEL_THRESHOLD` samples over its workers and the calling thread
+ * the calling thread blocks until all parts are done, so don't call these with a thread pool from one of its own tasks
+ * modifying a memory mapped WaveData copies the touched pages (copy-on-write)
+ * all work on both sample layouts; functions taking two WaveData require both to have the same layout
+ */
+namespace Dsp {
+
+/* config */
+// smaller buffers are processed on the calling thread, as handing out tasks costs more than it gains
+constexpr size_t PARALLEL_THRESHOLD = 1 << 20;  // samples
+// smallest part handed to a worker
+constexpr size_t PARALLEL_MIN_PART = 1 << 18;  // samples
+
+
+void apply_gain(WaveData& wave_data, const float gain, ThreadPool* const thread_pool = nullptr);
+void clip(WaveData& wave_data, const float limit = 1.0f, ThreadPool* const thread_pool = nullptr);
+Levels measure_levels(const WaveData& wave_data, ThreadPool* const thread_pool = nullptr);
+// scales samples so the peak magnitude is `target_peak`; silence is left as is
+// one pass measuring the peak and one pass applying the gain
+void normalize(WaveData& wave_data, const float target_peak = 1.0f, ThreadPool* const thread_pool = nullptr);
+
+// linear fade from silence over the first `n_frames` frames, or to silence over the last `n_frames` frames
+// `n_frames` is clamped to the length of the wave data
+void fade_in(WaveData& wave_data, const uint64_t n_frames);
+void fade_out(WaveData& wave_data, const uint64_t n_frames);
+
+/* mixes `in`, multiplied by `gain`, into `out` starting at frame `out_offset` of `out`
+ * the part of `in` extending past the end of `out` is dropped
+ * throws exception if the sample configs or layouts don't match
+ */
+void mix(const WaveData& in, WaveData& out, const float gain, const uint64_t out_offset = 0, ThreadPool* const thread_pool = nullptr);
+
+/* joins `first` and `second`, linearly crossfading the last `overlap_frames` frames of `first` with the first of `second`
+ * throws exception if the sample configs or layouts don't match or either is shorter than the overlap
+ */
+WaveData crossfade(const WaveData& first, const WaveData& second, const uint64_t overlap_frames);
+
+// copy of `wave_data` in `layout`; (de)interleaving stereo uses SIMD kernels
+WaveData to_layout(const WaveData& wave_data, const SampleLayout layout);
+
+}  // namespace Dsp
@@ -0,0 +1,258 @@
+#include "audio/mixer.hpp"
+
+#include "exception.hpp"
+#include "audio/wave_data.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/dsp/kernels.hpp"
+
+#include <algorithm>  // min(), max(), clamp()
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>  // to_string()
+#include <utility>  // move()
+
+
+Mixer::Mixer(const SampleConfig& _sample_config)
+    : sample_config(_sample_config),
+      n_voices(0),
+      commands(COMMAND_QUEUE_LENGTH),
+      // every slot ends at most once before it is reused, so this can never overflow
+      ended(MAX_VOICES),
+      current_frame(0),
+      n_active(0)
+{
+    free_slots.reserve(MAX_VOICES);
+    for (int i = MAX_VOICES - 1; i >= 0; i--)
+        free_slots.push_back(i);
+}
+
+
+VoiceId Mixer::play(std::shared_ptr<const WaveData> wave_data, const VoiceSettings& settings) {
+    if (wave_data->sample_config.sample_rate != sample_config.sample_rate || wave_data->sample_config.n_channels != sample_config.n_channels)
+        throw Exception("Wave data doesn't match the mixer's sample config (" + std::to_string(wave_data->sample_config.sample_rate) + " Hz, " + std::to_string(wave_data->sample_config.n_channels) + " channels)");
+
+    if (free_slots.empty())
+        return VoiceId();
+
+    const int slot = free_slots.back();
+    const Command command = {
+        .type = CommandType::play,
+        .slot = slot,
+        .samples = wave_data->samples.data(),
+        .n_frames = wave_data->get_n_frames(),
+        .channel_stride = wave_data->get_channel_stride(),
+        .settings = settings,
+    };
+    if (!send(command))
+        return VoiceId();
+
+    free_slots.pop_back();
+    slots[slot].wave_data = std::move(wave_data);
+    slots[slot].in_use = true;
+    n_voices++;
+
+    return VoiceId{.slot = slot, .generation = slots[slot].generation};
+}
+
+
+void Mixer::stop(const VoiceId& voice) {
+    if (is_playing(voice))
+        send({.type = CommandType::stop, .slot = voice.slot, .samples = nullptr, .n_frames = 0, .channel_stride = 0, .settings = {}});
+}
+
+
+void Mixer::stop_all() {
+    send({.type = CommandType::stop_all, .slot = -1, .samples = nullptr, .n_frames = 0, .channel_stride = 0, .settings = {}});
+}
+
+
+void Mixer::set_gain(const VoiceId& voice, const float gain, const float pan) {
+    if (is_playing(voice))
+        send({.type = CommandType::set_gain, .slot = voice.slot, .samples = nullptr, .n_frames = 0, .channel_stride = 0, .settings = {.gain = gain, .pan = pan}});
+}
+
+
+bool Mixer::is_playing(const VoiceId& voice) const {
+    return voice.is_valid() && slots[voice.slot].in_use && slots[voice.slot].generation == voice.generation;
+}
+
+
+int Mixer::get_n_voices() const {
+    return n_voices;
+}
+
+
+uint64_t Mixer::get_current_frame() const {
+    return current_frame.load(std::memory_order_relaxed);
+}
+
+
+void Mixer::update() {
+    int slot;
+    while (ended.read(&slot, 1) == 1) {
+        slots[slot].wave_data.reset();
+        slots[slot].in_use = false;
+        slots[slot].generation++;
+        free_slots.push_back(slot);
+        n_voices--;
+    }
+}
+
+
+bool Mixer::send(const Command& command) {
+    return commands.write(&command, 1) == 1;
+}
+
+
+void Mixer::mix_into(float* const out, const int n_frames) noexcept {
+    handle_commands();
+
+    const uint64_t block_start = current_frame.load(std::memory_order_relaxed);
+    for (int i = 0; i < n_active;) {
+        if (mix_voice(voices[active[i]], out, n_frames, block_start))
+            i++;
+        else
+            end_voice(i);  // moves the last active voice to `i`
+    }
+
+    current_frame.store(block_start + n_frames, std::memory_order_relaxed);
+}
+
+
+void Mixer::handle_commands() noexcept {
+    Command command;
+    while (commands.read(&command, 1) == 1) {
+        switch (command.type) {
+            case CommandType::play:
+                {
+                    const uint64_t start_offset = command.settings.start_offset;
+                    if (start_offset >= command.n_frames && !command.settings.loop) {
+                        // nothing to play; report it as ended right away
+                        ended.write(&command.slot, 1);
+                        break;
+                    }
+
+                    voices[command.slot] = {
+                        .samples = command.samples,
+                        .n_frames = command.n_frames,
+                        .channel_stride = command.channel_stride,
+                        .position = start_offset % command.n_frames,
+                        .start_frame = command.settings.start_frame,
+                        .loop = command.settings.loop,
+                        .channel_gains = get_channel_gains(command.settings.gain, command.settings.pan),
+                    };
+                    active[n_active++] = command.slot;
+                    break;
+                }
+
+            case CommandType::stop:
+                for (int i = 0; i < n_active; i++) {
+                    if (active[i] == command.slot) {
+                        end_voice(i);
+                        break;
+                    }
+                }
+                break;
+
+            case CommandType::stop_all:
+                while (n_active > 0)
+                    end_voice(n_active - 1);
+                break;
+
+            case CommandType::set_gain:
+                voices[command.slot].channel_gains = get_channel_gains(command.settings.gain, command.settings.pan);
+                break;
+        }
+    }
+}
+
+
+void Mixer::end_voice(const int active_index) noexcept {
+    ended.write(&active[active_index], 1);
+    active[active_index] = active[--n_active];
+}
+
+
+bool Mixer::mix_voice(Voice& voice, float* const out, const int n_frames, const uint64_t block_start) noexcept {
+    // sample accurate start; voices scheduled in the past start right away
+    int out_frame = 0;
+    if (voice.start_frame >= 0) {
+        if ((uint64_t)voice.start_frame >= block_start + n_frames)
+            return true;
+        out_frame = std::max<int64_t>(voice.start_frame - (int64_t)block_start, 0);
+        voice.start_frame = -1;
+    }
+
+    while (out_frame < n_frames) {
+        const int n = std::min<uint64_t>(n_frames - out_frame, voice.n_frames - voice.position);
+        if (voice.channel_stride == 0)
+            mix_frames(voice.samples + voice.position * sample_config.n_channels, out + out_frame * sample_config.n_channels, n, voice.channel_gains);
+        else
+            mix_planar_frames(voice.samples + voice.position, voice.channel_stride, out + out_frame * sample_config.n_channels, n, voice.channel_gains);
+        out_frame += n;
+        voice.position += n;
+
+        if (voice.position == voice.n_frames) {
+            if (!voice.loop)
+                return false;
+            voice.position = 0;
+        }
+    }
+
+    return true;
+}
+
+
+void Mixer::mix_frames(const float* const in, float* const out, const int n_frames, const std::array<float, 2>& channel_gains) const noexcept {
+    // a plain loop without dependencies between iterations, so the compiler vectorizes it
+    if (sample_config.n_channels == 2) {
+        const float left = channel_gains[0],
+                    right = channel_gains[1];
+        for (int i = 0; i < n_frames; i++) {
+            out[2 * i]     += in[2 * i]     * left;
+            out[2 * i + 1] += in[2 * i + 1] * right;
+        }
+    }
+    else {
+        const size_t n_samples = n_frames * sample_config.n_channels;
+        Dsp::mix({in, n_samples}, {out, n_samples}, channel_gains[0]);
+    }
+}
+
+
+void Mixer::mix_planar_frames(const float* const in, const size_t channel_stride, float* const out, const int n_frames, const std::array<float, 2>& channel_gains) const noexcept {
+    // contiguous loads per channel; the compiler vectorizes the loads and multiplies, interleaving happens on store
+    if (sample_config.n_channels == 2) {
+        const float* const left_in = in;
+        const float* const right_in = in + channel_stride;
+        const float left = channel_gains[0],
+                    right = channel_gains[1];
+        for (int i = 0; i < n_frames; i++) {
+            out[2 * i]     += left_in[i]  * left;
+            out[2 * i + 1] += right_in[i] * right;
+        }
+    }
+    else {
+        const int n_channels = sample_config.n_channels;
+        const float gain = channel_gains[0];
+        for (int c = 0; c < n_channels; c++) {
+            const float* const channel = in + c * channel_stride;
+            for (int i = 0; i < n_frames; i++)
+                out[i * n_channels + c] += channel[i] * gain;
+        }
+    }
+}
+
+
+std::array<float, 2> Mixer::get_channel_gains(const float gain, const float pan) const noexcept {
+    if (sample_config.n_channels != 2)
+        return {gain, gain};
+
+    // balance panning; the center keeps both channels at full gain
+    const float clamped_pan = std::clamp(pan, -1.0f, 1.0f);
+    return {
+        gain * std::min(1.0f, 1.0f - clamped_pan),
+        gain * std::min(1.0f, 1.0f + clamped_pan),
+    };
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "audio/wave_data.hpp"
+#include "audio/ring_buffer.hpp"
+#include "audio/audio_source.hpp"
+#include "audio/sample_config.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// identifies a voice started by Mixer::play(); stays unique after the voice ends
+struct VoiceId {
+    int slot = -1;
+    uint32_t generation = 0;
+
+    bool is_valid() const {
+        return slot >= 0;
+    }
+};
+
+
+struct VoiceSettings {
+    float gain = 1.0f;
+    // -1.0 is left, 0.0 is center and 1.0 is right; only used for stereo
+    float pan = 0.0f;
+    // restarts from the beginning of the wave data when the end is reached
+    bool loop = false;
+    // frame of the wave data at which playback starts
+    uint64_t start_offset = 0;
+    // frame of the mixer's timeline (see Mixer::get_current_frame()) at which the voice starts; `< 0` starts right away
+    int64_t start_frame = -1;
+};
+
+
+/* plays many WaveData voices at once on the audio thread
+ * voices reference shared wave data instead of copying it; both sample layouts can be played
+ * the main thread sends commands through a lock-free queue; the audio thread reports back finished voices through another
+ * the audio thread never locks or allocates; wave data is only released on the main thread, in update()
+ * all functions except mix_into() must be called from the same (main) thread
+ */
+class Mixer : public AudioSource {
+    public:
+        Mixer(const SampleConfig& _sample_config);
+
+        Mixer(const Mixer&) = delete;
+        Mixer& operator=(const Mixer&) = delete;
+
+        // throws exception if `wave_data` doesn't match the mixer's sample config
+        // returns an invalid id if all voices are in use
+        VoiceId play(std::shared_ptr<const WaveData> wave_data, const VoiceSettings& settings = {});
+        // does nothing if the voice has already ended
+        void stop(const VoiceId& voice);
+        void stop_all();
+        void set_gain(const VoiceId& voice, const float gain, const float pan);
+
+        bool is_playing(const VoiceId& voice) const;
+        int get_n_voices() const;
+
+        // frames mixed since the mixer started playing; increases in steps of the device's buffer size
+        uint64_t get_current_frame() const;
+
+        // releases the wave data of ended voices
+        void update();
+
+        void mix_into(float* const out, const int n_frames) noexcept override;
+
+
+        /* config */
+        static constexpr int MAX_VOICES = 128;
+        static constexpr int COMMAND_QUEUE_LENGTH = 512;
+
+
+    private:
+        enum class CommandType : uint8_t {
+            play,
+            stop,
+            stop_all,
+            set_gain
+        };
+
+        // trivially copyable, as it goes through the lock-free queue
+        struct Command {
+            CommandType type;
+            int slot;
+            // only set for `play`; kept alive by the main thread's `slots`
+            const float* samples;
+            uint64_t n_frames;
+            // planar channel stride (see SampleView); 0 for interleaved samples
+            size_t channel_stride;
+            VoiceSettings settings;
+        };
+
+        // state of a voice on the audio thread
+        struct Voice {
+            const float* samples;
+            uint64_t n_frames;
+            size_t channel_stride;
+            uint64_t position;
+            int64_t start_frame;
+            bool loop;
+            std::array<float, 2> channel_gains;
+        };
+
+        // state of a voice on the main thread
+        struct Slot {
+            std::shared_ptr<const WaveData> wave_data;
+            uint32_t generation = 0;
+            bool in_use = false;
+        };
+
+        const SampleConfig sample_config;
+
+        /* main thread */
+        std::array<Slot, MAX_VOICES> slots;
+        std::vector<int> free_slots;
+        int n_voices;
+
+        /* shared */
+        SpscRingBuffer<Command> commands;
+        // slots of ended voices
+        SpscRingBuffer<int> ended;
+        std::atomic<uint64_t> current_frame;
+
+        /* audio thread */
+        std::array<Voice, MAX_VOICES> voices;
+        // slots of the voices that are playing, in no particular order
+        std::array<int, MAX_VOICES> active;
+        int n_active;
+
+
+        bool send(const Command& command);
+
+        void handle_commands() noexcept;
+        void end_voice(const int active_index) noexcept;
+        // returns false once the voice has ended
+        bool mix_voice(Voice& voice, float* const out, const int n_frames, const uint64_t block_start) noexcept;
+        void mix_frames(const float* const in, float* const out, const int n_frames, const std::array<float, 2>& channel_gains) const noexcept;
+        // `in` points to the first frame of the first channel
+        void mix_planar_frames(const float* const in, const size_t channel_stride, float* const out, const int n_frames, const std::array<float, 2>& channel_gains) const noexcept;
+        std::array<float, 2> get_channel_gains(const float gain, const float pan) const noexcept;
+};
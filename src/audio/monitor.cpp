@@ -0,0 +1,292 @@
+#include "audio/monitor.hpp"
+
+#include "exception.hpp"
+#include "audio/audio_device.hpp"
+#include "audio/sample_config.hpp"
+#include "audio/dsp/kernels.hpp"
+
+#include <algorithm>  // min(), max(), clamp(), copy(), fill()
+#include <cmath>  // abs()
+#include <cstdint>
+#include <memory>
+#include <utility>  // move()
+
+
+void GainStage::process(float* const samples, const int n_frames, const int n_channels) noexcept {
+    Dsp::apply_gain({samples, static_cast<size_t>(n_frames * n_channels)}, gain.load(std::memory_order_relaxed));
+}
+
+
+AudioMonitor::AudioMonitor(const SampleConfig& _sample_config, const int _frames_per_buffer)
+    : sample_config(_sample_config),
+      frames_per_buffer(_frames_per_buffer),
+      running(false),
+      test_phase(test_idle),
+      measured_latency(0),
+      drift_ratio(1.0),
+      n_dropouts(0),
+      n_input_frames(0),
+      phase(0.0),
+      primed(false),
+      smoothed_fill(0.0),
+      integral(0.0),
+      ratio(1.0),
+      output_frame(0),
+      impulse_frame(0),
+      noise_floor(-1.0f),
+      capture(sample_config, frames_per_buffer, AudioMode::callback),
+      playback(sample_config, frames_per_buffer, AudioMode::callback)
+{
+    // a block at the highest ratio needs `frames_per_buffer * (1 + MAX_DRIFT_CORRECTION) + 2` input frames
+    input.resize((2 * frames_per_buffer + 4) * sample_config.n_channels);
+    block.resize(frames_per_buffer * sample_config.n_channels);
+
+    playback.set_source(this);
+}
+
+
+AudioMonitor::~AudioMonitor() {
+    stop();
+}
+
+
+void AudioMonitor::add_stage(std::unique_ptr<MonitorStage> stage) {
+    if (running)
+        throw Exception("Monitor stages can't be added while the monitor is running");
+
+    stages.push_back(std::move(stage));
+}
+
+
+void AudioMonitor::start() {
+    if (running)
+        return;
+
+    // start both devices from empty buffers, so the capture buffer primes from scratch
+    capture.clear_queued_samples();
+    playback.clear_queued_samples();
+    reset_buffering();
+
+    running = true;
+    capture.unpause_device();
+    playback.unpause_device();
+}
+
+
+void AudioMonitor::stop() {
+    if (!running)
+        return;
+
+    playback.pause_device();
+    capture.pause_device();
+    running = false;
+}
+
+
+bool AudioMonitor::is_running() const {
+    return running;
+}
+
+
+void AudioMonitor::start_latency_test() {
+    int expected = test_phase.load(std::memory_order_acquire);
+    if (expected == test_requested || expected == test_running)
+        return;
+
+    test_phase.compare_exchange_strong(expected, test_requested, std::memory_order_acq_rel);
+}
+
+
+LatencyTestState AudioMonitor::get_latency_test_state() const {
+    switch (test_phase.load(std::memory_order_acquire)) {
+        case test_requested:
+        case test_running:
+            return LatencyTestState::running;
+        case test_succeeded:
+            return LatencyTestState::succeeded;
+        case test_failed:
+            return LatencyTestState::failed;
+        default:
+            return LatencyTestState::idle;
+    }
+}
+
+
+double AudioMonitor::get_round_trip_latency() const {
+    return (measured_latency.load(std::memory_order_relaxed) * 1000.0) / sample_config.sample_rate;
+}
+
+
+double AudioMonitor::get_drift_correction() const {
+    return (drift_ratio.load(std::memory_order_relaxed) - 1.0) * 1000000.0;
+}
+
+
+uint64_t AudioMonitor::get_n_dropouts() const {
+    return n_dropouts.load(std::memory_order_relaxed);
+}
+
+
+void AudioMonitor::mix_into(float* const out, const int n_frames) noexcept {
+    const int n_channels = sample_config.n_channels;
+
+    // SDL may hand over larger buffers than requested; process them in blocks of at most `frames_per_buffer`
+    for (int offset = 0; offset < n_frames; offset += frames_per_buffer) {
+        const int n = std::min(frames_per_buffer, n_frames - offset);
+        float* const out_block = out + offset * n_channels;
+
+        // wait for enough captured audio to absorb the jitter between the two callbacks
+        if (!primed) {
+            if (capture.get_n_queued_frames() < TARGET_FILL * frames_per_buffer) {
+                output_frame += n;
+                continue;
+            }
+            primed = true;
+            smoothed_fill = capture.get_n_queued_frames();
+        }
+
+        drop_excess_input();
+        update_drift_ratio();
+
+        if (!resample(block.data(), n)) {
+            n_dropouts.fetch_add(1, std::memory_order_relaxed);
+            reset_buffering();
+            // the impulse may have been lost; let the test be retried instead of waiting for the timeout
+            int expected = test_running;
+            test_phase.compare_exchange_strong(expected, test_failed, std::memory_order_acq_rel);
+            output_frame += n;
+            continue;
+        }
+
+        // measure on the unprocessed input, as stages may change the level
+        run_latency_test(out_block, n);
+
+        for (const std::unique_ptr<MonitorStage>& stage : stages)
+            stage->process(block.data(), n, n_channels);
+
+        // mute monitored audio while testing, to prevent the impulse from echoing
+        const int phase_now = test_phase.load(std::memory_order_relaxed);
+        if (phase_now != test_requested && phase_now != test_running) {
+            const int n_samples = n * n_channels;
+            for (int i = 0; i < n_samples; i++)
+                out_block[i] += block[i];
+        }
+
+        output_frame += n;
+    }
+}
+
+
+bool AudioMonitor::resample(float* const out, const int n_frames) noexcept {
+    const int n_channels = sample_config.n_channels;
+
+    // linear interpolation between input frames `idx` and `idx + 1`, so the last output frame needs input frame `floor(phase + (n_frames - 1) * ratio) + 1`
+    const int needed = static_cast<int>(phase + (n_frames - 1) * ratio) + 2;
+    if (needed > n_input_frames) {
+        const int missing = needed - n_input_frames;
+        if (capture.get_n_queued_frames() < missing)
+            return false;
+        capture.receive_samples(input.data() + n_input_frames * n_channels, missing * n_channels);
+        n_input_frames = needed;
+    }
+
+    for (int i = 0; i < n_frames; i++) {
+        const double position = phase + i * ratio;
+        const int idx = static_cast<int>(position);
+        const float frac = position - idx;
+        const float* const a = input.data() + idx * n_channels;
+        const float* const b = a + n_channels;
+        for (int c = 0; c < n_channels; c++)
+            out[i * n_channels + c] = a[c] + (b[c] - a[c]) * frac;
+    }
+
+    // keep the frames still needed for interpolation in the next block
+    const double end = phase + n_frames * ratio;
+    const int consumed = std::min(static_cast<int>(end), n_input_frames);
+    std::copy(input.begin() + consumed * n_channels, input.begin() + n_input_frames * n_channels, input.begin());
+    n_input_frames -= consumed;
+    phase = end - consumed;
+
+    return true;
+}
+
+
+void AudioMonitor::update_drift_ratio() noexcept {
+    // fill error in buffers; frames held by the resampler count as queued
+    const double fill = capture.get_n_queued_frames() + n_input_frames - phase;
+    smoothed_fill += FILL_SMOOTHING * (fill - smoothed_fill);
+    const double error = (smoothed_fill - TARGET_FILL * frames_per_buffer) / frames_per_buffer;
+
+    // limit the integral to what the ratio can correct to prevent windup
+    const double max_integral = MAX_DRIFT_CORRECTION / DRIFT_KI;
+    integral = std::clamp(integral + error, -max_integral, max_integral);
+
+    // a growing buffer means capture runs faster than playback, so consume input faster
+    ratio = 1.0 + std::clamp(DRIFT_KP * error + DRIFT_KI * integral, -MAX_DRIFT_CORRECTION, MAX_DRIFT_CORRECTION);
+    drift_ratio.store(ratio, std::memory_order_relaxed);
+}
+
+
+void AudioMonitor::run_latency_test(float* const out, const int n_frames) noexcept {
+    const int n_channels = sample_config.n_channels;
+
+    int expected = test_requested;
+    if (test_phase.compare_exchange_strong(expected, test_running, std::memory_order_acq_rel))
+        impulse_frame = output_frame;
+
+    // the returning impulse and its echo mustn't raise the noise floor, so it is only followed while no test runs
+    if (test_phase.load(std::memory_order_relaxed) != test_running) {
+        const float block_peak = Dsp::measure_levels({block.data(), static_cast<size_t>(n_frames * n_channels)}).peak;
+        noise_floor = (noise_floor < 0.0f ? block_peak : noise_floor + NOISE_FLOOR_SMOOTHING * (block_peak - noise_floor));
+        return;
+    }
+
+    // look for the impulse coming back in the captured audio
+    const float threshold = std::max(IMPULSE_MIN_THRESHOLD, noise_floor * IMPULSE_THRESHOLD_RATIO);
+    for (int i = 0; i < n_frames; i++) {
+        for (int c = 0; c < n_channels; c++) {
+            if (std::abs(block[i * n_channels + c]) > threshold) {
+                measured_latency.store(output_frame + i - impulse_frame, std::memory_order_relaxed);
+                test_phase.store(test_succeeded, std::memory_order_release);
+                return;
+            }
+        }
+    }
+
+    const uint64_t timeout_frames = (LATENCY_TEST_TIMEOUT / 1000.0) * sample_config.sample_rate;
+    if (output_frame + n_frames - impulse_frame > timeout_frames) {
+        test_phase.store(test_failed, std::memory_order_release);
+        return;
+    }
+
+    // play the impulse
+    for (int i = 0; i < n_frames; i++) {
+        const uint64_t frame = output_frame + i;
+        if (frame >= impulse_frame && frame < impulse_frame + IMPULSE_LENGTH)
+            std::fill(out + i * n_channels, out + (i + 1) * n_channels, IMPULSE_AMPLITUDE);
+    }
+}
+
+
+void AudioMonitor::drop_excess_input() noexcept {
+    // after a stall, catching up by resampling would take far too long, so skip ahead instead
+    const int n_queued = capture.get_n_queued_frames();
+    if (n_queued <= MAX_FILL * frames_per_buffer)
+        return;
+
+    int excess = n_queued - TARGET_FILL * frames_per_buffer;
+    while (excess > 0) {
+        const int n = std::min(excess, frames_per_buffer);
+        capture.receive_samples(block.data(), n * sample_config.n_channels);
+        excess -= n;
+    }
+    smoothed_fill = TARGET_FILL * frames_per_buffer;
+}
+
+
+void AudioMonitor::reset_buffering() noexcept {
+    // the integral is kept, as the clock drift doesn't change when re-buffering
+    primed = false;
+    n_input_frames = 0;
+    phase = 0.0;
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "audio/audio_device.hpp"
+#include "audio/audio_source.hpp"
+#include "audio/sample_config.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+
+// processes monitored audio between capture and playback
+class MonitorStage {
+    public:
+        virtual ~MonitorStage() = default;
+
+        /* processes `n_frames` frames of interleaved float samples in place
+         * runs on SDL's audio thread; may not lock, allocate or log
+         */
+        virtual void process(float* const samples, const int n_frames, const int n_channels) noexcept = 0;
+};
+
+
+class GainStage : public MonitorStage {
+    public:
+        GainStage(const float _gain) : gain(_gain) {}
+
+        void set_gain(const float _gain) {
+            gain.store(_gain, std::memory_order_relaxed);
+        }
+
+        void process(float* const samples, const int n_frames, const int n_channels) noexcept override;
+
+
+    private:
+        std::atomic<float> gain;
+};
+
+
+enum class LatencyTestState {
+    idle,
+    running,
+    succeeded,
+    failed
+};
+
+
+/* full-duplex pipeline playing back captured audio live (input monitoring)
+ * opens a capture and playback device with the same sample config, both in callback mode
+ * the playback callback pulls captured frames, runs them through the stages in order and plays them
+ *
+ * the two devices run on their own clocks, so the capture side produces slightly more or fewer frames than playback consumes
+ * to keep the capture buffer from slowly growing or starving, the captured audio is resampled at a ratio close to 1
+ * the ratio is steered by a PI controller towards keeping `TARGET_FILL` buffers of captured audio queued
+ *
+ * the round-trip latency (output, through speakers/cables, back into the input and out again) is measured with a loopback impulse test
+ * all functions except mix_into() must be called from the same (main) thread
+ */
+class AudioMonitor : public AudioSource {
+    public:
+        // throws exception if a device fails to open
+        AudioMonitor(const SampleConfig& _sample_config, const int _frames_per_buffer = 128);
+        ~AudioMonitor();
+
+        AudioMonitor(const AudioMonitor&) = delete;
+        AudioMonitor& operator=(const AudioMonitor&) = delete;
+
+        // stages run in the order they are added
+        // throws exception if the monitor is running
+        void add_stage(std::unique_ptr<MonitorStage> stage);
+
+        void start();
+        void stop();
+        bool is_running() const;
+
+        /* plays an impulse and waits for it to come back through the input; monitored audio is muted meanwhile
+         * the output has to be looped back to the input, e.g. by a cable or a microphone near the speakers
+         * the impulse is detected relative to the input's noise floor, so steady background noise doesn't trigger it
+         * does nothing if a test is already running
+         */
+        void start_latency_test();
+        LatencyTestState get_latency_test_state() const;
+        // round-trip latency in milliseconds; only valid if the last test succeeded
+        double get_round_trip_latency() const;
+
+        // current correction of the capture clock relative to the playback clock, in parts per million
+        double get_drift_correction() const;
+        // number of times the monitor ran out of captured frames and had to re-buffer
+        uint64_t get_n_dropouts() const;
+
+        void mix_into(float* const out, const int n_frames) noexcept override;
+
+
+        /* config */
+        // number of device buffers of captured audio kept queued; lower is less latency, but more dropouts on a busy system
+        static constexpr double TARGET_FILL = 2.0;
+        // captured frames beyond this many buffers are dropped, e.g. after the system stalled
+        static constexpr double MAX_FILL = 8.0;
+        // maximum deviation of the resampling ratio from 1; real clocks deviate by far less
+        static constexpr double MAX_DRIFT_CORRECTION = 0.002;
+        // PI controller gains, applied to the fill error in buffers
+        static constexpr double DRIFT_KP = 0.0001;
+        static constexpr double DRIFT_KI = 0.0000001;
+        // smoothing of the measured fill level, as the capture buffer fills in bursts
+        static constexpr double FILL_SMOOTHING = 0.01;
+
+        static constexpr int IMPULSE_LENGTH = 16;  // frames
+        static constexpr float IMPULSE_AMPLITUDE = 0.9f;
+        // returning impulse is detected when a sample exceeds the noise floor this many times, and at least `IMPULSE_MIN_THRESHOLD`
+        static constexpr float IMPULSE_THRESHOLD_RATIO = 4.0f;  // 12 dB
+        static constexpr float IMPULSE_MIN_THRESHOLD = 0.01f;  // -40 dBFS
+        // smoothing of the noise floor, which follows the peak level of each block of captured audio while no test runs
+        static constexpr float NOISE_FLOOR_SMOOTHING = 0.02f;
+        static constexpr double LATENCY_TEST_TIMEOUT = 1000.0;  // milliseconds
+
+
+    private:
+        // internal states extend LatencyTestState with `requested`
+        enum LatencyTestPhase : int {
+            test_idle,
+            test_requested,
+            test_running,
+            test_succeeded,
+            test_failed
+        };
+
+        const SampleConfig sample_config;
+        const int frames_per_buffer;
+
+        /* main thread */
+        bool running;
+
+        /* shared */
+        std::atomic<int> test_phase;
+        std::atomic<int64_t> measured_latency;  // frames
+        std::atomic<double> drift_ratio;
+        std::atomic<uint64_t> n_dropouts;
+
+        /* audio thread (playback) */
+        std::vector<std::unique_ptr<MonitorStage>> stages;
+        // captured frames not yet fully consumed by the resampler; frame 0 is at resampling position 0
+        std::vector<float> input;
+        int n_input_frames;
+        double phase;  // fractional resampling position, in [0, 1)
+        std::vector<float> block;
+        bool primed;
+        double smoothed_fill;
+        double integral;
+        double ratio;
+        uint64_t output_frame;
+        uint64_t impulse_frame;
+        // negative until the first block is measured
+        float noise_floor;
+
+        // declared last, so they are closed before the state their callbacks use is destroyed
+        AudioCapture capture;
+        AudioPlayback playback;
+
+
+        // returns false if not enough captured frames are available
+        bool resample(float* const out, const int n_frames) noexcept;
+        void update_drift_ratio() noexcept;
+        void run_latency_test(float* const out, const int n_frames) noexcept;
+        void drop_excess_input() noexcept;
+        void reset_buffering() noexcept;
+};
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>  // min(), copy()
+#include <atomic>
+#include <bit>  // bit_ceil()
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+
+/* lock-free single-producer/single-consumer ring buffer
+ * one thread may call write()/free_space() while another calls read()/size(); both are wait-free and never allocate
+ * producer and consumer indices live on separate cache lines to prevent false sharing
+ * each side caches the other side's index, so the shared index is only loaded when the cached one isn't enough
+ */
+template <class T>
+class SpscRingBuffer {
+    static_assert(std::is_trivially_copyable_v<T>, "Ring buffer elements are copied as raw memory");
+
+
+    public:
+        // capacity is rounded up to the next power of two
+        SpscRingBuffer(const size_t min_capacity)
+            : buffer_capacity(std::bit_ceil(std::max<size_t>(min_capacity, 2))),
+              mask(buffer_capacity - 1),
+              buffer(std::make_unique<T[]>(buffer_capacity)) {}
+
+        SpscRingBuffer(const SpscRingBuffer&) = delete;
+        SpscRingBuffer& operator=(const SpscRingBuffer&) = delete;
+
+        size_t capacity() const noexcept {
+            return buffer_capacity;
+        }
+
+
+        /* producer side */
+        // writes at most `n` elements; returns number of elements written
+        size_t write(const T* const data, const size_t n) noexcept {
+            const size_t tail = write_index.load(std::memory_order_relaxed);
+            if (buffer_capacity - (tail - producer_cached_read_index) < n)
+                producer_cached_read_index = read_index.load(std::memory_order_acquire);
+
+            const size_t n_write = std::min(n, buffer_capacity - (tail - producer_cached_read_index));
+            copy_in(tail, data, n_write);
+            write_index.store(tail + n_write, std::memory_order_release);
+
+            return n_write;
+        }
+
+        size_t free_space() const noexcept {
+            return buffer_capacity - size();
+        }
+
+
+        /* consumer side */
+        // reads at most `n` elements; returns number of elements read
+        size_t read(T* const data, const size_t n) noexcept {
+            const size_t head = read_index.load(std::memory_order_relaxed);
+            if (consumer_cached_write_index - head < n)
+                consumer_cached_write_index = write_index.load(std::memory_order_acquire);
+
+            const size_t n_read = std::min(n, consumer_cached_write_index - head);
+            copy_out(head, data, n_read);
+            read_index.store(head + n_read, std::memory_order_release);
+
+            return n_read;
+        }
+
+
+        /* either side */
+        // exact on the calling side; the other side may concurrently change it
+        size_t size() const noexcept {
+            const size_t head = read_index.load(std::memory_order_acquire);
+            const size_t tail = write_index.load(std::memory_order_acquire);
+            return tail - head;
+        }
+
+        // discards all elements
+        // not thread safe; producer and consumer may not access the buffer concurrently (e.g. lock the audio device)
+        void clear() noexcept {
+            read_index.store(write_index.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            producer_cached_read_index = consumer_cached_write_index = write_index.load(std::memory_order_relaxed);
+        }
+
+
+    private:
+        static constexpr size_t CACHE_LINE = 64;
+
+        const size_t buffer_capacity;
+        const size_t mask;
+        const std::unique_ptr<T[]> buffer;
+
+        // indices increase monotonically and wrap around on overflow; `index & mask` is the position in the buffer
+        alignas(CACHE_LINE) std::atomic<size_t> write_index = 0;
+        size_t producer_cached_read_index = 0;
+
+        alignas(CACHE_LINE) std::atomic<size_t> read_index = 0;
+        size_t consumer_cached_write_index = 0;
+
+
+        void copy_in(const size_t index, const T* const data, const size_t n) noexcept {
+            const size_t start = index & mask;
+            const size_t first = std::min(n, buffer_capacity - start);
+            std::copy(data, data + first, buffer.get() + start);
+            std::copy(data + first, data + n, buffer.get());
+        }
+
+        void copy_out(const size_t index, T* const data, const size_t n) const noexcept {
+            const size_t start = index & mask;
+            const size_t first = std::min(n, buffer_capacity - start);
+            std::copy(buffer.get() + start, buffer.get() + start + first, data);
+            std::copy(buffer.get(), buffer.get() + (n - first), data + first);
+        }
+};
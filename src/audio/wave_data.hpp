@@ -1,40 +1,173 @@
 #pragma once
 
 #include "exception.hpp"
+#include "mapped_file.hpp"
+#include "aligned_allocator.hpp"
 #include "audio/sample_config.hpp"
 
+#include <cassert>
+#include <cstddef>
 #include <vector>
 #include <limits>
+#include <span>
+#include <variant>
+#include <utility>  // move()
+#include <string>  // to_string()
+
+
+/* order of samples in memory
+ * interleaved: the samples of a frame are adjacent (L R L R ...); what audio devices and files use
+ * planar:      every channel is a contiguous array (L L ... R R ...); per channel processing needs no strides
+ */
+enum class SampleLayout {
+    interleaved,
+    planar
+};
+
+
+/* view on samples in either layout; copying it doesn't copy any samples
+ * the sample of `frame` and `channel` is at `data[frame * n_channels + channel]` (interleaved) or `data[channel * channel_stride + frame]` (planar)
+ */
+struct SampleView {
+    float* data;
+    size_t n_frames;
+    int n_channels;
+    SampleLayout layout;
+    // distance between the starts of two planar channels; unused for interleaved samples
+    size_t channel_stride;
+
+
+    float& at(const size_t frame, const int channel) const {
+        return (layout == SampleLayout::interleaved ? data[frame * n_channels + channel] : data[channel * channel_stride + frame]);
+    }
+
+    // contiguous samples of `channel`; only for planar (or mono) samples
+    std::span<float> channel(const int channel) const {
+        assert((layout == SampleLayout::planar || n_channels == 1) && "Channels of interleaved samples aren't contiguous");
+        return {data + channel * channel_stride, n_frames};
+    }
+
+    // all samples; only for interleaved (or mono) samples
+    std::span<float> interleaved() const {
+        assert((layout == SampleLayout::interleaved || n_channels == 1) && "Planar samples aren't interleaved");
+        return {data, n_frames * n_channels};
+    }
+
+    // view on frames [`first`, `first + n`)
+    SampleView frames(const size_t first, const size_t n) const {
+        return {.data = (layout == SampleLayout::interleaved ? data + first * n_channels : data + first), .n_frames = n, .n_channels = n_channels, .layout = layout, .channel_stride = channel_stride};
+    }
+};
 
 
 /* floating point sample data
- * channels must be interleaved
+ * channels are interleaved, unless constructed with SampleLayout::planar
  * there must be at least 1 sample per channel and at most `INT_MAX - overflow_headroom` samples
  * as there cannot be more than INT_MAX samples, `samples.size()` can safely be converted to `int`
+ * `samples` is a view on either an owned vector or a memory mapped file; modifying a mapped file's samples is copy-on-write
+ * planar channels are owned and start at a `CHANNEL_ALIGNMENT` byte boundary
+ *   `samples` then covers all channels one after another, each followed by silent padding up to the next boundary
+ *   the padding must stay silent, so whole-buffer operations like gain and peak metering can run on `samples` at once
  */
 struct WaveData {
     const SampleConfig sample_config;
-    std::vector<float> samples;
+    const SampleLayout layout;
+    std::span<float> samples;
 
 
     WaveData(const SampleConfig& _sample_config)
-        : sample_config(_sample_config) {}
+        : sample_config(_sample_config), layout(SampleLayout::interleaved), n_frames(0) {}
 
     // WaveData(float* data, const int size, const SampleConfig& _sample_config)
     //     : sample_config(_sample_config), samples(std::make_move_iterator(data), std::make_move_iterator(data + size)) {}
 
     static constexpr int max_n_samples = std::numeric_limits<int>::max();
+    static constexpr size_t CHANNEL_ALIGNMENT = 64;  // bytes
 
     WaveData(std::vector<float>&& data, const SampleConfig& _sample_config)
-        : sample_config(_sample_config), samples(std::move(data))
+        : sample_config(_sample_config), layout(SampleLayout::interleaved), storage(std::move(data))
+    {
+        std::vector<float>& owned_samples = std::get<std::vector<float>>(storage);
+        samples = std::span<float>(owned_samples.data(), owned_samples.size());
+        n_frames = samples.size() / sample_config.n_channels;
+        validate();
+    }
+
+    // zero-copy view on `n_samples` floats starting `byte_offset` bytes into `file`
+    // the data must be aligned for float and in native byte order
+    WaveData(MappedFile&& file, const size_t byte_offset, const size_t n_samples, const SampleConfig& _sample_config)
+        : sample_config(_sample_config), layout(SampleLayout::interleaved), storage(std::move(file))
     {
-        if (samples.size() == 0)
-            throw Exception("Empty audio data");
+        MappedFile& mapped_file = std::get<MappedFile>(storage);
+        if (byte_offset + n_samples * sizeof(float) > mapped_file.size())
+            throw Exception("Mapped audio data extends past end of file");
+        if (byte_offset % alignof(float) != 0)
+            throw Exception("Mapped audio data is not aligned");
 
-        if (samples.size() > max_n_samples)
-            throw Exception("Audio data is too long  (" + std::to_string(samples.size()) + " > " + std::to_string(max_n_samples) + ")");
+        samples = std::span<float>(reinterpret_cast<float*>(mapped_file.data() + byte_offset), n_samples);
+        n_frames = samples.size() / sample_config.n_channels;
+        validate();
+    }
+
+    // silence of `_n_frames` frames in `_layout`
+    WaveData(const size_t _n_frames, const SampleConfig& _sample_config, const SampleLayout _layout)
+        : sample_config(_sample_config), layout(_layout), n_frames(_n_frames)
+    {
+        if (layout == SampleLayout::interleaved) {
+            std::vector<float>& owned_samples = storage.emplace<std::vector<float>>(n_frames * sample_config.n_channels, 0.0f);
+            samples = std::span<float>(owned_samples.data(), owned_samples.size());
+        }
+        else {
+            AlignedSamples& owned_samples = storage.emplace<AlignedSamples>(get_channel_stride() * sample_config.n_channels, 0.0f);
+            samples = std::span<float>(owned_samples.data(), owned_samples.size());
+        }
+        validate();
+    }
+
+    // moving keeps `samples` valid, as neither storage type relocates its data on move
+    WaveData(WaveData&&) = default;
+    // copying would make `samples` point into the source's storage
+    WaveData(const WaveData&) = delete;
+
+    bool is_mapped() const {
+        return std::holds_alternative<MappedFile>(storage);
+    }
+
+    size_t get_n_frames() const {
+        return n_frames;
+    }
+
+    // distance in samples between the starts of two planar channels; 0 for interleaved samples
+    size_t get_channel_stride() const {
+        constexpr size_t floats_per_boundary = CHANNEL_ALIGNMENT / sizeof(float);
+        return (layout == SampleLayout::planar ? (n_frames + floats_per_boundary - 1) / floats_per_boundary * floats_per_boundary : 0);
+    }
+
+    SampleView view() const {
+        return {.data = samples.data(), .n_frames = n_frames, .n_channels = sample_config.n_channels, .layout = layout, .channel_stride = get_channel_stride()};
+    }
 
-        if (samples.size() % sample_config.n_channels != 0)
-            throw Exception("Not all channels are equal in length");
+    // contiguous samples of a planar (or mono) channel
+    std::span<float> channel(const int channel) const {
+        return view().channel(channel);
     }
+
+
+    private:
+        using AlignedSamples = std::vector<float, AlignedAllocator<float, CHANNEL_ALIGNMENT>>;
+
+        size_t n_frames;
+        std::variant<std::vector<float>, AlignedSamples, MappedFile> storage;
+
+
+        void validate() const {
+            if (samples.size() == 0)
+                throw Exception("Empty audio data");
+
+            if (samples.size() > max_n_samples)
+                throw Exception("Audio data is too long  (" + std::to_string(samples.size()) + " > " + std::to_string(max_n_samples) + ")");
+
+            if (layout == SampleLayout::interleaved && samples.size() % sample_config.n_channels != 0)
+                throw Exception("Not all channels are equal in length");
+        }
 };
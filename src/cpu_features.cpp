@@ -0,0 +1,28 @@
+#include "cpu_features.hpp"
+
+
+namespace CpuFeatures {
+
+#if defined(__x86_64__) || defined(__i386__)
+bool has_sse2() {
+    static const bool supported = __builtin_cpu_supports("sse2");
+    return supported;
+}
+
+
+bool has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+#else
+bool has_sse2() {
+    return false;
+}
+
+
+bool has_avx2() {
+    return false;
+}
+#endif
+
+}  // namespace CpuFeatures
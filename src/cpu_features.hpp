@@ -0,0 +1,21 @@
+#pragma once
+
+
+/* runtime detection of instruction set extensions
+ * used to select SIMD kernels; always false on architectures they don't apply to
+ */
+namespace CpuFeatures {
+
+bool has_sse2();
+bool has_avx2();
+
+// ARM NEON is mandatory on AArch64, so it is detected at compile time
+constexpr bool has_neon() {
+#if defined(__aarch64__) || defined(__ARM_NEON)
+    return true;
+#else
+    return false;
+#endif
+}
+
+}  // namespace CpuFeatures
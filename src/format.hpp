@@ -0,0 +1,15 @@
+#pragma once
+
+/* std::format() where the standard library has it (GCC 13+, Clang 17+), else the fmt library it was standardized from
+ * use as `Fmt::format()`, `Fmt::format_to_n()` and `Fmt::format_string`; format strings are checked at compile time by both
+ */
+
+#include <version>  // __cpp_lib_format
+
+#ifdef __cpp_lib_format
+#include <format>
+namespace Fmt = std;
+#else
+#include <fmt/format.h>
+namespace Fmt = fmt;
+#endif
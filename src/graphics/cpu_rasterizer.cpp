@@ -0,0 +1,504 @@
+#include "graphics/cpu_rasterizer.hpp"
+
+#include "thread_pool.hpp"
+#include "logger.hpp"
+#include "cpu_features.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>  // min(), max(), clamp(), fill_n(), find_if()
+#include <array>
+#include <atomic>
+#include <cmath>  // ceil(), floor()
+#include <cstdint>
+#include <thread>  // this_thread::yield()
+#include <vector>  // erase_if()
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RASTER_X86
+#include <immintrin.h>
+#endif
+
+
+/* blend kernels; `dst = src * src_alpha + dst * (1 - src_alpha)` per channel, with the source's alpha channel counting as 1 (SDL_BLENDMODE_BLEND) */
+namespace {
+
+// x / 255, rounded; exact for x <= 255 * 255
+inline uint32_t div255(const uint32_t x) {
+    const uint32_t t = x + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+
+inline uint32_t blend_pixel(const uint32_t dst, const uint32_t src) {
+    const uint32_t a = src >> 24;
+    if (a == 0)
+        return dst;
+    if (a == 0xff)
+        return src;
+
+    const uint32_t ia = 0xff - a;
+    const uint32_t out_a = div255(0xff * a + (dst >> 24) * ia),
+                   out_r = div255(((src >> 16) & 0xff) * a + ((dst >> 16) & 0xff) * ia),
+                   out_g = div255(((src >> 8) & 0xff) * a + ((dst >> 8) & 0xff) * ia),
+                   out_b = div255((src & 0xff) * a + (dst & 0xff) * ia);
+    return (out_a << 24) | (out_r << 16) | (out_g << 8) | out_b;
+}
+
+
+void blend_span_scalar(uint32_t* const dst, const uint32_t* const src, const int n) {
+    for (int i = 0; i < n; i++)
+        dst[i] = blend_pixel(dst[i], src[i]);
+}
+
+
+void blend_solid_scalar(uint32_t* const dst, const uint32_t color, const int n) {
+    for (int i = 0; i < n; i++)
+        dst[i] = blend_pixel(dst[i], color);
+}
+
+
+#ifdef RASTER_X86
+/* SSE2 kernels; channels are widened to 16 bits, so the products fit */
+__attribute__((target("sse2")))
+inline __m128i div255_sse2(const __m128i x) {
+    const __m128i t = _mm_add_epi16(x, _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+
+__attribute__((target("sse2")))
+inline __m128i blend4_sse2(const __m128i dst, const __m128i src) {
+    const __m128i zero = _mm_setzero_si128(),
+                  max = _mm_set1_epi16(0xff);
+
+    // alpha of every pixel in all four of its 16 bit channels
+    __m128i a = _mm_srli_epi32(src, 24);
+    a = _mm_or_si128(a, _mm_slli_epi32(a, 16));
+    const __m128i a_lo = _mm_unpacklo_epi32(a, a),
+                  a_hi = _mm_unpackhi_epi32(a, a);
+    const __m128i s = _mm_or_si128(src, _mm_set1_epi32((int)0xff000000));
+
+    const __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(s, zero), a_lo), _mm_mullo_epi16(_mm_unpacklo_epi8(dst, zero), _mm_sub_epi16(max, a_lo))),
+                  hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(s, zero), a_hi), _mm_mullo_epi16(_mm_unpackhi_epi8(dst, zero), _mm_sub_epi16(max, a_hi)));
+    return _mm_packus_epi16(div255_sse2(lo), div255_sse2(hi));
+}
+
+
+__attribute__((target("sse2")))
+void blend_span_sse2(uint32_t* const dst, const uint32_t* const src, const int n) {
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), blend4_sse2(d, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i))));
+    }
+    blend_span_scalar(dst + i, src + i, n - i);
+}
+
+
+__attribute__((target("sse2")))
+void blend_solid_sse2(uint32_t* const dst, const uint32_t color, const int n) {
+    const __m128i src = _mm_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), blend4_sse2(d, src));
+    }
+    blend_solid_scalar(dst + i, color, n - i);
+}
+
+
+/* AVX2 kernels; unpacking and packing work per 128 bit lane, so pixels stay in place */
+__attribute__((target("avx2")))
+inline __m256i div255_avx2(const __m256i x) {
+    const __m256i t = _mm256_add_epi16(x, _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+
+__attribute__((target("avx2")))
+inline __m256i blend8_avx2(const __m256i dst, const __m256i src) {
+    const __m256i zero = _mm256_setzero_si256(),
+                  max = _mm256_set1_epi16(0xff);
+
+    __m256i a = _mm256_srli_epi32(src, 24);
+    a = _mm256_or_si256(a, _mm256_slli_epi32(a, 16));
+    const __m256i a_lo = _mm256_unpacklo_epi32(a, a),
+                  a_hi = _mm256_unpackhi_epi32(a, a);
+    const __m256i s = _mm256_or_si256(src, _mm256_set1_epi32((int)0xff000000));
+
+    const __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(s, zero), a_lo), _mm256_mullo_epi16(_mm256_unpacklo_epi8(dst, zero), _mm256_sub_epi16(max, a_lo))),
+                  hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(s, zero), a_hi), _mm256_mullo_epi16(_mm256_unpackhi_epi8(dst, zero), _mm256_sub_epi16(max, a_hi)));
+    return _mm256_packus_epi16(div255_avx2(lo), div255_avx2(hi));
+}
+
+
+__attribute__((target("avx2")))
+void blend_span_avx2(uint32_t* const dst, const uint32_t* const src, const int n) {
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), blend8_avx2(d, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i))));
+    }
+    blend_span_scalar(dst + i, src + i, n - i);
+}
+
+
+__attribute__((target("avx2")))
+void blend_solid_avx2(uint32_t* const dst, const uint32_t color, const int n) {
+    const __m256i src = _mm256_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), blend8_avx2(d, src));
+    }
+    blend_solid_scalar(dst + i, color, n - i);
+}
+#endif  // RASTER_X86
+
+
+struct BlendKernels {
+    const char* name;
+    void (*blend_span)(uint32_t* const, const uint32_t* const, const int);
+    void (*blend_solid)(uint32_t* const, const uint32_t, const int);
+};
+
+
+// fastest supported by the CPU; the scalar loops are left to the compiler's vectorizer on other architectures
+const BlendKernels& get_blend_kernels() {
+    static const BlendKernels kernels = []() -> BlendKernels {
+#ifdef RASTER_X86
+        if (CpuFeatures::has_avx2())
+            return {"avx2", blend_span_avx2, blend_solid_avx2};
+        if (CpuFeatures::has_sse2())
+            return {"sse2", blend_span_sse2, blend_solid_sse2};
+#endif
+        return {"scalar", blend_span_scalar, blend_solid_scalar};
+    }();
+    return kernels;
+}
+
+
+// per channel linear interpolation of two pixels with `weight` of `b` out of 256; red and blue, and alpha and green, are interpolated together
+inline uint32_t lerp_pixel(const uint32_t a, const uint32_t b, const uint32_t weight) {
+    const uint32_t rb = ((a & 0x00ff00ff) * (256 - weight) + (b & 0x00ff00ff) * weight) >> 8,
+                   ag = ((a >> 8) & 0x00ff00ff) * (256 - weight) + ((b >> 8) & 0x00ff00ff) * weight;
+    return (rb & 0x00ff00ff) | (ag & 0xff00ff00);
+}
+
+
+inline uint32_t tint_pixel(const uint32_t pixel, const uint32_t color) {
+    return (div255((pixel >> 24) * (color >> 24)) << 24)
+         | (div255(((pixel >> 16) & 0xff) * ((color >> 16) & 0xff)) << 16)
+         | (div255(((pixel >> 8) & 0xff) * ((color >> 8) & 0xff)) << 8)
+         | div255((pixel & 0xff) * (color & 0xff));
+}
+
+}  // namespace
+
+
+struct CpuRasterizer::Job {
+    CpuRasterizer* rasterizer;
+    int n_tiles;  // of `rasterizer->active_tiles`
+    std::atomic<int> next_tile;
+    std::atomic<int> n_done;
+    // the rasterizer's reference plus one per submitted task which hasn't finished
+    std::atomic<int> n_refs = 1;
+
+    void release() {
+        if (n_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            delete this;
+    }
+
+    void run() {
+        for (int i = next_tile.fetch_add(1, std::memory_order_relaxed); i < n_tiles; i = next_tile.fetch_add(1, std::memory_order_relaxed)) {
+            rasterizer->render_tile(rasterizer->active_tiles[i]);
+            if (n_done.fetch_add(1, std::memory_order_acq_rel) + 1 == n_tiles)
+                n_done.notify_all();
+        }
+    }
+};
+
+
+CpuRasterizer::CpuRasterizer(ThreadPool& _thread_pool, const int w, const int h)
+    : thread_pool(_thread_pool),
+      frame_w(0),
+      frame_h(0),
+      clip_rect({.x = 0, .y = 0, .w = 0, .h = 0}),
+      warned_unknown_texture(false),
+      tiles_x(0),
+      tiles_y(0),
+      job(nullptr)
+{
+    resize(w, h);
+    Logger::debug("CPU rasterizer uses {} blend kernels", get_blend_kernels().name);
+}
+
+
+CpuRasterizer::~CpuRasterizer() {
+    if (job == nullptr)
+        return;
+
+    /* the pool outlives the rasterizer, so tasks which haven't started yet still run; wait for them, as the pool drops queued tasks when it's destroyed
+     * tasks of jobs replaced earlier were queued before these, so they have been taken from the queue by then as well
+     */
+    while (job->n_refs.load(std::memory_order_acquire) != 1)
+        std::this_thread::yield();
+    job->release();
+}
+
+
+void CpuRasterizer::resize(const int w, const int h) {
+    frame_w = std::max(w, 0);
+    frame_h = std::max(h, 0);
+    pixels.assign((size_t)frame_w * frame_h, 0);
+    clip_rect = {.x = 0, .y = 0, .w = frame_w, .h = frame_h};
+
+    commands.clear();
+    images.clear();
+    tiles_x = (frame_w + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (frame_h + TILE_SIZE - 1) / TILE_SIZE;
+    tile_commands.assign(tiles_x * tiles_y, {});
+    active_tiles.clear();
+}
+
+
+int CpuRasterizer::get_w() const {
+    return frame_w;
+}
+
+
+int CpuRasterizer::get_h() const {
+    return frame_h;
+}
+
+
+const uint32_t* CpuRasterizer::get_pixels() const {
+    return pixels.data();
+}
+
+
+void CpuRasterizer::add_texture(SDL_Texture* const texture, const CpuImage& image) {
+    remove_texture(texture);
+    textures.push_back({.texture = texture, .image = image});
+}
+
+
+void CpuRasterizer::remove_texture(SDL_Texture* const texture) {
+    std::erase_if(textures, [texture](const TextureEntry& entry) { return entry.texture == texture; });
+}
+
+
+void CpuRasterizer::clear_textures() {
+    textures.clear();
+}
+
+
+void CpuRasterizer::set_clip_rect(const SDL_Rect* const clip) {
+    const SDL_Rect frame = {.x = 0, .y = 0, .w = frame_w, .h = frame_h};
+    if (clip == NULL)
+        clip_rect = frame;
+    else if (!SDL_IntersectRect(clip, &frame, &clip_rect))
+        clip_rect = {.x = 0, .y = 0, .w = 0, .h = 0};
+}
+
+
+void CpuRasterizer::clear(const SDL_Color& color) {
+    if (SDL_RectEmpty(&clip_rect))
+        return;
+
+    commands.push_back({
+        .x0 = clip_rect.x,
+        .y0 = clip_rect.y,
+        .x1 = clip_rect.x + clip_rect.w,
+        .y1 = clip_rect.y + clip_rect.h,
+        .u0 = 0.0f, .v0 = 0.0f, .du = 0.0f, .dv = 0.0f,
+        .color = ((uint32_t)color.a << 24) | ((uint32_t)color.r << 16) | ((uint32_t)color.g << 8) | color.b,
+        .image = SOLID,
+        .blend = false,
+    });
+}
+
+
+void CpuRasterizer::draw_quads(SDL_Texture* const texture, const SDL_Vertex* const vertices, const int n_quads) {
+    int32_t image_index = SOLID;
+    if (texture != NULL) {
+        const auto entry = std::find_if(textures.begin(), textures.end(), [texture](const TextureEntry& e) { return e.texture == texture; });
+        if (entry == textures.end()) {
+            if (!warned_unknown_texture) {
+                Logger::warning("CPU rasterizer has no pixels for a queued texture; its quads are skipped");
+                warned_unknown_texture = true;
+            }
+            return;
+        }
+
+        const auto image = std::find_if(images.begin(), images.end(), [&entry](const CpuImage& i) { return i.pixels == entry->image.pixels; });
+        image_index = image - images.begin();
+        if (image == images.end())
+            images.push_back(entry->image);
+    }
+    const float image_w = (image_index == SOLID ? 0.0f : (float)images[image_index].w),
+                image_h = (image_index == SOLID ? 0.0f : (float)images[image_index].h);
+
+    for (int q = 0; q < n_quads; q++) {
+        const SDL_Vertex& top_left = vertices[q * 4];
+        const SDL_Vertex& bottom_right = vertices[q * 4 + 2];
+        const float qx0 = top_left.position.x,
+                    qy0 = top_left.position.y,
+                    qx1 = bottom_right.position.x,
+                    qy1 = bottom_right.position.y;
+
+        // pixels whose centers are inside; the top left edges are inclusive
+        const int x0 = std::max((int)std::ceil(qx0 - 0.5f), clip_rect.x),
+                  y0 = std::max((int)std::ceil(qy0 - 0.5f), clip_rect.y),
+                  x1 = std::min((int)std::ceil(qx1 - 0.5f), clip_rect.x + clip_rect.w),
+                  y1 = std::min((int)std::ceil(qy1 - 0.5f), clip_rect.y + clip_rect.h);
+        if (x0 >= x1 || y0 >= y1)
+            continue;
+
+        const SDL_Color& c = top_left.color;
+        Command command = {
+            .x0 = x0, .y0 = y0, .x1 = x1, .y1 = y1,
+            .u0 = 0.0f, .v0 = 0.0f, .du = 0.0f, .dv = 0.0f,
+            .color = ((uint32_t)c.a << 24) | ((uint32_t)c.r << 16) | ((uint32_t)c.g << 8) | c.b,
+            .image = image_index,
+            .blend = true,
+        };
+        if (image_index != SOLID) {
+            command.du = (bottom_right.tex_coord.x - top_left.tex_coord.x) * image_w / (qx1 - qx0);
+            command.dv = (bottom_right.tex_coord.y - top_left.tex_coord.y) * image_h / (qy1 - qy0);
+            command.u0 = top_left.tex_coord.x * image_w + (x0 + 0.5f - qx0) * command.du;
+            command.v0 = top_left.tex_coord.y * image_h + (y0 + 0.5f - qy0) * command.dv;
+        }
+        commands.push_back(command);
+    }
+}
+
+
+void CpuRasterizer::render() {
+    if (commands.empty())
+        return;
+
+    bin_commands();
+
+    // tasks of an earlier frame which haven't started yet still hold the old job; they find no tiles left in it
+    if (job == nullptr || job->n_refs.load(std::memory_order_acquire) != 1) {
+        if (job != nullptr)
+            job->release();
+        job = new Job;
+    }
+    job->rasterizer = this;
+    job->n_tiles = active_tiles.size();
+    job->next_tile = 0;
+    job->n_done = 0;
+
+    // capturing a plain pointer fits in std::function's small buffer, so submitting doesn't allocate
+    const int n_helpers = std::min(thread_pool.get_n_threads(), job->n_tiles - 1);
+    job->n_refs.fetch_add(n_helpers, std::memory_order_relaxed);
+    for (int i = 0; i < n_helpers; i++)
+        thread_pool.submit([shared_job = job]() {
+            shared_job->run();
+            shared_job->release();
+        });
+    job->run();
+
+    // wait for the tiles the helpers claimed
+    for (int n_done = job->n_done.load(std::memory_order_acquire); n_done < job->n_tiles; n_done = job->n_done.load(std::memory_order_acquire))
+        job->n_done.wait(n_done, std::memory_order_acquire);
+
+    // keep capacity, so the next frame doesn't allocate
+    for (const int tile : active_tiles)
+        tile_commands[tile].clear();
+    active_tiles.clear();
+    commands.clear();
+    images.clear();
+}
+
+
+void CpuRasterizer::bin_commands() {
+    for (uint32_t i = 0; i < commands.size(); i++) {
+        const Command& command = commands[i];
+        const int tx1 = (command.x1 - 1) / TILE_SIZE,
+                  ty1 = (command.y1 - 1) / TILE_SIZE;
+        for (int ty = command.y0 / TILE_SIZE; ty <= ty1; ty++) {
+            for (int tx = command.x0 / TILE_SIZE; tx <= tx1; tx++) {
+                std::vector<uint32_t>& tile = tile_commands[ty * tiles_x + tx];
+                if (tile.empty())
+                    active_tiles.push_back(ty * tiles_x + tx);
+                tile.push_back(i);
+            }
+        }
+    }
+}
+
+
+void CpuRasterizer::render_tile(const int tile) {
+    const SDL_Rect tile_rect = {
+        .x = (tile % tiles_x) * TILE_SIZE,
+        .y = (tile / tiles_x) * TILE_SIZE,
+        .w = std::min(TILE_SIZE, frame_w - (tile % tiles_x) * TILE_SIZE),
+        .h = std::min(TILE_SIZE, frame_h - (tile / tiles_x) * TILE_SIZE),
+    };
+
+    for (const uint32_t i : tile_commands[tile]) {
+        const Command& command = commands[i];
+        const int x0 = std::max(command.x0, tile_rect.x),
+                  y0 = std::max(command.y0, tile_rect.y),
+                  x1 = std::min(command.x1, tile_rect.x + tile_rect.w),
+                  y1 = std::min(command.y1, tile_rect.y + tile_rect.h);
+        render_command(command, {.x = x0, .y = y0, .w = x1 - x0, .h = y1 - y0});
+    }
+}
+
+
+void CpuRasterizer::render_command(const Command& command, const SDL_Rect& area) {
+    const BlendKernels& kernels = get_blend_kernels();
+    const uint32_t alpha = command.color >> 24;
+
+    if (command.image == SOLID) {
+        if (command.blend && alpha == 0)
+            return;
+
+        for (int y = area.y; y < area.y + area.h; y++) {
+            uint32_t* const row = pixels.data() + (size_t)y * frame_w + area.x;
+            if (!command.blend || alpha == 0xff)
+                std::fill_n(row, area.w, command.color);
+            else
+                kernels.blend_solid(row, command.color, area.w);
+        }
+        return;
+    }
+
+    if (alpha == 0)
+        return;
+    std::array<uint32_t, TILE_SIZE> texels;
+    for (int y = area.y; y < area.y + area.h; y++) {
+        sample_row(command, images[command.image], area.x, y, area.w, texels.data());
+        kernels.blend_span(pixels.data() + (size_t)y * frame_w + area.x, texels.data(), area.w);
+    }
+}
+
+
+/*static*/ void CpuRasterizer::sample_row(const Command& command, const CpuImage& image, const int x, const int y, const int n, uint32_t* const out) {
+    // texel centers are at +0.5; texture coordinates outside the image are clamped to its edge
+    // coordinates are rounded to 1/256 texel first, so 1:1 mappings which are off by a rounding error don't blend neighbouring texels
+    const int v_fixed = (int)std::floor((command.v0 + (y - command.y0) * command.dv - 0.5f) * 256.0f + 0.5f);
+    const uint32_t v_weight = v_fixed & 0xff;
+    const uint32_t* const row0 = image.pixels + (size_t)std::clamp(v_fixed >> 8, 0, image.h - 1) * image.pitch;
+    const uint32_t* const row1 = image.pixels + (size_t)std::clamp((v_fixed >> 8) + 1, 0, image.h - 1) * image.pitch;
+
+    float u = command.u0 + (x - command.x0) * command.du - 0.5f;
+    for (int i = 0; i < n; i++, u += command.du) {
+        const int u_fixed = (int)std::floor(u * 256.0f + 0.5f);
+        const uint32_t u_weight = u_fixed & 0xff;
+        const int u0 = std::clamp(u_fixed >> 8, 0, image.w - 1),
+                  u1 = std::clamp((u_fixed >> 8) + 1, 0, image.w - 1);
+        out[i] = lerp_pixel(lerp_pixel(row0[u0], row0[u1], u_weight), lerp_pixel(row1[u0], row1[u1], u_weight), v_weight);
+    }
+
+    // text and most sprites aren't tinted
+    if (command.color != 0xffffffff) {
+        for (int i = 0; i < n; i++)
+            out[i] = tint_pixel(out[i], command.color);
+    }
+}
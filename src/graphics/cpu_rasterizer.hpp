@@ -0,0 +1,114 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include "aligned_allocator.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <cstdint>
+#include <vector>
+
+
+// CPU copy of a texture's pixels; ARGB8888, not premultiplied
+struct CpuImage {
+    const uint32_t* pixels;
+    int w, h;
+    int pitch;  // pixels per row
+};
+
+
+/* draws the quads of a RenderQueue into an ARGB8888 frame in memory instead of through an SDL_Renderer
+ * the frame is split into tiles; queued quads are binned to the tiles they overlap and the tiles are rasterized in parallel on the thread pool
+ *   within a tile quads are drawn in the order they were queued, so the result doesn't depend on the number of threads
+ *   the calling thread rasterizes tiles as well, so a thread pool busy with other work only makes render() slower
+ * blending matches SDL_BLENDMODE_BLEND and textures are sampled bilinearly (SDL_ScaleModeLinear); blending uses SSE2 or AVX2 if the CPU supports it
+ * SDL can't read textures back, so textures are mapped to CPU copies of their pixels through add_texture(); quads of other textures are skipped
+ * the frame keeps its contents between render() calls, so parts of it can be redrawn (retained rendering)
+ * all functions, except for the tile rasterization on the pool, run on the calling thread; only use from the render thread
+ */
+class CpuRasterizer {
+    public:
+        // the frame starts out transparent black
+        CpuRasterizer(ThreadPool& _thread_pool, const int w, const int h);
+        ~CpuRasterizer();
+
+        CpuRasterizer(const CpuRasterizer&) = delete;
+        CpuRasterizer& operator=(const CpuRasterizer&) = delete;
+
+        // clears the frame and the clip rectangle; drops queued drawing
+        void resize(const int w, const int h);
+        int get_w() const;
+        int get_h() const;
+        // rows of get_w() pixels; valid until the next resize()
+        const uint32_t* get_pixels() const;
+
+        // `image.pixels` must stay valid until the texture is removed; pixels changed later are picked up by the next render()
+        void add_texture(SDL_Texture* const texture, const CpuImage& image);
+        void remove_texture(SDL_Texture* const texture);
+        void clear_textures();
+
+        // limits queued drawing to `clip`; NULL for the whole frame
+        void set_clip_rect(const SDL_Rect* const clip);
+        // fills the clip rectangle with `color`, without blending
+        void clear(const SDL_Color& color);
+        /* queues `n_quads` quads of four vertices, laid out as RenderQueue passes them: axis aligned with the corners in the order
+         * top left, top right, bottom right, bottom left; the color of the first vertex is used for the whole quad
+         * `texture` is NULL for solid quads
+         */
+        void draw_quads(SDL_Texture* const texture, const SDL_Vertex* const vertices, const int n_quads);
+
+        // rasterizes all queued drawing into the frame; returns when the frame is done
+        void render();
+
+
+        /* config */
+        static constexpr int TILE_SIZE = 64;  // pixels
+
+
+    private:
+        static constexpr int32_t SOLID = -1;
+
+        struct Command {
+            // covered pixels, clipped; a pixel is covered if its center is in the quad
+            int x0, y0, x1, y1;  // x1 and y1 exclusive
+            // texel coordinates of the center of pixel (x0, y0) and their step per pixel
+            float u0, v0, du, dv;
+            uint32_t color;  // ARGB
+            int32_t image;  // index in `images`, or `SOLID`
+            bool blend;
+        };
+
+        struct TextureEntry {
+            SDL_Texture* texture;
+            CpuImage image;
+        };
+
+        // shared with the pool's tasks; tasks which start after the frame finished find no tiles left and don't touch the rasterizer
+        // reference counted and reused by the next frame once no task holds it, so rendering a frame doesn't allocate
+        struct Job;
+
+        ThreadPool& thread_pool;
+
+        int frame_w, frame_h;
+        std::vector<uint32_t, AlignedAllocator<uint32_t, 64>> pixels;
+        SDL_Rect clip_rect;
+
+        std::vector<TextureEntry> textures;
+        // logged once, as it would repeat every frame
+        bool warned_unknown_texture;
+
+        // reused between frames
+        std::vector<Command> commands;
+        std::vector<CpuImage> images;  // of the queued commands
+        int tiles_x, tiles_y;
+        std::vector<std::vector<uint32_t>> tile_commands;  // command indices per tile
+        std::vector<int> active_tiles;  // tiles with commands
+        Job* job;
+
+
+        void bin_commands();
+        void render_tile(const int tile);
+        void render_command(const Command& command, const SDL_Rect& area);
+        // `out` gets the tinted texels of one row of a textured command
+        static void sample_row(const Command& command, const CpuImage& image, const int x, const int y, const int n, uint32_t* const out);
+};
@@ -3,20 +3,20 @@
 #include "window.hpp"
 #include "logger.hpp"
 
-#include "graphics/text_texture.hpp"
+#include "graphics/glyph_atlas.hpp"
+#include "graphics/render_queue.hpp"
 
 #include <SDL2/SDL.h>
-#include <SDL2/SDL_ttf.h>
 
-#include <string>
-#include <cmath>
+#include <algorithm>  // copy(), min(), max()
+#include <array>
+#include <charconv>  // to_chars()
+#include <string_view>
 
 
-FpsCounter::FpsCounter(SDL_Renderer* const _renderer, TTF_Font* const _font)
-    : renderer(_renderer),
-      font(_font),
-      fps_text(renderer, "FPS: ", font, text_color),
-      ufps_text(renderer, "uFPS: ", font, text_color)
+FpsCounter::FpsCounter(RenderQueue& _render_queue, GlyphAtlas& _text_atlas)
+    : render_queue(_render_queue),
+      text_atlas(_text_atlas)
 {
     //
 }
@@ -26,105 +26,90 @@ void FpsCounter::render(const FpsCounterData& data, const Resolution& res) {
     if (!data.show_fps)
         return;
 
-    SDL_Rect fps_text_dst, fps_value_dst;
-    // SDL_Rect ufps_text_dst, ufps_value_dst;
-
-    // int h_offset = 0;
-    const int fps_value = std::round(data.fps);
-    TextTexture fps_value_text(renderer, std::to_string(fps_value), font, text_color);
-    // TextTexture fps_value_text(renderer, std::to_string((int)std::round(data.unlocked_fps)), font, text_color);
-    const double fps_text_ar = (double)fps_text.get_w() / fps_text.get_h();
-    const int fps_text_width = data.text_height * fps_text_ar;
-    const double fps_value_text_ar = (double)fps_value_text.get_w() / fps_value_text.get_h();
-    const int fps_value_text_width = data.text_height * fps_value_text_ar;
-    if (data.location == FpsCounterLocation::top_left) {
-        fps_text_dst = {
-            .x = 0,
-            .y = 0,
-            .w = fps_text_width,
-            .h = data.text_height,
-        };
-        fps_value_dst = {
-            .x = fps_text_width,
-            .y = 0,
-            .w = fps_value_text_width,
-            .h = data.text_height,
-        };
-    }
-    else if (data.location == FpsCounterLocation::top_right) {
-        fps_text_dst = {
-            .x = (res.w - fps_text_width) - fps_value_text_width,
-            .y = 0,
-            .w = fps_text_width,
-            .h = data.text_height,
-        };
-        fps_value_dst = {
-            .x = res.w - fps_value_text_width,
-            .y = 0,
-            .w = fps_value_text_width,
-            .h = data.text_height,
-        };
-    }
-    else if (data.location == FpsCounterLocation::bottom_left) {
-        fps_text_dst = {
-            .x = 0,
-            .y = res.h - data.text_height,
-            .w = fps_text_width,
-            .h = data.text_height,
-        };
-        fps_value_dst = {
-            .x = fps_text_width,
-            .y = res.h - data.text_height,
-            .w = fps_value_text_width,
-            .h = data.text_height,
-        };
+    Layout l;
+    layout(data, res, l);
+
+    // render shaded background
+    if (data.background_alpha > 0) {
+        const SDL_FRect bg_dst = {.x = (float)l.bg_dst.x, .y = (float)l.bg_dst.y, .w = (float)l.bg_dst.w, .h = (float)l.bg_dst.h};
+        render_queue.add_rect(bg_dst, {.r=0x00, .g=0x00, .b=0x00, .a=data.background_alpha});
     }
-    else if (data.location == FpsCounterLocation::bottom_right) {
-        fps_text_dst = {
-            .x = (res.w - fps_text_width) - fps_value_text_width,
-            .y = res.h - data.text_height,
-            .w = fps_text_width,
-            .h = data.text_height,
-        };
-        fps_value_dst = {
-            .x = res.w - fps_value_text_width,
-            .y = res.h - data.text_height,
-            .w = fps_value_text_width,
-            .h = data.text_height,
-        };
+
+    // right align lines on the right side
+    const bool align_right = (data.location == FpsCounterLocation::top_right || data.location == FpsCounterLocation::bottom_right);
+    for (int i = 0; i < l.n_lines; i++) {
+        const int x = (align_right ? l.text_dst.x + l.text_width - text_atlas.get_text_width(l.lines[i], data.text_height) : l.text_dst.x);
+        text_atlas.add_text(render_queue, l.lines[i], x, l.text_dst.y + i * data.text_height, data.text_height, text_color);
     }
-    else {
-        Logger::error("Invalid FpsCounterLocation; defaulting to top_right");
-
-        // default to top_right
-        // TODO: refactor this repeated code
-        fps_text_dst = {
-            .x = (res.w - fps_text_width) - fps_value_text_width,
-            .y = 0,
-            .w = fps_text_width,
-            .h = data.text_height,
-        };
-        fps_value_dst = {
-            .x = res.w - fps_value_text_width,
-            .y = 0,
-            .w = fps_value_text_width,
-            .h = data.text_height,
-        };
+}
+
+
+SDL_Rect FpsCounter::get_bounds(const FpsCounterData& data, const Resolution& res) {
+    if (!data.show_fps)
+        return {.x = 0, .y = 0, .w = 0, .h = 0};
+
+    Layout l;
+    layout(data, res, l);
+    if (SDL_RectEmpty(&l.bg_dst))
+        return l.text_dst;
+
+    SDL_Rect bounds;
+    SDL_UnionRect(&l.text_dst, &l.bg_dst, &bounds);
+    return bounds;
+}
+
+
+void FpsCounter::layout(const FpsCounterData& data, const Resolution& res, Layout& out) {
+    const std::string_view fps_text = format_fps(out.fps_buffer, "FPS: ", data.fps, data.fps_decimals);
+    const std::string_view unlocked_fps_text = (data.show_unlocked_fps ? format_fps(out.unlocked_fps_buffer, "Unlocked: ", data.unlocked_fps, data.fps_decimals) : std::string_view());
+    out.lines = {fps_text, unlocked_fps_text};
+
+    out.n_lines = (data.show_unlocked_fps ? 2 : 1);
+    out.text_width = std::max(text_atlas.get_text_width(fps_text, data.text_height), text_atlas.get_text_width(unlocked_fps_text, data.text_height));
+    SDL_Rect& text_dst = out.text_dst;
+    text_dst = {
+        .x = 0,
+        .y = 0,
+        .w = out.text_width,
+        .h = out.n_lines * data.text_height,
+    };
+    switch (data.location) {
+        case FpsCounterLocation::top_left:
+            break;
+
+        case FpsCounterLocation::top_right:
+            text_dst.x = res.w - out.text_width;
+            break;
+
+        case FpsCounterLocation::bottom_left:
+            text_dst.y = res.h - text_dst.h;
+            break;
+
+        case FpsCounterLocation::bottom_right:
+            text_dst.x = res.w - out.text_width;
+            text_dst.y = res.h - text_dst.h;
+            break;
+
+        default:
+            Logger::error("Invalid FpsCounterLocation; defaulting to top_right");
+            text_dst.x = res.w - out.text_width;
+            break;
     }
 
-    // render shaded background
+    out.bg_dst = {.x = 0, .y = 0, .w = 0, .h = 0};
     if (data.background_alpha > 0) {
-        SDL_Rect bg_dst = {
-            .x = std::max(fps_text_dst.x - data.background_margin, 0),
-            .y = std::max(fps_text_dst.y - data.background_margin, 0),
-            .w = std::min(fps_text_dst.w + fps_value_dst.w + data.background_margin, res.w),
-            .h = std::min(fps_text_dst.h + data.background_margin, res.h),
+        out.bg_dst = {
+            .x = std::max(text_dst.x - data.background_margin, 0),
+            .y = std::max(text_dst.y - data.background_margin, 0),
+            .w = std::min(text_dst.w + data.background_margin, res.w),
+            .h = std::min(text_dst.h + data.background_margin, res.h),
         };
-
-        SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, data.background_alpha);
-        SDL_RenderFillRect(renderer, &bg_dst);
     }
+}
+
 
-    SDL_RenderCopy(renderer, fps_text, NULL, &fps_text_dst);
-    SDL_RenderCopy(renderer, fps_value_text, NULL, &fps_value_dst);
+/*static*/ std::string_view FpsCounter::format_fps(std::array<char, 48>& buffer, const std::string_view prefix, const double fps, const unsigned int decimals) {
+    char* const value_start = std::copy(prefix.begin(), prefix.end(), buffer.data());
+    const char* const text_end = std::to_chars(value_start, buffer.data() + buffer.size(), fps, std::chars_format::fixed, std::min(decimals, MAX_DECIMALS)).ptr;
+    return std::string_view(buffer.data(), text_end - buffer.data());
 }
@@ -1,10 +1,15 @@
 #pragma once
 
-#include "graphics/text_texture.hpp"
+#include "graphics/glyph_atlas.hpp"
+#include "graphics/render_queue.hpp"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 
+#include <array>
+#include <cstdint>
+#include <string_view>
+
 
 enum class FpsCounterLocation {
     top_left,
@@ -20,7 +25,7 @@ struct FpsCounterData {
 
     FpsCounterLocation location = FpsCounterLocation::top_right;
     int text_height = 30;  // pixels
-    unsigned int fps_decimals = 3;  // TODO!
+    unsigned int fps_decimals = 0;
 
     double fps = -1.0;
     double unlocked_fps = -1.0;
@@ -28,6 +33,9 @@ struct FpsCounterData {
     // set to 0 to turn off (255 for solid)
     uint8_t background_alpha = 75;
     int background_margin = 5;  // pixels
+
+    // increment after every change which alters what is drawn; retained rendering only redraws changed elements
+    uint64_t version = 0;
 };
 
 
@@ -37,19 +45,36 @@ struct Resolution;
 
 class FpsCounter {
     public:
-        FpsCounter(SDL_Renderer* const _renderer, TTF_Font* const _font);
+        // `_render_queue` and `_text_atlas` must outlive this object
+        FpsCounter(RenderQueue& _render_queue, GlyphAtlas& _text_atlas);
 
+        // queues the counter on the render queue
         void render(const FpsCounterData& data, const Resolution& res);
+        // area render() draws to; empty if it draws nothing
+        SDL_Rect get_bounds(const FpsCounterData& data, const Resolution& res);
 
 
         /* config */
         static constexpr SDL_Color text_color = {.r=0xff, .g=0xff, .b=0xff, .a=0xff};
+        static constexpr unsigned int MAX_DECIMALS = 6;
 
 
     private:
-        SDL_Renderer* const renderer;
-        TTF_Font* const font;
+        RenderQueue& render_queue;
+        GlyphAtlas& text_atlas;
+
+        struct Layout {
+            // formatted without heap allocations; `lines` point into the buffers
+            std::array<char, 48> fps_buffer, unlocked_fps_buffer;
+            std::array<std::string_view, 2> lines;
+            int n_lines;
+            int text_width;
+            SDL_Rect text_dst;
+            SDL_Rect bg_dst;  // empty without background
+        };
+
+
+        void layout(const FpsCounterData& data, const Resolution& res, Layout& out);
 
-        TextTexture fps_text;
-        TextTexture ufps_text;
+        static std::string_view format_fps(std::array<char, 48>& buffer, const std::string_view prefix, const double fps, const unsigned int decimals);
 };
@@ -0,0 +1,223 @@
+#include "graphics/glyph_atlas.hpp"
+
+#include "exception.hpp"
+#include "logger.hpp"
+#include "graphics/render_queue.hpp"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <algorithm>  // max(), fill(), copy()
+
+
+// decodes the UTF-8 code point starting at `text[i]` and advances `i` past it
+// invalid sequences decode to U+FFFD (replacement character)
+static uint32_t next_codepoint(const std::string_view text, size_t& i) {
+    const unsigned char lead = text[i++];
+    if (lead < 0x80)
+        return lead;
+
+    int n_continuation;
+    uint32_t codepoint;
+    if ((lead & 0xe0) == 0xc0) {
+        n_continuation = 1;
+        codepoint = lead & 0x1f;
+    }
+    else if ((lead & 0xf0) == 0xe0) {
+        n_continuation = 2;
+        codepoint = lead & 0x0f;
+    }
+    else if ((lead & 0xf8) == 0xf0) {
+        n_continuation = 3;
+        codepoint = lead & 0x07;
+    }
+    else
+        return 0xfffd;
+
+    for (int j = 0; j < n_continuation; j++) {
+        if (i >= text.size() || (static_cast<unsigned char>(text[i]) & 0xc0) != 0x80)
+            return 0xfffd;
+        codepoint = (codepoint << 6) | (static_cast<unsigned char>(text[i++]) & 0x3f);
+    }
+
+    return codepoint;
+}
+
+
+GlyphAtlas::GlyphAtlas(SDL_Renderer* const _renderer, TTF_Font* const _font)
+    : renderer(_renderer),
+      font(_font),
+      font_height(TTF_FontHeight(font)),
+      pen_x(0),
+      pen_y(0),
+      shelf_h(0),
+      pixels(ATLAS_W * ATLAS_H, 0)
+{
+    create_atlas();
+}
+
+
+GlyphAtlas::~GlyphAtlas() {
+    SDL_DestroyTexture(atlas);
+}
+
+
+int GlyphAtlas::get_text_width(const std::string_view text, const int text_height) {
+    const double scale = (double)text_height / font_height;
+
+    int width = 0;  // at font size
+    uint32_t prev_codepoint = 0;
+    for (size_t i = 0; i < text.size();) {
+        const uint32_t codepoint = next_codepoint(text, i);
+        if (prev_codepoint != 0)
+            width += TTF_GetFontKerningSizeGlyphs32(font, prev_codepoint, codepoint);
+        width += get_glyph(codepoint).advance;
+        prev_codepoint = codepoint;
+    }
+
+    return (int)(width * scale + 0.5);
+}
+
+
+int GlyphAtlas::add_text(RenderQueue& queue, const std::string_view text, const int x, const int y, const int text_height, const SDL_Color& color, const int layer) {
+    const float scale = (float)text_height / font_height;
+
+    float pen = (float)x;
+    uint32_t prev_codepoint = 0;
+    for (size_t i = 0; i < text.size();) {
+        const uint32_t codepoint = next_codepoint(text, i);
+        if (prev_codepoint != 0)
+            pen += TTF_GetFontKerningSizeGlyphs32(font, prev_codepoint, codepoint) * scale;
+        prev_codepoint = codepoint;
+
+        const Glyph& glyph = get_glyph(codepoint);
+        if (glyph.in_atlas && glyph.src.w > 0) {
+            const SDL_FRect dst = {.x = pen, .y = (float)y, .w = glyph.src.w * scale, .h = glyph.src.h * scale};
+            queue.add_quad(atlas, glyph.src, dst, color, layer);
+        }
+
+        pen += glyph.advance * scale;
+    }
+
+    return (int)(pen - x + 0.5f);
+}
+
+
+SDL_Texture* GlyphAtlas::get_texture() const {
+    return atlas;
+}
+
+
+const uint32_t* GlyphAtlas::get_pixels() const {
+    return pixels.data();
+}
+
+
+void GlyphAtlas::reset() {
+    SDL_DestroyTexture(atlas);
+    atlas = NULL;
+
+    pen_x = 0;
+    pen_y = 0;
+    shelf_h = 0;
+    other_glyphs.clear();
+
+    create_atlas();
+}
+
+
+void GlyphAtlas::create_atlas() {
+    atlas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, ATLAS_W, ATLAS_H);
+    if (atlas == NULL)
+        throw Exception("Failed to create glyph atlas texture\nSDL error: " + std::string(SDL_GetError()));
+    SDL_SetTextureBlendMode(atlas, SDL_BLENDMODE_BLEND);
+    SDL_SetTextureScaleMode(atlas, SDL_ScaleModeBest);
+
+    // clear the atlas, as static textures start with undefined content
+    std::fill(pixels.begin(), pixels.end(), 0);
+    SDL_UpdateTexture(atlas, NULL, pixels.data(), ATLAS_W * sizeof(uint32_t));
+
+    ascii_cached.fill(false);
+    for (uint32_t c = PRELOAD_FIRST; c <= PRELOAD_LAST; c++)
+        get_glyph(c);
+}
+
+
+const GlyphAtlas::Glyph& GlyphAtlas::get_glyph(const uint32_t codepoint) {
+    if (codepoint < ascii_glyphs.size()) {
+        if (!ascii_cached[codepoint]) {
+            ascii_glyphs[codepoint] = rasterize_glyph(codepoint);
+            ascii_cached[codepoint] = true;
+        }
+        return ascii_glyphs[codepoint];
+    }
+
+    auto it = other_glyphs.find(codepoint);
+    if (it == other_glyphs.end())
+        it = other_glyphs.emplace(codepoint, rasterize_glyph(codepoint)).first;
+    return it->second;
+}
+
+
+GlyphAtlas::Glyph GlyphAtlas::rasterize_glyph(const uint32_t codepoint) {
+    Glyph glyph = {.src = {0, 0, 0, 0}, .advance = 0, .in_atlas = false};
+
+    int advance;
+    if (TTF_GlyphMetrics32(font, codepoint, NULL, NULL, NULL, NULL, &advance) != 0) {
+        Logger::warning("Font does not provide a glyph for code point {}", codepoint);
+        return glyph;
+    }
+    glyph.advance = advance;
+
+    // render in white, so the glyph can be tinted using vertex colors
+    SDL_Surface* surface = TTF_RenderGlyph32_Blended(font, codepoint, {.r=0xff, .g=0xff, .b=0xff, .a=0xff});
+    if (surface == NULL) {
+        // glyphs without any visible pixels (such as spaces) may fail to render
+        return glyph;
+    }
+    if (surface->format->format != SDL_PIXELFORMAT_ARGB8888) {
+        SDL_Surface* converted = SDL_ConvertSurfaceFormat(surface, SDL_PIXELFORMAT_ARGB8888, 0);
+        SDL_FreeSurface(surface);
+        if (converted == NULL) {
+            Logger::warning("Failed to convert glyph surface\nSDL error: {}", SDL_GetError());
+            return glyph;
+        }
+        surface = converted;
+    }
+
+    // start a new shelf if the glyph doesn't fit on the current one
+    if (pen_x + surface->w + GLYPH_PADDING > ATLAS_W) {
+        pen_x = 0;
+        pen_y += shelf_h;
+        shelf_h = 0;
+    }
+    if (pen_y + surface->h + GLYPH_PADDING > ATLAS_H || surface->w + GLYPH_PADDING > ATLAS_W) {
+        Logger::warning("Glyph atlas is full; can't add code point {}", codepoint);
+        SDL_FreeSurface(surface);
+        return glyph;
+    }
+
+    glyph.src = {
+        .x = pen_x + GLYPH_PADDING,
+        .y = pen_y + GLYPH_PADDING,
+        .w = surface->w,
+        .h = surface->h,
+    };
+    for (int row = 0; row < surface->h; row++) {
+        const uint32_t* const src_row = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(surface->pixels) + row * surface->pitch);
+        std::copy(src_row, src_row + surface->w, pixels.begin() + (glyph.src.y + row) * ATLAS_W + glyph.src.x);
+    }
+    if (SDL_UpdateTexture(atlas, &glyph.src, surface->pixels, surface->pitch) != 0)
+        Logger::warning("Failed to upload glyph to atlas\nSDL error: {}", SDL_GetError());
+    else
+        glyph.in_atlas = true;
+    SDL_FreeSurface(surface);
+
+    pen_x += glyph.src.w + GLYPH_PADDING;
+    shelf_h = std::max(shelf_h, glyph.src.h + GLYPH_PADDING);
+
+    return glyph;
+}
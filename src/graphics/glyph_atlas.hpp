@@ -0,0 +1,95 @@
+#pragma once
+
+#include "graphics/render_queue.hpp"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+/* caches the glyphs of a font in a single texture page and queues text as quads on a RenderQueue
+ * glyphs are rasterized once on first use; only then a (partial) texture upload happens
+ * queueing text from cached glyphs does not allocate once the queue's buffers have grown
+ * text is rasterized in white and tinted through the vertex colors
+ */
+class GlyphAtlas {
+    public:
+        // throws exception on failure
+        GlyphAtlas(SDL_Renderer* const _renderer, TTF_Font* const _font);
+        ~GlyphAtlas();
+
+        GlyphAtlas(const GlyphAtlas&) = delete;
+        GlyphAtlas& operator=(const GlyphAtlas&) = delete;
+
+        // width in pixels `text` will have when drawn `text_height` pixels high
+        int get_text_width(const std::string_view text, const int text_height);
+
+        // queues `text` on `queue` with its top left corner at (x, y), scaled to `text_height` pixels high; returns the width of the text
+        // the glyphs' quads refer to the atlas texture, so flush the queue before reset()
+        int add_text(RenderQueue& queue, const std::string_view text, const int x, const int y, const int text_height, const SDL_Color& color, const int layer = 0);
+
+        /* recreates the atlas texture and rasterizes the glyphs again
+         * needed after the renderer lost its textures (SDL_RENDER_DEVICE_RESET); queued text is dropped
+         * throws exception on failure
+         */
+        void reset();
+
+        // recreated by reset()
+        SDL_Texture* get_texture() const;
+        // CPU copy of the atlas texture; ATLAS_W x ATLAS_H ARGB8888 pixels, e.g. for CpuRasterizer
+        // the pointer stays valid for the lifetime of the atlas
+        const uint32_t* get_pixels() const;
+
+        // memory used by the atlas texture
+        static constexpr size_t get_texture_size() {
+            return ATLAS_W * ATLAS_H * sizeof(uint32_t);
+        }
+
+
+        /* config */
+        static constexpr int ATLAS_W = 1024;  // pixels
+        static constexpr int ATLAS_H = 1024;  // pixels
+        // empty border around every glyph to prevent bleeding when scaling
+        static constexpr int GLYPH_PADDING = 1;  // pixels
+        // glyphs rasterized at construction; others are added on first use
+        static constexpr uint32_t PRELOAD_FIRST = 0x20;  // ' '
+        static constexpr uint32_t PRELOAD_LAST = 0x7e;  // '~'
+
+
+    private:
+        struct Glyph {
+            SDL_Rect src;  // location in atlas
+            int advance;  // pixels at font size
+            bool in_atlas;  // false if the glyph could not be rasterized or did not fit
+        };
+
+        SDL_Renderer* const renderer;
+        TTF_Font* const font;
+        SDL_Texture* atlas;
+
+        // height of a rasterized line at font size
+        int font_height;
+
+        // shelf packing state; glyphs are placed left to right on shelves of the tallest glyph
+        int pen_x, pen_y;
+        int shelf_h;
+
+        // fast path for ASCII; `ascii_cached` tracks which entries are set
+        std::array<Glyph, 128> ascii_glyphs;
+        std::array<bool, 128> ascii_cached;
+        std::unordered_map<uint32_t, Glyph> other_glyphs;
+
+        // kept in sync with the texture, as SDL can't read textures back
+        std::vector<uint32_t> pixels;
+
+
+        void create_atlas();
+        const Glyph& get_glyph(const uint32_t codepoint);
+        Glyph rasterize_glyph(const uint32_t codepoint);
+};
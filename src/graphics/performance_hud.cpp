@@ -0,0 +1,124 @@
+#include "graphics/performance_hud.hpp"
+
+#include "window.hpp"
+#include "graphics/glyph_atlas.hpp"
+#include "graphics/render_queue.hpp"
+#include "profiling/frame_performance.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>  // copy(), min(), max()
+#include <array>
+#include <charconv>  // to_chars()
+#include <cmath>  // isfinite()
+#include <string_view>
+#include <utility>  // pair
+
+
+namespace {
+
+// formats `prefix`, `value` and `suffix` into `buffer` without heap allocations
+std::string_view format_value(std::array<char, 48>& buffer, const std::string_view prefix, const double value, const int precision, const std::string_view suffix) {
+    char* out = std::copy(prefix.begin(), prefix.end(), buffer.data());
+    out = std::to_chars(out, buffer.data() + buffer.size() - suffix.size(), value, std::chars_format::fixed, precision).ptr;
+    out = std::copy(suffix.begin(), suffix.end(), out);
+    return std::string_view(buffer.data(), out - buffer.data());
+}
+
+}  // namespace
+
+
+PerformanceHud::PerformanceHud(RenderQueue& _render_queue, GlyphAtlas& _text_atlas)
+    : render_queue(_render_queue),
+      text_atlas(_text_atlas)
+{
+    //
+}
+
+
+void PerformanceHud::render(const PerformanceHudData& data, const Resolution& res) {
+    if (!data.show || data.frame_perf == nullptr)
+        return;
+
+    const FramePerformance& frame_perf = *data.frame_perf;
+    const int n_records = frame_perf.get_n_frame_records();
+
+    const float graph_w = FramePerformance::RECORD_HISTORY_LEN * data.bar_width,
+                graph_h = data.graph_height;
+    const float x0 = data.margin,
+                bottom = res.h - data.margin;
+
+    // without a budget, scale to the slowest frame in the graph
+    double max_time = BUDGETS_IN_GRAPH * frame_perf.get_frame_budget();
+    if (!std::isfinite(max_time)) {
+        max_time = 0.0;
+        for (int age = 0; age < n_records; age++)
+            max_time = std::max(max_time, frame_perf.get_frame_record(age).frame_time);
+    }
+    const float pixels_per_unit = (max_time > 0.0 ? graph_h / max_time : 0.0f);
+
+    if (data.background_alpha > 0)
+        add_rect(x0, bottom - graph_h, graph_w + data.margin + AUDIO_BAR_WIDTH, graph_h, {.r=0x00, .g=0x00, .b=0x00, .a=data.background_alpha});
+
+    // newest frame on the right
+    for (int age = 0; age < n_records; age++) {
+        const FrameRecord& record = frame_perf.get_frame_record(age);
+        const float x = x0 + graph_w - (age + 1) * data.bar_width;
+        const double rest = std::max(0.0, record.frame_time - (record.events + record.update + record.prepare + record.present));
+        const std::array<std::pair<double, const SDL_Color*>, 5> stages = {{
+            {record.events, &events_color},
+            {record.update, &update_color},
+            {record.prepare, &prepare_color},
+            {record.present, &present_color},
+            {rest, &rest_color},
+        }};
+
+        float y = bottom;
+        for (const auto& [time, color] : stages) {
+            const float h = std::min<float>(time * pixels_per_unit, y - (bottom - graph_h));
+            if (h <= 0.0f)
+                continue;
+            y -= h;
+            add_rect(x, y, data.bar_width, h, *color);
+        }
+    }
+
+    const double budget = frame_perf.get_frame_budget();
+    if (std::isfinite(budget))
+        add_rect(x0, bottom - budget * pixels_per_unit, graph_w, 1.0f, budget_color);
+
+    const float audio_h = std::clamp<float>(data.audio_fill_level, 0.0f, 1.0f) * graph_h;
+    add_rect(x0 + graph_w + data.margin, bottom - audio_h, AUDIO_BAR_WIDTH, audio_h, audio_color);
+
+    // labels above the graph
+    std::array<char, 48> text_buffer;
+    int text_x = x0;
+    const int text_y = bottom - graph_h - data.text_height;
+    if (std::isfinite(budget))
+        text_x += text_atlas.add_text(render_queue, format_value(text_buffer, "budget ", budget, 2, " ms  "), text_x, text_y, data.text_height, text_color);
+    text_x += text_atlas.add_text(render_queue, format_value(text_buffer, "p99 ", frame_perf.get_frame_time_percentile(99.0), 2, " ms  "), text_x, text_y, data.text_height, text_color);
+    text_x += text_atlas.add_text(render_queue, format_value(text_buffer, "audio ", data.audio_queued_frames, 0, " frames  "), text_x, text_y, data.text_height, text_color);
+    text_x += text_atlas.add_text(render_queue, format_value(text_buffer, "draws ", data.draw_calls, 0, "  "), text_x, text_y, data.text_height, text_color);
+    text_x += text_atlas.add_text(render_queue, format_value(text_buffer, "quads ", data.quads, 0, "  "), text_x, text_y, data.text_height, text_color);
+    text_atlas.add_text(render_queue, format_value(text_buffer, "mem ", data.working_set / (1024.0 * 1024.0), 1, " MiB"), text_x, text_y, data.text_height, text_color);
+}
+
+
+SDL_Rect PerformanceHud::get_bounds(const PerformanceHudData& data, const Resolution& res) const {
+    if (!data.show || data.frame_perf == nullptr)
+        return {.x = 0, .y = 0, .w = 0, .h = 0};
+
+    // labels on top of the graph
+    const int top = res.h - data.margin - data.graph_height - data.text_height;
+    return {
+        .x = data.margin,
+        .y = top,
+        .w = res.w - data.margin,
+        .h = res.h - data.margin - top,
+    };
+}
+
+
+void PerformanceHud::add_rect(const float x, const float y, const float w, const float h, const SDL_Color& color) {
+    render_queue.add_rect({.x = x, .y = y, .w = w, .h = h}, color);
+}
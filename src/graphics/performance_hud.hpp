@@ -0,0 +1,78 @@
+#pragma once
+
+#include "graphics/glyph_atlas.hpp"
+#include "graphics/render_queue.hpp"
+#include "profiling/frame_performance.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <cstddef>
+#include <cstdint>
+
+
+struct PerformanceHudData {
+    bool show = false;
+
+    // set by the render loop every frame; nothing is drawn while it is `nullptr`
+    const FramePerformance* frame_perf = nullptr;
+    int audio_queued_frames = 0;
+    // from 0.0 to 1.0
+    double audio_fill_level = 0.0;
+    size_t working_set = 0;  // bytes
+    // of the previous frame
+    size_t draw_calls = 0;
+    size_t quads = 0;
+
+    int graph_height = 120;  // pixels
+    int bar_width = 2;  // pixels per frame
+    int margin = 5;  // pixels
+    int text_height = 16;  // pixels
+    // set to 0 to turn off (255 for solid)
+    uint8_t background_alpha = 150;
+
+    // increment after every change which alters what is drawn; retained rendering only redraws changed elements
+    uint64_t version = 0;
+};
+
+
+// forward declaration; definition in window.hpp
+struct Resolution;
+
+
+/* scrolling graph of the latest frames in the bottom left corner
+ * every frame is a bar of its stages stacked (events, update, prepare, present, rest of the frame)
+ * the horizontal line is the frame budget; the bar on the right is the audio queue fill level
+ * the graph and labels are queued on the render queue; solid quads sort before text, so the labels end up on top
+ */
+class PerformanceHud {
+    public:
+        // `_render_queue` and `_text_atlas` must outlive this object
+        PerformanceHud(RenderQueue& _render_queue, GlyphAtlas& _text_atlas);
+
+        void render(const PerformanceHudData& data, const Resolution& res);
+        // area render() draws to; empty if it draws nothing
+        // spans the width of the window, as the labels' width depends on their values
+        SDL_Rect get_bounds(const PerformanceHudData& data, const Resolution& res) const;
+
+
+        /* config */
+        static constexpr SDL_Color events_color  = {.r=0x40, .g=0x80, .b=0xff, .a=0xff};
+        static constexpr SDL_Color update_color  = {.r=0x40, .g=0xd0, .b=0x40, .a=0xff};
+        static constexpr SDL_Color prepare_color = {.r=0xff, .g=0xd0, .b=0x30, .a=0xff};
+        static constexpr SDL_Color present_color = {.r=0xd0, .g=0x40, .b=0xd0, .a=0xff};
+        static constexpr SDL_Color rest_color    = {.r=0x60, .g=0x60, .b=0x60, .a=0xff};
+        static constexpr SDL_Color budget_color  = {.r=0xff, .g=0x30, .b=0x30, .a=0xff};
+        static constexpr SDL_Color audio_color   = {.r=0x30, .g=0xd0, .b=0xd0, .a=0xff};
+        static constexpr SDL_Color text_color    = {.r=0xff, .g=0xff, .b=0xff, .a=0xff};
+        static constexpr int AUDIO_BAR_WIDTH = 8;  // pixels
+        // the graph's height spans this many frame budgets
+        static constexpr double BUDGETS_IN_GRAPH = 2.0;
+
+
+    private:
+        RenderQueue& render_queue;
+        GlyphAtlas& text_atlas;
+
+
+        void add_rect(const float x, const float y, const float w, const float h, const SDL_Color& color);
+};
@@ -0,0 +1,214 @@
+#include "graphics/render_queue.hpp"
+
+#include "logger.hpp"
+#include "graphics/cpu_rasterizer.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>  // sort(), clamp(), max(), fill()
+#include <bit>  // countr_zero()
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+RenderQueue::RenderQueue(SDL_Renderer* const _renderer, CpuRasterizer* const _rasterizer)
+    : renderer(_renderer),
+      rasterizer(_rasterizer),
+      textures({{.texture = NULL, .inv_w = 0.0f, .inv_h = 0.0f}}),
+      bucket_table(64, NO_BUCKET),
+      last_texture(NULL),
+      last_texture_id(0),
+      last_key(0),
+      last_bucket(NO_BUCKET)
+{
+    indices.reserve(MAX_BATCH_QUADS * 6);
+    for (int quad = 0; quad < MAX_BATCH_QUADS; quad++)
+        for (const int corner : {0, 1, 2, 0, 2, 3})
+            indices.push_back(quad * 4 + corner);
+}
+
+
+void RenderQueue::add_quad(SDL_Texture* const texture, const SDL_Rect& src, const SDL_FRect& dst, const SDL_Color& color, const int layer) {
+    if (texture == NULL) {
+        add_rect(dst, color, layer);
+        return;
+    }
+
+    const uint16_t texture_id = get_texture_id(texture);
+    const TextureInfo& info = textures[texture_id];
+    const SDL_FPoint uv0 = {.x = src.x * info.inv_w, .y = src.y * info.inv_h},
+                     uv1 = {.x = (src.x + src.w) * info.inv_w, .y = (src.y + src.h) * info.inv_h};
+    add(texture_id, dst, uv0, uv1, color, layer);
+}
+
+
+void RenderQueue::add_rect(const SDL_FRect& dst, const SDL_Color& color, const int layer) {
+    add(0, dst, {.x = 0.0f, .y = 0.0f}, {.x = 0.0f, .y = 0.0f}, color, layer);
+}
+
+
+void RenderQueue::add(const uint16_t texture_id, const SDL_FRect& dst, const SDL_FPoint& uv0, const SDL_FPoint& uv1, const SDL_Color& color, int layer) {
+    layer = std::clamp(layer, MIN_LAYER, MAX_LAYER);
+    // offset, so lower layers get lower keys
+    const uint32_t key = (static_cast<uint32_t>(layer - MIN_LAYER) << 16) | texture_id;
+
+    if (key != last_key || last_bucket == NO_BUCKET) {
+        last_key = key;
+        last_bucket = get_bucket(key);
+    }
+
+    buckets[last_bucket].n_quads++;
+    commands.push_back({.dst = dst, .uv0 = uv0, .uv1 = uv1, .color = color, .bucket = last_bucket});
+}
+
+
+uint16_t RenderQueue::get_texture_id(SDL_Texture* const texture) {
+    if (texture == last_texture && last_texture_id != 0)
+        return last_texture_id;
+
+    // few textures are used per frame, so a linear search is fine
+    size_t id = 1;
+    while (id < textures.size() && textures[id].texture != texture)
+        id++;
+
+    if (id == textures.size()) {
+        if (textures.size() > MAX_TEXTURES) {
+            // ids are 16 bits; draw what is queued to free them
+            flush();
+            id = 1;
+        }
+
+        int w = 0, h = 0;
+        if (SDL_QueryTexture(texture, NULL, NULL, &w, &h) != 0)
+            Logger::error("Failed to query texture size of queued quad\nSDL error: {}", SDL_GetError());
+        textures.push_back({.texture = texture, .inv_w = (w > 0 ? 1.0f / w : 0.0f), .inv_h = (h > 0 ? 1.0f / h : 0.0f)});
+    }
+
+    last_texture = texture;
+    last_texture_id = id;
+    return id;
+}
+
+
+uint32_t RenderQueue::get_bucket(const uint32_t key) {
+    const size_t mask = bucket_table.size() - 1;
+    for (size_t slot = get_slot(key);; slot = (slot + 1) & mask) {
+        const uint32_t bucket = bucket_table[slot];
+        if (bucket == NO_BUCKET)
+            break;
+        if (buckets[bucket].key == key)
+            return bucket;
+    }
+
+    buckets.push_back({.key = key, .n_quads = 0, .offset = 0});
+
+    // keep the table at most half full
+    if (buckets.size() * 2 > bucket_table.size()) {
+        bucket_table.assign(bucket_table.size() * 2, NO_BUCKET);
+        for (uint32_t bucket = 0; bucket < buckets.size(); bucket++)
+            insert_bucket(bucket);
+    }
+    else
+        insert_bucket(buckets.size() - 1);
+
+    return buckets.size() - 1;
+}
+
+
+size_t RenderQueue::get_slot(const uint32_t key) const {
+    // multiplicative hashing; the high bits of the product depend on all bits of the key
+    return static_cast<uint32_t>(key * 2654435761u) >> (32 - std::countr_zero(bucket_table.size()));
+}
+
+
+void RenderQueue::insert_bucket(const uint32_t bucket) {
+    const size_t mask = bucket_table.size() - 1;
+    size_t slot = get_slot(buckets[bucket].key);
+    while (bucket_table[slot] != NO_BUCKET)
+        slot = (slot + 1) & mask;
+    bucket_table[slot] = bucket;
+}
+
+
+void RenderQueue::flush() {
+    stats.n_quads += commands.size();
+    if (commands.empty()) {
+        clear();
+        return;
+    }
+
+    // counting sort: buckets in key order get consecutive ranges of `order`; filling them in command order keeps quads in order within a bucket
+    sorted_buckets.resize(buckets.size());
+    for (size_t i = 0; i < buckets.size(); i++)
+        sorted_buckets[i] = i;
+    std::sort(sorted_buckets.begin(), sorted_buckets.end(), [this](const uint32_t a, const uint32_t b) { return buckets[a].key < buckets[b].key; });
+
+    uint32_t offset = 0;
+    for (const uint32_t bucket : sorted_buckets) {
+        buckets[bucket].offset = offset;
+        offset += buckets[bucket].n_quads;
+    }
+
+    order.resize(commands.size());
+    for (size_t i = 0; i < commands.size(); i++)
+        order[buckets[commands[i].bucket].offset++] = i;
+
+    // consecutive buckets with the same texture (on different layers) share batches
+    vertices.clear();
+    SDL_Texture* batch_texture = NULL;
+    for (const uint32_t i : order) {
+        const QuadCommand& command = commands[i];
+        SDL_Texture* const texture = textures[buckets[command.bucket].key & 0xffff].texture;
+
+        if ((texture != batch_texture && !vertices.empty()) || vertices.size() == (size_t)MAX_BATCH_QUADS * 4) {
+            draw_batch(batch_texture, vertices.size() / 4);
+            vertices.clear();
+        }
+        batch_texture = texture;
+
+        const SDL_FRect& dst = command.dst;
+        vertices.push_back({.position = {dst.x, dst.y}, .color = command.color, .tex_coord = {command.uv0.x, command.uv0.y}});
+        vertices.push_back({.position = {dst.x + dst.w, dst.y}, .color = command.color, .tex_coord = {command.uv1.x, command.uv0.y}});
+        vertices.push_back({.position = {dst.x + dst.w, dst.y + dst.h}, .color = command.color, .tex_coord = {command.uv1.x, command.uv1.y}});
+        vertices.push_back({.position = {dst.x, dst.y + dst.h}, .color = command.color, .tex_coord = {command.uv0.x, command.uv1.y}});
+    }
+    draw_batch(batch_texture, vertices.size() / 4);
+
+    clear();
+}
+
+
+void RenderQueue::clear() {
+    // keep capacity, so the next frame doesn't allocate
+    commands.clear();
+    textures.resize(1);
+    buckets.clear();
+    std::fill(bucket_table.begin(), bucket_table.end(), NO_BUCKET);
+    last_texture = NULL;
+    last_texture_id = 0;
+    last_bucket = NO_BUCKET;
+}
+
+
+const RenderStats& RenderQueue::get_stats() const {
+    return stats;
+}
+
+
+void RenderQueue::reset_stats() {
+    stats = {};
+}
+
+
+void RenderQueue::draw_batch(SDL_Texture* const texture, const int n_quads) {
+    if (n_quads == 0)
+        return;
+
+    if (rasterizer != nullptr)
+        rasterizer->draw_quads(texture, vertices.data(), n_quads);
+    else
+        SDL_RenderGeometry(renderer, texture, vertices.data(), n_quads * 4, indices.data(), n_quads * 6);
+    stats.n_draw_calls++;
+    stats.max_batch_quads = std::max<size_t>(stats.max_batch_quads, n_quads);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "graphics/cpu_rasterizer.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// counters of the flushes since RenderQueue::reset_stats()
+struct RenderStats {
+    size_t n_quads = 0;
+    size_t n_draw_calls = 0;
+    size_t max_batch_quads = 0;  // quads in the largest draw call
+};
+
+
+/* collects the quads of a frame and draws them in as few SDL_RenderGeometry() calls as possible
+ * quads are drawn by layer (lowest first); within a layer solid quads come first, then the textured ones grouped by texture in the order the textures were first used since the last flush
+ * quads of the same layer and texture keep their order, so overlapping quads of different textures must be on different layers to be drawn in order
+ * sorting is a counting sort over the (layer, texture) combinations, so it is linear in the number of quads
+ * commands are kept in buffers which are reused between frames; once they have grown, queueing and flushing don't allocate
+ * with a CpuRasterizer, batches are queued on it instead of drawn by the renderer; the caller runs CpuRasterizer::render()
+ */
+class RenderQueue {
+    public:
+        // `_rasterizer` is optional and must outlive this object
+        RenderQueue(SDL_Renderer* const _renderer, CpuRasterizer* const _rasterizer = nullptr);
+
+        RenderQueue(const RenderQueue&) = delete;
+        RenderQueue& operator=(const RenderQueue&) = delete;
+
+        // `src` in pixels of `texture`; `color` tints the texture
+        void add_quad(SDL_Texture* const texture, const SDL_Rect& src, const SDL_FRect& dst, const SDL_Color& color, const int layer = 0);
+        // `dst` filled with `color`, blended by the renderer's blend mode
+        void add_rect(const SDL_FRect& dst, const SDL_Color& color, const int layer = 0);
+
+        // draws and clears all queued quads; call with the render target and clip rectangle the quads are meant for
+        void flush();
+        // drops queued quads without drawing them, e.g. after the renderer lost its textures
+        void clear();
+
+        const RenderStats& get_stats() const;
+        void reset_stats();
+
+
+        /* config */
+        // quads per SDL_RenderGeometry() call; the index buffer of a full batch is built once
+        static constexpr int MAX_BATCH_QUADS = 16384;
+        static constexpr int MIN_LAYER = INT16_MIN;
+        static constexpr int MAX_LAYER = INT16_MAX;
+        // different textures per flush; queued quads are flushed early when more are used
+        static constexpr size_t MAX_TEXTURES = UINT16_MAX;
+
+
+    private:
+        static constexpr uint32_t NO_BUCKET = UINT32_MAX;
+
+        // compact, so queueing and sorting move little memory
+        struct QuadCommand {
+            SDL_FRect dst;
+            SDL_FPoint uv0, uv1;  // texture coordinates of the top left and bottom right corner
+            SDL_Color color;
+            uint32_t bucket;  // index in `buckets`
+        };
+
+        struct TextureInfo {
+            SDL_Texture* texture;  // NULL for solid quads
+            float inv_w, inv_h;  // to normalize texture coordinates
+        };
+
+        // quads of one (layer, texture) combination
+        struct Bucket {
+            uint32_t key;  // layer in the high and texture id in the low 16 bits; sorts by layer, then texture
+            uint32_t n_quads;
+            uint32_t offset;  // first position in `order`
+        };
+
+        SDL_Renderer* const renderer;
+        CpuRasterizer* const rasterizer;
+
+        std::vector<QuadCommand> commands;
+        // texture id is the index; id 0 is for solid quads
+        std::vector<TextureInfo> textures;
+        std::vector<Bucket> buckets;
+        // open addressing hash table of bucket indices by key; `NO_BUCKET` marks empty slots
+        // unlike std::unordered_map it doesn't allocate per key, and clearing keeps its size
+        std::vector<uint32_t> bucket_table;
+        // most recent lookups; consecutive quads mostly share them
+        SDL_Texture* last_texture;
+        uint16_t last_texture_id;
+        uint32_t last_key;
+        uint32_t last_bucket;  // `NO_BUCKET` if there was no lookup since the last flush
+
+        // reused between flushes
+        std::vector<uint32_t> sorted_buckets;
+        std::vector<uint32_t> order;  // command indices in draw order
+        std::vector<SDL_Vertex> vertices;
+        // constant pattern of two triangles per quad for `MAX_BATCH_QUADS` quads
+        std::vector<int> indices;
+
+        RenderStats stats;
+
+
+        void add(const uint16_t texture_id, const SDL_FRect& dst, const SDL_FPoint& uv0, const SDL_FPoint& uv1, const SDL_Color& color, int layer);
+        uint16_t get_texture_id(SDL_Texture* const texture);
+        uint32_t get_bucket(const uint32_t key);
+        // first slot to probe in `bucket_table`, whose size is a power of two
+        size_t get_slot(const uint32_t key) const;
+        void insert_bucket(const uint32_t bucket);
+        void draw_batch(SDL_Texture* const texture, const int n_quads);
+};
@@ -0,0 +1,260 @@
+#include "graphics/resource_cache.hpp"
+
+#include "rsc_dir.hpp"
+#include "exception.hpp"
+#include "logger.hpp"
+#include "thread_pool.hpp"
+#include "graphics/glyph_atlas.hpp"
+#include "profiling/profiler.hpp"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include <algorithm>  // sort()
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>  // function
+#include <future>
+#include <memory>  // make_unique()
+#include <string>
+#include <vector>
+
+
+ResourceCache::ResourceCache(SDL_Renderer* const _renderer, ThreadPool& _thread_pool, const size_t _gpu_budget, const size_t _cpu_budget)
+    : renderer(_renderer),
+      thread_pool(_thread_pool),
+      gpu_budget(_gpu_budget),
+      cpu_budget(_cpu_budget),
+      frame(0),
+      gpu_usage(0),
+      cpu_usage(0)
+{
+    //
+}
+
+
+ResourceCache::~ResourceCache() {
+    for (auto& [file, entry] : textures) {
+        if (entry.decoded.valid()) {
+            try {
+                SDL_FreeSurface(entry.decoded.get());
+            }
+            catch (const std::exception&) {
+                // failed decodes have nothing to free
+            }
+        }
+        if (entry.texture != nullptr)
+            SDL_DestroyTexture(entry.texture);
+    }
+
+    // atlases before their fonts
+    for (auto& [key, entry] : fonts) {
+        entry.atlas.reset();
+        TTF_CloseFont(entry.font);
+    }
+}
+
+
+TTF_Font* ResourceCache::get_font(const std::string& file, const int pt, const bool keep_loaded) {
+    return get_font_entry(file, pt, keep_loaded).font;
+}
+
+
+GlyphAtlas& ResourceCache::get_glyph_atlas(const std::string& file, const int pt, const bool keep_loaded) {
+    FontEntry& entry = get_font_entry(file, pt, keep_loaded);
+    if (!entry.atlas) {
+        entry.atlas = std::make_unique<GlyphAtlas>(renderer, entry.font);
+        gpu_usage += GlyphAtlas::get_texture_size();
+    }
+
+    return *entry.atlas;
+}
+
+
+SDL_Texture* ResourceCache::get_texture(const std::string& file) {
+    return request_texture(file).texture;
+}
+
+
+void ResourceCache::prefetch_texture(const std::string& file) {
+    request_texture(file);
+}
+
+
+void ResourceCache::update() {
+    PROFILE_SCOPE("ResourceCache::update");
+
+    for (auto& [file, entry] : textures)
+        if (entry.decoded.valid() && entry.decoded.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            upload_texture(file, entry);
+
+    if (gpu_usage > gpu_budget || cpu_usage > cpu_budget)
+        evict();
+
+    frame++;
+}
+
+
+void ResourceCache::invalidate() {
+    // surfaces still being decoded don't depend on the renderer, so those entries are kept
+    for (auto it = textures.begin(); it != textures.end();) {
+        if (it->second.decoded.valid()) {
+            ++it;
+            continue;
+        }
+
+        if (it->second.texture != nullptr)
+            SDL_DestroyTexture(it->second.texture);
+        gpu_usage -= it->second.texture_size;
+        it = textures.erase(it);
+    }
+
+    // atlases are recreated instead of dropped, as their users hold references to them
+    for (auto& [key, entry] : fonts) {
+        if (!entry.atlas)
+            continue;
+
+        try {
+            entry.atlas->reset();
+        }
+        catch (const std::exception& e) {
+            Logger::error("Failed to recreate glyph atlas of font '{}'", key.first);
+            Logger::exception(e);
+        }
+    }
+}
+
+
+size_t ResourceCache::get_gpu_usage() const {
+    return gpu_usage;
+}
+
+
+size_t ResourceCache::get_cpu_usage() const {
+    return cpu_usage;
+}
+
+
+ResourceCache::FontEntry& ResourceCache::get_font_entry(const std::string& file, const int pt, const bool keep_loaded) {
+    auto it = fonts.find({file, pt});
+    if (it == fonts.end()) {
+        PROFILE_SCOPE("ResourceCache::open_font");
+
+        SDL_RWops* const rw = RscDir::open_rw(file);
+        // FreeType keeps the font file's data in memory (or reads it from the archive's mapping)
+        const int64_t file_size = SDL_RWsize(rw);
+        // closes `rw`, also on failure
+        TTF_Font* const font = TTF_OpenFontRW(rw, 1, pt);
+        if (font == NULL)
+            throw Exception("Failed to load font '" + file + "'\nTTF error: " + std::string(TTF_GetError()));
+
+        FontEntry entry = {.font = font, .atlas = nullptr, .file_size = (file_size < 0 ? 0 : (size_t)file_size), .last_used = frame, .keep_loaded = false};
+        it = fonts.emplace(std::make_pair(file, pt), std::move(entry)).first;
+        cpu_usage += it->second.file_size;
+    }
+
+    it->second.last_used = frame;
+    it->second.keep_loaded |= keep_loaded;
+    return it->second;
+}
+
+
+ResourceCache::TextureEntry& ResourceCache::request_texture(const std::string& file) {
+    auto it = textures.find(file);
+    if (it == textures.end()) {
+        TextureEntry entry = {
+            .decoded = thread_pool.submit_with_future([file]() {
+                PROFILE_SCOPE("ResourceCache::decode_image");
+
+                // closes the stream
+                SDL_Surface* const surface = SDL_LoadBMP_RW(RscDir::open_rw(file), 1);
+                if (surface == NULL)
+                    throw Exception("Failed to decode image '" + file + "'\nSDL error: " + std::string(SDL_GetError()));
+                return surface;
+            }),
+            .texture = nullptr,
+            .texture_size = 0,
+            .last_used = frame,
+        };
+        it = textures.emplace(file, std::move(entry)).first;
+    }
+
+    it->second.last_used = frame;
+    return it->second;
+}
+
+
+void ResourceCache::upload_texture(const std::string& file, TextureEntry& entry) {
+    PROFILE_SCOPE("ResourceCache::upload_texture");
+
+    try {
+        SDL_Surface* const surface = entry.decoded.get();
+        entry.texture = SDL_CreateTextureFromSurface(renderer, surface);
+        SDL_FreeSurface(surface);
+        if (entry.texture == NULL)
+            throw Exception("Failed to create texture from surface\nSDL error: " + std::string(SDL_GetError()));
+
+        int w, h;
+        SDL_QueryTexture(entry.texture, NULL, NULL, &w, &h);
+        SDL_SetTextureScaleMode(entry.texture, SDL_ScaleModeBest);
+        entry.texture_size = (size_t)w * h * sizeof(uint32_t);
+        gpu_usage += entry.texture_size;
+    }
+    catch (const std::exception& e) {
+        // failed entries are kept, so the error is logged only once
+        Logger::error("Failed to load image '{}'", file);
+        Logger::exception(e);
+        entry.texture = nullptr;
+    }
+}
+
+
+void ResourceCache::evict() {
+    PROFILE_SCOPE("ResourceCache::evict");
+
+    // evictable entries in order of last use; `drop()` releases the entry's memory
+    struct Candidate {
+        uint64_t last_used;
+        size_t size;
+        std::function<void()> drop;
+    };
+
+    std::vector<Candidate> gpu_candidates;
+    for (auto it = textures.begin(); it != textures.end(); ++it)
+        if (it->second.texture != nullptr && it->second.last_used < frame)
+            gpu_candidates.push_back({.last_used = it->second.last_used, .size = it->second.texture_size, .drop = [this, it]() {
+                SDL_DestroyTexture(it->second.texture);
+                textures.erase(it);
+            }});
+    for (auto& [key, entry] : fonts)
+        if (entry.atlas && !entry.keep_loaded && entry.last_used < frame)
+            gpu_candidates.push_back({.last_used = entry.last_used, .size = GlyphAtlas::get_texture_size(), .drop = [&entry]() {
+                entry.atlas.reset();
+            }});
+
+    std::sort(gpu_candidates.begin(), gpu_candidates.end(), [](const Candidate& a, const Candidate& b) { return a.last_used < b.last_used; });
+    for (const Candidate& candidate : gpu_candidates) {
+        if (gpu_usage <= gpu_budget)
+            break;
+        candidate.drop();
+        gpu_usage -= candidate.size;
+    }
+
+    // fonts go after the atlases, as a font can't be closed while its atlas uses it
+    std::vector<Candidate> cpu_candidates;
+    for (auto it = fonts.begin(); it != fonts.end(); ++it)
+        if (!it->second.atlas && !it->second.keep_loaded && it->second.last_used < frame)
+            cpu_candidates.push_back({.last_used = it->second.last_used, .size = it->second.file_size, .drop = [this, it]() {
+                TTF_CloseFont(it->second.font);
+                fonts.erase(it);
+            }});
+
+    std::sort(cpu_candidates.begin(), cpu_candidates.end(), [](const Candidate& a, const Candidate& b) { return a.last_used < b.last_used; });
+    for (const Candidate& candidate : cpu_candidates) {
+        if (cpu_usage <= cpu_budget)
+            break;
+        candidate.drop();
+        cpu_usage -= candidate.size;
+    }
+}
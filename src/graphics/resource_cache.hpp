@@ -0,0 +1,107 @@
+#pragma once
+
+#include "thread_pool.hpp"
+#include "graphics/glyph_atlas.hpp"
+
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>  // pair
+
+
+/* lazily loads fonts and textures from the resources (see RscDir), loose or packed, and keeps them for reuse
+ * fonts are cached per (file, point size), together with a glyph atlas for drawing text with them
+ * images are decoded to surfaces on the thread pool and uploaded to textures by update() on the render thread
+ *   only BMP images are supported, as SDL can decode those without SDL_image
+ * entries not used since the last update() are evicted, least recently used first, when over a memory budget
+ *   the GPU budget covers textures and glyph atlases, the CPU budget covers fonts
+ *   so returned pointers and references stay valid until the next update(), unless kept loaded
+ * all functions must be called from the thread owning the renderer
+ */
+class ResourceCache {
+    public:
+        ResourceCache(SDL_Renderer* const _renderer, ThreadPool& _thread_pool, const size_t _gpu_budget = DEFAULT_GPU_BUDGET, const size_t _cpu_budget = DEFAULT_CPU_BUDGET);
+        // waits for running decodes
+        ~ResourceCache();
+
+        ResourceCache(const ResourceCache&) = delete;
+        ResourceCache& operator=(const ResourceCache&) = delete;
+
+        /* `file` is a resource name, i.e. a path relative to the resource directory
+         * fonts are opened on first use; throws exception on failure
+         * `keep_loaded` exempts the font from eviction, for users holding on to it between frames
+         */
+        TTF_Font* get_font(const std::string& file, const int pt, const bool keep_loaded = false);
+        GlyphAtlas& get_glyph_atlas(const std::string& file, const int pt, const bool keep_loaded = false);
+
+        // returns nullptr while the image is being decoded or if it failed to load (which is logged once)
+        // the first request starts decoding in the background; the texture is available after a later update()
+        SDL_Texture* get_texture(const std::string& file);
+        // starts decoding an image which is expected to be needed soon
+        void prefetch_texture(const std::string& file);
+
+        // uploads decoded images and evicts unused entries if over budget; call once per frame before drawing
+        void update();
+
+        /* drops all textures, to be reloaded on their next request, and recreates the glyph atlases
+         * call on SDL_RENDER_TARGETS_RESET and SDL_RENDER_DEVICE_RESET, after which the renderer's textures are lost
+         * fonts are kept, as they don't depend on the renderer
+         */
+        void invalidate();
+
+        size_t get_gpu_usage() const;
+        size_t get_cpu_usage() const;
+
+
+        /* config */
+        static constexpr size_t DEFAULT_GPU_BUDGET = 256 << 20;  // bytes
+        static constexpr size_t DEFAULT_CPU_BUDGET = 64 << 20;  // bytes
+
+
+    private:
+        struct FontEntry {
+            TTF_Font* font;
+            // created on first use by get_glyph_atlas()
+            std::unique_ptr<GlyphAtlas> atlas;
+            size_t file_size;
+            uint64_t last_used;
+            bool keep_loaded;
+        };
+
+        struct TextureEntry {
+            // valid while decoding
+            std::future<SDL_Surface*> decoded;
+            // nullptr while decoding or after a failure
+            SDL_Texture* texture;
+            size_t texture_size;
+            uint64_t last_used;
+        };
+
+        SDL_Renderer* const renderer;
+        ThreadPool& thread_pool;
+        const size_t gpu_budget;
+        const size_t cpu_budget;
+
+        std::map<std::pair<std::string, int>, FontEntry> fonts;
+        std::unordered_map<std::string, TextureEntry> textures;
+        // incremented by update(); entries used in the current frame are never evicted
+        uint64_t frame;
+        size_t gpu_usage;
+        size_t cpu_usage;
+
+
+        /* private functions */
+        FontEntry& get_font_entry(const std::string& file, const int pt, const bool keep_loaded);
+        TextureEntry& request_texture(const std::string& file);
+        void upload_texture(const std::string& file, TextureEntry& entry);
+
+        // drops the least recently used textures and glyph atlases, then fonts, until within budget
+        void evict();
+};
@@ -0,0 +1,430 @@
+#include "logger.hpp"
+
+#include "profiling/startup_timer.hpp"
+
+#include <algorithm>  // min()
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>  // snprintf()
+#include <cstdlib>  // atexit()
+#include <cstring>  // memcpy()
+#include <memory>  // unique_ptr
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>  // _isatty()
+#else
+#include <climits>  // IOV_MAX
+#include <sys/uio.h>  // writev()
+#include <unistd.h>  // isatty()
+#endif
+
+
+namespace Logger {
+
+static_assert((QUEUE_SLOTS & (QUEUE_SLOTS - 1)) == 0, "Logger::QUEUE_SLOTS must be a power of two");
+
+
+// first slot of a record; the message continues in the record's other slots
+struct RecordHeader {
+    double program_time;  // milliseconds
+    const char* file;
+    int line;
+    uint32_t msg_size;
+    Level level;
+    bool truncated;
+    uint16_t n_slots;
+};
+
+
+/* bounded multi-producer single-consumer queue (after Dmitry Vyukov's bounded queue) of records spanning one or more consecutive slots
+ * a slot's sequence number tells whose turn it is: equal to its position when free for producers, position + 1 when published for the consumer
+ * producers claim all slots of a record with a single CAS on `enqueue_pos`, so a record is never interleaved with another
+ */
+struct alignas(64) Slot {
+    std::atomic<size_t> sequence;
+    char data[SLOT_SIZE - sizeof(std::atomic<size_t>)];
+};
+
+constexpr size_t SLOT_DATA_SIZE = sizeof(Slot::data);
+constexpr size_t MAX_RECORD_SLOTS = (sizeof(RecordHeader) + MAX_MSG_SIZE + SLOT_DATA_SIZE - 1) / SLOT_DATA_SIZE;
+static_assert(MAX_RECORD_SLOTS <= QUEUE_SLOTS, "Logger::QUEUE_SLOTS can't hold a message of Logger::MAX_MSG_SIZE");
+static_assert(std::atomic<size_t>::is_always_lock_free, "Logger requires lock-free atomics to never block producers");
+
+
+class Backend {
+    public:
+        Backend();
+
+        bool push(const Level level, const std::string_view msg, const char* const file, const int line) noexcept;
+        // write everything published so far
+        void flush();
+        // stop the background thread; later messages are written synchronously
+        void stop();
+        bool is_running() const;
+
+        std::atomic<uint64_t> n_dropped = 0,
+                              n_truncated = 0;
+
+
+    private:
+        void write_loop();
+        // whether a record is published at the front of the queue
+        bool has_records();
+
+        // pop all fully published records and format them into `lines`; called with `flush_mutex` held
+        void pop_records();
+        void format_record(const RecordHeader& header, const std::string_view msg, std::string& line) const;
+        void write_lines();
+
+        std::unique_ptr<Slot[]> slots;
+        alignas(64) std::atomic<size_t> enqueue_pos = 0;
+        alignas(64) size_t dequeue_pos = 0;
+
+        // consumer side: either the background thread or a flushing thread
+        std::mutex flush_mutex;
+        std::vector<std::string> lines;  // formatted lines of the current batch; strings are reused
+        size_t n_lines = 0;
+        std::string msg_buffer;  // message of a record spanning multiple slots
+        uint64_t reported_dropped = 0;
+
+        const bool is_tty;
+        std::atomic<bool> running = true;
+        // 1 while the writer waits for a message; int, so waiting on it is a plain futex wait
+        std::atomic<int> writer_sleeping = 0;
+        std::thread writer;
+};
+
+
+static bool stderr_is_tty() {
+#ifdef _WIN32
+    return _isatty(_fileno(stderr)) != 0;
+#else
+    return isatty(STDERR_FILENO) == 1;
+#endif
+}
+
+
+Backend::Backend()
+    : slots(std::make_unique<Slot[]>(QUEUE_SLOTS)),
+      is_tty(stderr_is_tty())
+{
+    for (size_t i = 0; i < QUEUE_SLOTS; i++)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    msg_buffer.reserve(MAX_MSG_SIZE);
+
+    writer = std::thread(&Backend::write_loop, this);
+}
+
+
+bool Backend::push(const Level level, std::string_view msg, const char* const file, const int line) noexcept {
+    const bool truncated = (msg.size() > MAX_MSG_SIZE);
+    if (truncated) {
+        msg = msg.substr(0, MAX_MSG_SIZE);
+        n_truncated.fetch_add(1, std::memory_order_relaxed);
+    }
+    const size_t n_slots = (sizeof(RecordHeader) + msg.size() + SLOT_DATA_SIZE - 1) / SLOT_DATA_SIZE;
+
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    while (true) {
+        bool free = true;
+        for (size_t i = 0; i < n_slots && free; i++)
+            free = (slots[(pos + i) & (QUEUE_SLOTS - 1)].sequence.load(std::memory_order_acquire) == pos + i);
+
+        if (free) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + n_slots, std::memory_order_relaxed))
+                break;
+            continue;  // `pos` is updated by the failed CAS
+        }
+
+        // unless another producer claimed the slots in the meantime, the consumer hasn't freed them yet
+        const size_t current = enqueue_pos.load(std::memory_order_relaxed);
+        if (current == pos) {
+            n_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        pos = current;
+    }
+
+    const RecordHeader header = {
+        .program_time = (PRINT_PROGRAM_TIME ? startup_timer.get_program_time() : 0.0),
+        .file = file,
+        .line = line,
+        .msg_size = static_cast<uint32_t>(msg.size()),
+        .level = level,
+        .truncated = truncated,
+        .n_slots = static_cast<uint16_t>(n_slots)
+    };
+
+    // header and message are laid out contiguously over the slots' data
+    size_t copied = 0;
+    for (size_t i = 0; i < n_slots; i++) {
+        Slot& slot = slots[(pos + i) & (QUEUE_SLOTS - 1)];
+        size_t offset = 0;
+        if (i == 0) {
+            std::memcpy(slot.data, &header, sizeof(header));
+            offset = sizeof(header);
+        }
+        const size_t n_bytes = std::min(SLOT_DATA_SIZE - offset, msg.size() - copied);
+        std::memcpy(slot.data + offset, msg.data() + copied, n_bytes);
+        copied += n_bytes;
+    }
+
+    // publish in order; the consumer only pops a record once all its slots are published
+    for (size_t i = 0; i < n_slots; i++)
+        slots[(pos + i) & (QUEUE_SLOTS - 1)].sequence.store(pos + i + 1, std::memory_order_release);
+
+    // only wake the writer if it sleeps on an empty queue, so most messages don't make a system call
+    // pairs with the fence in write_loop(): either the writer sees this record, or this sees it sleeping
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (writer_sleeping.load(std::memory_order_relaxed) == 1 && writer_sleeping.exchange(0, std::memory_order_relaxed) == 1)
+        writer_sleeping.notify_one();
+
+    return true;
+}
+
+
+void Backend::pop_records() {
+    while (true) {
+        Slot& first = slots[dequeue_pos & (QUEUE_SLOTS - 1)];
+        if (first.sequence.load(std::memory_order_acquire) != dequeue_pos + 1)
+            return;
+
+        RecordHeader header;
+        std::memcpy(&header, first.data, sizeof(header));
+        for (size_t i = 1; i < header.n_slots; i++)
+            if (slots[(dequeue_pos + i) & (QUEUE_SLOTS - 1)].sequence.load(std::memory_order_acquire) != dequeue_pos + i + 1)
+                return;  // rest of the record is still being written
+
+        std::string_view msg;
+        if (header.n_slots == 1)
+            msg = std::string_view(first.data + sizeof(header), header.msg_size);
+        else {
+            msg_buffer.clear();
+            for (size_t i = 0; i < header.n_slots; i++) {
+                const Slot& slot = slots[(dequeue_pos + i) & (QUEUE_SLOTS - 1)];
+                const size_t offset = (i == 0 ? sizeof(header) : 0);
+                const size_t n_bytes = std::min(SLOT_DATA_SIZE - offset, header.msg_size - msg_buffer.size());
+                msg_buffer.append(slot.data + offset, n_bytes);
+            }
+            msg = msg_buffer;
+        }
+
+        if (n_lines == lines.size())
+            lines.emplace_back();
+        format_record(header, msg, lines[n_lines++]);
+
+        // hand the slots back to the producers for their next lap
+        for (size_t i = 0; i < header.n_slots; i++)
+            slots[(dequeue_pos + i) & (QUEUE_SLOTS - 1)].sequence.store(dequeue_pos + i + QUEUE_SLOTS, std::memory_order_release);
+        dequeue_pos += header.n_slots;
+    }
+}
+
+
+void Backend::format_record(const RecordHeader& header, const std::string_view msg, std::string& line) const {
+    struct Type {
+        const char* name;
+        const std::string& color;
+    };
+    // in order of `Level`
+    static const Type types[] = {
+        {"Fatal", MAGENTA},
+        {"Error", RED},
+        {"Warning", YELLOW},
+        {"Info", GREEN},
+        {"Debug", BLUE},
+        {"Hint", CYAN},
+        {"Exception", WHITE},
+        {"", RESET}
+    };
+
+    line.clear();
+    if (header.level == Level::plain)
+        line += msg;
+    else {
+        const Type& type = types[static_cast<size_t>(header.level)];
+        if (is_tty)
+            line += BOLD;
+        if constexpr (PRINT_PROGRAM_TIME) {
+            char time[32];
+            std::snprintf(time, sizeof(time), "[%g] ", header.program_time / 1000.0);
+            line += time;
+        }
+        if (is_tty)
+            line += type.color + type.name + RESET;
+        else
+            line += type.name;
+        line += ": ";
+        line += msg;
+        if (header.truncated)
+            line += " [truncated]";
+        if (header.file != nullptr)
+            line += "  (" + std::string(header.file) + ":" + std::to_string(header.line) + ")";
+    }
+    line += '\n';
+}
+
+
+void Backend::write_lines() {
+    if (n_lines == 0)
+        return;
+
+#ifdef _WIN32
+    for (size_t i = 0; i < n_lines; i++)
+        std::fwrite(lines[i].data(), 1, lines[i].size(), stderr);
+    std::fflush(stderr);
+#else
+    // one writev() per batch of up to IOV_MAX lines; partially written batches continue where they stopped
+    std::vector<iovec> iov(std::min<size_t>(n_lines, IOV_MAX));
+    for (size_t batch_start = 0; batch_start < n_lines; batch_start += iov.size()) {
+        const size_t n_iov = std::min(iov.size(), n_lines - batch_start);
+        for (size_t i = 0; i < n_iov; i++)
+            iov[i] = {lines[batch_start + i].data(), lines[batch_start + i].size()};
+
+        iovec* next = iov.data();
+        size_t n_left = n_iov;
+        while (n_left > 0) {
+            ssize_t n_written = writev(STDERR_FILENO, next, n_left);
+            if (n_written < 0) {
+                if (errno == EINTR)
+                    continue;
+                break;  // nowhere left to report this
+            }
+
+            for (; n_left > 0 && (size_t)n_written >= next->iov_len; next++, n_left--)
+                n_written -= next->iov_len;
+            if (n_left > 0) {
+                next->iov_base = static_cast<char*>(next->iov_base) + n_written;
+                next->iov_len -= n_written;
+            }
+        }
+    }
+#endif
+
+    n_lines = 0;
+}
+
+
+void Backend::flush() {
+    std::lock_guard<std::mutex> lock(flush_mutex);
+    pop_records();
+
+    const uint64_t dropped = n_dropped.load(std::memory_order_relaxed);
+    if (dropped != reported_dropped) {
+        if (n_lines == lines.size())
+            lines.emplace_back();
+        const RecordHeader header = {.program_time = (PRINT_PROGRAM_TIME ? startup_timer.get_program_time() : 0.0), .file = nullptr, .line = 0, .msg_size = 0, .level = Level::warning, .truncated = false, .n_slots = 0};
+        format_record(header, "Log queue was full; dropped " + std::to_string(dropped - reported_dropped) + " messages", lines[n_lines++]);
+        reported_dropped = dropped;
+    }
+
+    write_lines();
+}
+
+
+bool Backend::has_records() {
+    std::lock_guard<std::mutex> lock(flush_mutex);
+    return slots[dequeue_pos & (QUEUE_SLOTS - 1)].sequence.load(std::memory_order_acquire) == dequeue_pos + 1;
+}
+
+
+void Backend::write_loop() {
+    while (running.load()) {
+        flush();
+
+        // sleep until a message is pushed instead of polling, so an idle application isn't woken up
+        writer_sleeping.store(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!has_records() && running.load())
+            writer_sleeping.wait(1);
+        writer_sleeping.store(0, std::memory_order_relaxed);
+
+        std::this_thread::sleep_for(WRITE_INTERVAL);
+    }
+}
+
+
+void Backend::stop() {
+    if (!running.exchange(false))
+        return;
+    writer_sleeping.store(0);
+    writer_sleeping.notify_one();
+    writer.join();
+    flush();
+}
+
+
+bool Backend::is_running() const {
+    return running.load(std::memory_order_relaxed);
+}
+
+
+// never destroyed, as messages may be logged during static destruction; the writer thread is stopped at exit instead
+static std::atomic<Backend*> backend = nullptr;
+static std::once_flag backend_started;
+
+
+void start() {
+    std::call_once(backend_started, [] {
+        backend.store(new Backend(), std::memory_order_release);
+        std::atexit([] {
+            backend.load(std::memory_order_acquire)->stop();
+        });
+    });
+}
+
+
+void log(const Level level, const std::string_view msg, const char* const file, const int line) noexcept {
+    Backend* instance = backend.load(std::memory_order_acquire);
+    if (instance == nullptr) {
+        try {
+            start();
+        }
+        catch (const std::exception&) {
+            return;  // couldn't allocate or start the thread; nowhere to log to
+        }
+        instance = backend.load(std::memory_order_acquire);
+    }
+
+    if (!instance->push(level, msg, file, line) && level == Level::fatal) {
+        // make room rather than losing the reason the application is about to stop
+        instance->flush();
+        instance->push(level, msg, file, line);
+    }
+    else if (!instance->is_running())
+        instance->flush();
+}
+
+
+std::span<char> get_format_buffer() {
+    thread_local char buffer[MAX_MSG_SIZE + 1];
+    return buffer;
+}
+
+
+void flush() {
+    start();
+    backend.load(std::memory_order_acquire)->flush();
+}
+
+
+uint64_t get_n_dropped() {
+    start();
+    return backend.load(std::memory_order_acquire)->n_dropped.load(std::memory_order_relaxed);
+}
+
+
+uint64_t get_n_truncated() {
+    start();
+    return backend.load(std::memory_order_acquire)->n_truncated.load(std::memory_order_relaxed);
+}
+
+}  // namespace Logger
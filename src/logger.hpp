@@ -1,12 +1,18 @@
 #pragma once
 
-#include "profiling/startup_timer.hpp"
+#include "format.hpp"
 
-#include <iostream>
+#include <algorithm>  // min()
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
 #include <source_location>
+#include <span>
 #include <string>
-
-#include <unistd.h>  // isatty()
+#include <string_view>
+#include <type_traits>  // type_identity_t
+#include <utility>  // forward()
 
 
 /*
@@ -28,7 +34,27 @@
 
 namespace Logger {
 
+// ordered from most to least severe; hints, exceptions and plain messages accompany other messages and are never filtered
+enum class Level : uint8_t {
+    fatal,
+    error,
+    warning,
+    info,
+    debug,
+    hint,
+    exception,
+    plain  // message without type
+};
+
+
 /* config */
+// less severe levels are compiled out, including the formatting of their arguments
+#ifdef NDEBUG
+constexpr Level MIN_LEVEL = Level::info;
+#else
+constexpr Level MIN_LEVEL = Level::debug;
+#endif
+
 // print time from program start in CLI messages
 constexpr bool PRINT_PROGRAM_TIME = false;
 
@@ -38,6 +64,15 @@ constexpr bool INFO_SOURCE_LOC = false;
 // disable colours from being used in the terminal
 constexpr bool NO_COLORS = false;
 
+// size of the message queue; a message takes one slot per `SLOT_SIZE` bytes (including a small record header)
+constexpr size_t QUEUE_SLOTS = 4096;  // must be a power of two
+constexpr size_t SLOT_SIZE = 256;  // bytes
+// longer messages are truncated
+constexpr size_t MAX_MSG_SIZE = 4096;  // bytes
+
+// the background thread sleeps until a message is logged, then waits this long so messages logged together are written together
+constexpr std::chrono::milliseconds WRITE_INTERVAL{5};
+
 
 // constants for colour/format escape sequences
 const std::string BLACK     = (NO_COLORS ? "" : "\033[30m");
@@ -54,83 +89,168 @@ const std::string UNDERLINE = (NO_COLORS ? "" : "\033[4m");
 const std::string RESET     = (NO_COLORS ? "" : "\033[0m");
 
 
-// plain message
-inline void msg(const std::string& msg_to_log) {
-    std::cerr << msg_to_log << std::endl;
+
+/* messages are copied into fixed-size records in a lock-free queue and written to stderr by a background thread
+ * while the background thread runs, logging never blocks and, once the backend is started, never allocates, so it is safe from audio callbacks
+ *   the first message after the queue ran empty wakes the sleeping background thread with a (non-blocking) futex wake
+ *   after it is stopped at exit, messages are written synchronously under a mutex
+ * not safe from signal handlers; set a flag there and log from regular code instead (see Quit)
+ * if the queue is full the message is dropped; messages longer than `MAX_MSG_SIZE` are truncated
+ * messages of a single thread are written in order; fatal messages are flushed before returning
+ */
+// `file` must be a string literal (e.g. from std::source_location) or nullptr to leave out the location
+void log(const Level level, const std::string_view msg, const char* const file = nullptr, const int line = 0) noexcept;
+
+// writes all queued messages before returning
+void flush();
+
+// starts the backend (called by the first message); call before logging from audio callbacks, as starting allocates
+void start();
+
+// number of messages dropped since start, because the queue was full
+uint64_t get_n_dropped();
+// number of messages truncated since start, because they were longer than `MAX_MSG_SIZE`
+uint64_t get_n_truncated();
+
+
+constexpr bool is_enabled(const Level level) {
+    return level > Level::debug || level <= MIN_LEVEL;
 }
 
 
-// without file and line number
-inline void msg(const char* type, const std::string color, const std::string& msg) {
-    if (isatty(STDERR_FILENO) == 1) {
-        std::cerr << BOLD;
-        if constexpr (PRINT_PROGRAM_TIME)
-            std::cerr << "[" << startup_timer.get_program_time() / 1000.0 << "] ";
+// format string which also captures the caller's location, as a default argument can't follow a parameter pack
+template <typename... Args>
+struct FormatString {
+    template <typename T>
+    consteval FormatString(const T& _fmt, const std::source_location _location = std::source_location::current())
+        : fmt(_fmt),
+          location(_location)
+    {}
+
+    Fmt::format_string<Args...> fmt;
+    std::source_location location;
+};
+
+
+// thread-local buffer of `MAX_MSG_SIZE` + 1 bytes to format into; the extra byte lets Logger::log() notice truncation
+std::span<char> get_format_buffer();
 
-        std::cerr << color << type << RESET << ": " << msg << std::endl;
-    }
-    else {
-        if constexpr (PRINT_PROGRAM_TIME)
-            std::cerr << "[" << startup_timer.get_program_time() / 1000.0 << "] ";
 
-        std::cerr << type << ": " << msg << std::endl;
+// formats without allocating and queues the message
+template <typename... Args>
+void log_format(const Level level, const std::source_location location, const bool with_location, const Fmt::format_string<Args...> fmt, Args&&... args) {
+    const char* const file = (with_location ? location.file_name() : nullptr);
+    const int line = (with_location ? location.line() : 0);
+
+    const std::span<char> buffer = get_format_buffer();
+    try {
+        const auto result = Fmt::format_to_n(buffer.data(), buffer.size(), fmt, std::forward<Args>(args)...);
+        Logger::log(level, std::string_view(buffer.data(), std::min<size_t>(result.size, buffer.size())), file, line);
+    }
+    catch (const std::exception&) {
+        Logger::log(Level::error, "Failed to format log message", file, line);
     }
 }
 
 
-// with file and line number
-inline void msg(const char* type, const std::string color, const char* file, const int line, const std::string& msg) {
-    if (isatty(STDERR_FILENO) == 1) {
-        std::cerr << BOLD;
-        if constexpr (PRINT_PROGRAM_TIME)
-            std::cerr << "[" << startup_timer.get_program_time() / 1000.0 << "] ";
+/* every level takes a format string with its arguments, e.g. `Logger::warning("Can't open '{}'", path)`
+ * disabled levels don't evaluate the formatting
+ */
 
-        std::cerr << color << type << RESET << ": " << msg << "  (" << file << ":" << line << ")" << std::endl;
-    }
-    else {
-        if constexpr (PRINT_PROGRAM_TIME)
-            std::cerr << "[" << startup_timer.get_program_time() / 1000.0 << "] ";
+// plain message
+inline void msg(const std::string_view msg_to_log) {
+    Logger::log(Level::plain, msg_to_log);
+}
 
-        std::cerr << type << ": " << msg << "  (" << file << ":" << line << ")" << std::endl;
-    }
+
+template <typename... Args>
+void msg(const FormatString<std::type_identity_t<Args>...> fmt, Args&&... args) {
+    Logger::log_format(Level::plain, fmt.location, false, fmt.fmt, std::forward<Args>(args)...);
+}
+
+
+inline void fatal(const std::string_view msg, const std::source_location location = std::source_location::current()) {
+    Logger::log(Level::fatal, msg, location.file_name(), location.line());
+    Logger::flush();
+}
+
+
+template <typename... Args>
+void fatal(const FormatString<std::type_identity_t<Args>...> fmt, Args&&... args) {
+    Logger::log_format(Level::fatal, fmt.location, true, fmt.fmt, std::forward<Args>(args)...);
+    Logger::flush();
+}
+
+
+inline void error(const std::string_view msg, const std::source_location location = std::source_location::current()) {
+    if constexpr (is_enabled(Level::error))
+        Logger::log(Level::error, msg, location.file_name(), location.line());
+}
+
+
+template <typename... Args>
+void error(const FormatString<std::type_identity_t<Args>...> fmt, Args&&... args) {
+    if constexpr (is_enabled(Level::error))
+        Logger::log_format(Level::error, fmt.location, true, fmt.fmt, std::forward<Args>(args)...);
 }
 
 
-inline void fatal(const std::string& msg, const std::source_location location = std::source_location::current()) {
-    Logger::msg("Fatal", MAGENTA, location.file_name(), location.line(), msg);
+inline void warning(const std::string_view msg, const std::source_location location = std::source_location::current()) {
+    if constexpr (is_enabled(Level::warning))
+        Logger::log(Level::warning, msg, location.file_name(), location.line());
+}
+
+
+template <typename... Args>
+void warning(const FormatString<std::type_identity_t<Args>...> fmt, Args&&... args) {
+    if constexpr (is_enabled(Level::warning))
+        Logger::log_format(Level::warning, fmt.location, true, fmt.fmt, std::forward<Args>(args)...);
+}
+
+
+inline void info(const std::string_view msg, const std::source_location location = std::source_location::current()) {
+    if constexpr (is_enabled(Level::info)) {
+        if constexpr (INFO_SOURCE_LOC)
+            Logger::log(Level::info, msg, location.file_name(), location.line());
+        else
+            Logger::log(Level::info, msg);
+    }
 }
 
 
-inline void error(const std::string& msg, const std::source_location location = std::source_location::current()) {
-    Logger::msg("Error", RED, location.file_name(), location.line(), msg);
+template <typename... Args>
+void info(const FormatString<std::type_identity_t<Args>...> fmt, Args&&... args) {
+    if constexpr (is_enabled(Level::info))
+        Logger::log_format(Level::info, fmt.location, INFO_SOURCE_LOC, fmt.fmt, std::forward<Args>(args)...);
 }
 
 
-inline void warning(const std::string& msg, const std::source_location location = std::source_location::current()) {
-    Logger::msg("Warning", YELLOW, location.file_name(), location.line(), msg);
+inline void debug(const std::string_view msg, const std::source_location location = std::source_location::current()) {
+    if constexpr (is_enabled(Level::debug))
+        Logger::log(Level::debug, msg, location.file_name(), location.line());
 }
 
 
-inline void info(const std::string& msg, const std::source_location location = std::source_location::current()) {
-    if constexpr (INFO_SOURCE_LOC)
-        Logger::msg("Info", GREEN, location.file_name(), location.line(), msg);
-    else
-        Logger::msg("Info", GREEN, msg);
+template <typename... Args>
+void debug(const FormatString<std::type_identity_t<Args>...> fmt, Args&&... args) {
+    if constexpr (is_enabled(Level::debug))
+        Logger::log_format(Level::debug, fmt.location, true, fmt.fmt, std::forward<Args>(args)...);
 }
 
 
-inline void debug(const std::string& msg, const std::source_location location = std::source_location::current()) {
-    Logger::msg("Debug", BLUE, location.file_name(), location.line(), msg);
+inline void hint(const std::string_view msg) {
+    Logger::log(Level::hint, msg);
 }
 
 
-inline void hint(const std::string& msg) {
-    Logger::msg("Hint", CYAN, msg);
+template <typename... Args>
+void hint(const FormatString<std::type_identity_t<Args>...> fmt, Args&&... args) {
+    Logger::log_format(Level::hint, fmt.location, false, fmt.fmt, std::forward<Args>(args)...);
 }
 
 
 inline void exception(const std::exception& e) {
-    Logger::msg("Exception", WHITE, e.what());
+    Logger::log(Level::exception, e.what());
 }
 
 } // namespace Logger
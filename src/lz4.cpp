@@ -0,0 +1,167 @@
+#include "lz4.hpp"
+
+#include "exception.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>  // memcpy()
+#include <span>
+#include <string>  // to_string()
+#include <vector>
+
+
+namespace Lz4 {
+
+/* format constants */
+constexpr size_t MIN_MATCH = 4;
+// the last 5 bytes are always literals
+constexpr size_t LAST_LITERALS = 5;
+// the last match starts at least 12 bytes before the end
+constexpr size_t MATCH_START_LIMIT = 12;
+constexpr size_t MAX_OFFSET = 65535;
+
+/* config */
+constexpr int HASH_BITS = 16;
+
+
+static uint32_t read_u32(const uint8_t* const bytes) {
+    uint32_t value;
+    std::memcpy(&value, bytes, sizeof(value));
+    return value;
+}
+
+
+static uint32_t hash(const uint32_t sequence) {
+    return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+
+// lengths of 15 and up continue in extra bytes of 255 each, ending with a byte below 255
+static void write_length(std::vector<uint8_t>& out, size_t length) {
+    for (; length >= 255; length -= 255)
+        out.push_back(255);
+    out.push_back(length);
+}
+
+
+static void write_sequence(std::vector<uint8_t>& out, const uint8_t* const literals, const size_t n_literals, const size_t offset, const size_t match_length) {
+    const size_t match_code = (match_length > 0 ? match_length - MIN_MATCH : 0);
+    out.push_back(((n_literals < 15 ? n_literals : 15) << 4) | (match_code < 15 ? match_code : 15));
+    if (n_literals >= 15)
+        write_length(out, n_literals - 15);
+    out.insert(out.end(), literals, literals + n_literals);
+
+    // the last sequence has no match
+    if (match_length == 0)
+        return;
+
+    out.push_back(offset & 0xff);
+    out.push_back(offset >> 8);
+    if (match_code >= 15)
+        write_length(out, match_code - 15);
+}
+
+
+std::vector<uint8_t> compress(const std::span<const uint8_t> in) {
+    std::vector<uint8_t> out;
+    out.reserve(compress_bound(in.size()));
+
+    const uint8_t* const data = in.data();
+    const size_t n = in.size();
+
+    // last position plus one at which each hashed 4 byte sequence was seen; 0 if not seen yet
+    std::vector<uint32_t> table(1 << HASH_BITS, 0);
+
+    size_t anchor = 0;
+    size_t i = 0;
+    while (i + MATCH_START_LIMIT <= n) {
+        const uint32_t sequence = read_u32(data + i);
+        const uint32_t h = hash(sequence);
+        const size_t candidate = table[h];
+        table[h] = i + 1;
+
+        if (candidate == 0 || i - (candidate - 1) > MAX_OFFSET || read_u32(data + candidate - 1) != sequence) {
+            i++;
+            continue;
+        }
+
+        const size_t match = candidate - 1;
+        size_t length = MIN_MATCH;
+        while (i + length < n - LAST_LITERALS && data[match + length] == data[i + length])
+            length++;
+
+        write_sequence(out, data + anchor, i - anchor, i - match, length);
+        i += length;
+        anchor = i;
+    }
+
+    write_sequence(out, data + anchor, n - anchor, 0, 0);
+    return out;
+}
+
+
+// reads a length continued in extra bytes
+static size_t read_length(const std::span<const uint8_t> in, size_t& pos) {
+    size_t length = 0;
+    uint8_t byte;
+    do {
+        if (pos >= in.size())
+            throw Exception("LZ4 block ends in the middle of a length");
+        byte = in[pos++];
+        length += byte;
+    } while (byte == 255);
+
+    return length;
+}
+
+
+void decompress(const std::span<const uint8_t> in, const std::span<uint8_t> out) {
+    size_t in_pos = 0,
+           out_pos = 0;
+
+    while (true) {
+        if (in_pos >= in.size())
+            throw Exception("LZ4 block ends without final literals");
+        const uint8_t token = in[in_pos++];
+
+        size_t n_literals = token >> 4;
+        if (n_literals == 15)
+            n_literals += read_length(in, in_pos);
+        if (n_literals > in.size() - in_pos || n_literals > out.size() - out_pos)
+            throw Exception("LZ4 literals run past the end of the block");
+        if (n_literals > 0)
+            std::memcpy(out.data() + out_pos, in.data() + in_pos, n_literals);
+        in_pos += n_literals;
+        out_pos += n_literals;
+
+        // the last sequence only has literals
+        if (in_pos == in.size())
+            break;
+
+        if (in.size() - in_pos < 2)
+            throw Exception("LZ4 block ends in the middle of a match offset");
+        const size_t offset = in[in_pos] | (in[in_pos + 1] << 8);
+        in_pos += 2;
+        if (offset == 0 || offset > out_pos)
+            throw Exception("Invalid LZ4 match offset (" + std::to_string(offset) + ")");
+
+        size_t length = (token & 0x0f);
+        if (length == 15)
+            length += read_length(in, in_pos);
+        length += MIN_MATCH;
+        if (length > out.size() - out_pos)
+            throw Exception("LZ4 match runs past the end of the output");
+
+        // matches may overlap their own output (e.g. runs of a repeated byte), so copy byte by byte
+        const uint8_t* source = out.data() + out_pos - offset;
+        uint8_t* dest = out.data() + out_pos;
+        for (size_t j = 0; j < length; j++)
+            dest[j] = source[j];
+        out_pos += length;
+    }
+
+    if (out_pos != out.size())
+        throw Exception("LZ4 block decompressed to " + std::to_string(out_pos) + " bytes instead of " + std::to_string(out.size()));
+}
+
+}  // namespace Lz4
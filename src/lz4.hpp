@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+
+/* LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md) without the frame format around it
+ * the compressor is a plain greedy single-pass one, which compresses a bit worse than the reference implementation; any LZ4 decoder reads its output
+ * the decompressor validates all lengths and offsets, so corrupt input throws instead of reading or writing out of bounds
+ */
+namespace Lz4 {
+
+// largest compressed size of `n_bytes` bytes
+constexpr size_t compress_bound(const size_t n_bytes) {
+    return n_bytes + n_bytes / 255 + 16;
+}
+
+// upper bound on the decompressed size of a block of `n_bytes` bytes; a match length byte adds at most 255 bytes of output
+constexpr uint64_t decompress_bound(const uint64_t n_bytes) {
+    return (n_bytes + 1) * 255;
+}
+
+std::vector<uint8_t> compress(const std::span<const uint8_t> in);
+
+// `out` must have exactly the size of the original data
+// throws exception if `in` is not a valid block of that size
+void decompress(const std::span<const uint8_t> in, const std::span<uint8_t> out);
+
+}  // namespace Lz4
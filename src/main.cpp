@@ -8,16 +8,27 @@
 #include <SDL2/SDL_ttf.h>
 
 #include <cstdlib>  // EXIT_SUCCESS, EXIT_FAILURE
-#include <sstream>
-#include <iomanip>  // setprecision()
+#include <filesystem>
+#include <iostream>
+#include <string>
 
 
-int main(int /*argc*/, char* /*argv*/[]) {
+int main(int argc, char* argv[]) {
+    // --cpu and --sdl force a render backend; by default the CPU backend is only used when SDL has no accelerated renderer
+    ProgramOptions options;
+    if (argc > 2 || (argc == 2 && std::string(argv[1]) != "--cpu" && std::string(argv[1]) != "--sdl")) {
+        std::cerr << "Usage: " << argv[0] << " [--cpu | --sdl]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    if (argc == 2)
+        options.render_backend = (std::string(argv[1]) == "--cpu" ? RenderBackend::cpu : RenderBackend::sdl);
+
     // set-up quitting with ctrl+c in terminal
     Quit::set_signal_handlers();
 
     try {
-        RscDir::set("rsc");
+        // packed resources load faster, so use them if they were built
+        RscDir::set(std::filesystem::exists(RscDir::archive_file) ? RscDir::archive_file : "rsc");
     }
     catch (const std::exception& e) {
         Logger::fatal("Failed to set resource directory");
@@ -27,28 +38,26 @@ int main(int /*argc*/, char* /*argv*/[]) {
 
     // init SDL
     if (SDL_Init(SDL_INIT_VIDEO) < 0) {  // also inits SDL_INIT_EVENTS
-        Logger::fatal("SDL's video subsystem failed to initialize\nSDL error: " + std::string(SDL_GetError()));
+        Logger::fatal("SDL's video subsystem failed to initialize\nSDL error: {}", SDL_GetError());
         return EXIT_FAILURE;
     }
     if (SDL_Init(SDL_INIT_AUDIO) < 0) {
-        Logger::fatal("SDL's audio subsystem failed to initialize\nSDL error: " + std::string(SDL_GetError()));
+        Logger::fatal("SDL's audio subsystem failed to initialize\nSDL error: {}", SDL_GetError());
         return EXIT_FAILURE;
     }
     if (TTF_Init() != 0) {
-        Logger::fatal("SDL's TTF rendering engine failed to initialize\nTTF error: " + std::string(TTF_GetError()));
+        Logger::fatal("SDL's TTF rendering engine failed to initialize\nTTF error: {}", TTF_GetError());
         return EXIT_FAILURE;
     }
 
     // init and run main program
     int ret = EXIT_SUCCESS;
     try {
-        Program program;
+        Program program(options);
 
         // print start-up time
         startup_timer.set_init_time();
-        // format the startup time
-        std::stringstream ss; ss << std::fixed << std::setprecision(3) << startup_timer.get_init_time();
-        Logger::info("Start-up time: " + ss.str() + " ms");
+        Logger::info("Start-up time: {:.3f} ms", startup_timer.get_init_time());
 
         program.main_loop();
     }
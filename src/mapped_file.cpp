@@ -0,0 +1,122 @@
+#include "mapped_file.hpp"
+
+#include "exception.hpp"
+
+#include <cstring>  // strerror()
+#include <cerrno>
+#include <filesystem>
+#include <string>
+#include <utility>  // exchange()
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>  // open()
+#include <sys/mman.h>  // mmap(), munmap()
+#include <sys/stat.h>  // fstat()
+#include <unistd.h>  // close()
+#endif
+
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+    : mapping(nullptr),
+      mapping_size(0)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        throw Exception("Failed to open file '" + path.string() + "' for mapping");
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        throw Exception("Failed to map file '" + path.string() + "'; file is empty or its size is unknown");
+    }
+
+    HANDLE file_mapping = CreateFileMappingW(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+    CloseHandle(file);
+    if (file_mapping == NULL)
+        throw Exception("Failed to create file mapping of '" + path.string() + "'");
+
+    void* view = MapViewOfFile(file_mapping, FILE_MAP_COPY, 0, 0, 0);
+    // the view keeps the mapping object alive
+    CloseHandle(file_mapping);
+    if (view == NULL)
+        throw Exception("Failed to map view of '" + path.string() + "'");
+
+    mapping = static_cast<uint8_t*>(view);
+    mapping_size = file_size.QuadPart;
+#else
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1)
+        throw Exception("Failed to open file '" + path.string() + "' for mapping\nStdlib error: " + std::strerror(errno));
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1 || file_stat.st_size == 0) {
+        close(fd);
+        throw Exception("Failed to map file '" + path.string() + "'; file is empty or its size is unknown");
+    }
+
+    void* view = mmap(NULL, file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file referenced
+    close(fd);
+    if (view == MAP_FAILED)
+        throw Exception("Failed to map file '" + path.string() + "'\nStdlib error: " + std::strerror(errno));
+
+    mapping = static_cast<uint8_t*>(view);
+    mapping_size = file_stat.st_size;
+#endif
+}
+
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : mapping(std::exchange(other.mapping, nullptr)),
+      mapping_size(std::exchange(other.mapping_size, 0))
+{
+    //
+}
+
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        mapping = std::exchange(other.mapping, nullptr);
+        mapping_size = std::exchange(other.mapping_size, 0);
+    }
+
+    return *this;
+}
+
+
+uint8_t* MappedFile::data() noexcept {
+    return mapping;
+}
+
+
+const uint8_t* MappedFile::data() const noexcept {
+    return mapping;
+}
+
+
+size_t MappedFile::size() const noexcept {
+    return mapping_size;
+}
+
+
+void MappedFile::unmap() noexcept {
+    if (mapping == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, mapping_size);
+#endif
+    mapping = nullptr;
+    mapping_size = 0;
+}
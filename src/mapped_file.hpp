@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+
+/* private memory mapping of a whole file
+ * pages are shared with the page cache (and other processes mapping the file) until written to
+ * writes are copy-on-write and never reach the file
+ */
+class MappedFile {
+    public:
+        // throws exception on failure
+        MappedFile(const std::filesystem::path& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        uint8_t* data() noexcept;
+        const uint8_t* data() const noexcept;
+        size_t size() const noexcept;
+
+
+    private:
+        uint8_t* mapping;
+        size_t mapping_size;
+
+
+        void unmap() noexcept;
+};
@@ -0,0 +1,163 @@
+#include "profiling/frame_pacer.hpp"
+
+#include "profiling/timer.hpp"
+
+#include <algorithm>  // clamp()
+#include <cerrno>  // EINTR
+#include <chrono>
+#include <cmath>  // abs()
+#include <thread>  // sleep_until()
+
+#if defined(__linux__)
+#include <time.h>  // clock_nanosleep()
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>  // _mm_pause()
+#endif
+
+
+namespace {
+
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    _mm_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+}  // namespace
+
+
+FramePacer::FramePacer(const double _fps_limit, const PacingMode& _mode)
+    : mode(_mode),
+      deadline(Timer::now()),
+      overshoot_mean(INITIAL_SPIN_MARGIN / 2.0),
+      overshoot_deviation(INITIAL_SPIN_MARGIN / (2.0 * OVERSHOOT_DEVIATIONS)),
+      spin_margin(INITIAL_SPIN_MARGIN),
+      display_paced(false),
+      display_too_fast(false),
+      smoothed_present_time(0.0),
+      smoothed_present_interval(0.0),
+      last_present(Timer::now())
+{
+    set_fps_limit(_fps_limit);
+}
+
+
+void FramePacer::set_fps_limit(const double _fps_limit) {
+    fps_limit = _fps_limit;
+    frame_duration = (fps_limit > 0.0 ? std::chrono::duration_cast<Timer::TimePoint::duration>(Timer::Duration<Timer::sec>(1.0 / fps_limit)) : Timer::TimePoint::duration::zero());
+
+    // the display may not be too fast for the new limit
+    display_too_fast = false;
+}
+
+
+double FramePacer::get_fps_limit() const {
+    return fps_limit;
+}
+
+
+PacingMode FramePacer::get_mode() const {
+    return mode;
+}
+
+
+void FramePacer::wait_for_next_frame() {
+    if (fps_limit <= 0.0)
+        return;
+
+    deadline += frame_duration;
+
+    const Timer::TimePoint now = Timer::now();
+    // missed the deadline by more than a frame (e.g. a stall or vsync pacing); start counting from now instead of rushing to catch up
+    if (now > deadline + frame_duration || (mode == PacingMode::vsync && display_paced)) {
+        deadline = now;
+        return;
+    }
+
+    if (mode == PacingMode::sleep) {
+        sleep_until(deadline);
+        return;
+    }
+
+    // sleep until shortly before the deadline and learn from how late the sleep actually woke up
+    const Timer::TimePoint wake_up = deadline - std::chrono::duration_cast<Timer::TimePoint::duration>(Timer::Duration<Timer::ms>(spin_margin));
+    if (wake_up > now)
+        add_overshoot(sleep_until(wake_up));
+
+    spin_until(deadline);
+}
+
+
+void FramePacer::frame_presented(const double present_time) {
+    if (mode != PacingMode::vsync || fps_limit <= 0.0)
+        return;
+
+    const Timer::TimePoint now = Timer::now();
+    const double interval = Timer::Duration<Timer::ms>(now - last_present);
+    last_present = now;
+
+    smoothed_present_time += PRESENT_SMOOTHING * (present_time - smoothed_present_time);
+    smoothed_present_interval += PRESENT_SMOOTHING * (interval - smoothed_present_interval);
+
+    const double frame_ms = 1000.0 / fps_limit;
+    if (!display_paced) {
+        // presents block, so vsync is on; try leaving the waiting to the display
+        if (!display_too_fast && smoothed_present_time > VSYNC_BLOCK_THRESHOLD) {
+            display_paced = true;
+            smoothed_present_interval = frame_ms;
+        }
+    }
+    else if (smoothed_present_time < VSYNC_BLOCK_THRESHOLD || smoothed_present_interval < VSYNC_TOLERANCE * frame_ms) {
+        // vsync was turned off or the display refreshes faster than the limit; pace ourselves again
+        display_too_fast = smoothed_present_time >= VSYNC_BLOCK_THRESHOLD;
+        display_paced = false;
+        deadline = now;
+    }
+}
+
+
+double FramePacer::get_spin_margin() const {
+    return spin_margin;
+}
+
+
+bool FramePacer::is_display_paced() const {
+    return display_paced;
+}
+
+
+double FramePacer::sleep_until(const Timer::TimePoint& wake_up) const {
+#if defined(__linux__)
+    // steady_clock is CLOCK_MONOTONIC on Linux, so its time points are valid absolute deadlines
+    const auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(wake_up.time_since_epoch()).count();
+    timespec ts;
+    ts.tv_sec = since_epoch / 1000000000;
+    ts.tv_nsec = since_epoch % 1000000000;
+    // restart when interrupted by a signal; the absolute deadline stays the same
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR);
+#else
+    std::this_thread::sleep_until(wake_up);
+#endif
+
+    return Timer::Duration<Timer::ms>(Timer::now() - wake_up);
+}
+
+
+void FramePacer::spin_until(const Timer::TimePoint& until) const {
+    while (Timer::now() < until) {
+        if constexpr (SPIN_PAUSE)
+            cpu_relax();
+    }
+}
+
+
+void FramePacer::add_overshoot(const double overshoot) {
+    overshoot_mean += OVERSHOOT_SMOOTHING * (overshoot - overshoot_mean);
+    overshoot_deviation += OVERSHOOT_SMOOTHING * (std::abs(overshoot - overshoot_mean) - overshoot_deviation);
+
+    spin_margin = std::clamp(overshoot_mean + OVERSHOOT_DEVIATIONS * overshoot_deviation, MIN_SPIN_MARGIN, MAX_SPIN_MARGIN);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "profiling/timer.hpp"
+
+
+/* how FramePacer waits for the next frame
+ * sleep:  only sleep; cheapest, but the frame starts as late as the OS wakes the thread up
+ * hybrid: sleep until shortly before the deadline, then spin; the spin margin adapts to the measured sleep overshoot
+ * vsync:  like hybrid, but doesn't wait while presenting already blocks on a display that isn't faster than the fps limit
+ */
+enum class PacingMode {
+    sleep,
+    hybrid,
+    vsync
+};
+
+
+/* waits out the rest of each frame to limit the frame rate
+ * deadlines are absolute (start of the previous frame + frame duration), so timing errors don't accumulate
+ */
+class FramePacer {
+    public:
+        // `fps_limit <= 0.0` is uncapped
+        FramePacer(const double _fps_limit, const PacingMode& _mode = PacingMode::hybrid);
+
+        void set_fps_limit(const double _fps_limit);
+        double get_fps_limit() const;
+        PacingMode get_mode() const;
+
+        // blocks until the start of the next frame
+        void wait_for_next_frame();
+
+        // call after every present with the time the present took; only used in vsync mode
+        void frame_presented(const double present_time);
+
+        // current time spun before each deadline
+        double get_spin_margin() const;  // milliseconds
+        // true if waiting is left to vsync
+        bool is_display_paced() const;
+
+
+        /* config */
+        // bounds of the adaptive spin margin
+        static constexpr double MIN_SPIN_MARGIN = 0.05;  // milliseconds
+        static constexpr double MAX_SPIN_MARGIN = 4.0;  // milliseconds
+        static constexpr double INITIAL_SPIN_MARGIN = 1.0;  // milliseconds
+        // spin margin is the mean overshoot plus this many mean deviations
+        static constexpr double OVERSHOOT_DEVIATIONS = 4.0;
+        // weight of a new measurement in the running overshoot statistics
+        static constexpr double OVERSHOOT_SMOOTHING = 0.05;
+        // execute PAUSE while spinning, so the spinning core yields to its hyperthread and saves power
+        static constexpr bool SPIN_PAUSE = true;
+
+        // presents taking longer than this on average are considered blocked by vsync
+        static constexpr double VSYNC_BLOCK_THRESHOLD = 1.0;  // milliseconds
+        // display is considered faster than the fps limit if its frame interval is shorter than this fraction of the frame duration
+        static constexpr double VSYNC_TOLERANCE = 0.98;
+        static constexpr double PRESENT_SMOOTHING = 0.1;
+
+
+    private:
+        double fps_limit;
+        const PacingMode mode;
+
+        Timer::TimePoint deadline;
+        Timer::TimePoint::duration frame_duration;
+
+        // running statistics of how late sleep wakes up, in milliseconds
+        double overshoot_mean;
+        double overshoot_deviation;
+        double spin_margin;
+
+        // vsync mode
+        bool display_paced;
+        // set once the display is found to run faster than the fps limit; vsync can't be relied upon then
+        bool display_too_fast;
+        double smoothed_present_time;
+        double smoothed_present_interval;
+        Timer::TimePoint last_present;
+
+
+        // sleeps until `wake_up` as precisely as the OS allows; returns how late it woke up in milliseconds
+        double sleep_until(const Timer::TimePoint& wake_up) const;
+        void spin_until(const Timer::TimePoint& until) const;
+        void add_overshoot(const double overshoot);
+};
@@ -1,10 +1,112 @@
 #include "profiling/frame_performance.hpp"
 
+#include <algorithm>  // clamp(), min(), max(), fill()
+#include <cmath>  // frexp(), ldexp(), ceil()
+#include <cstdint>
+#include <iomanip>  // setprecision(), setw()
+#include <ios>  // fixed
+#include <ostream>
+#include <sstream>
+#include <limits>
+
+
+DurationHistogram::DurationHistogram() {
+    reset();
+}
+
+
+void DurationHistogram::record(const double value) {
+    buckets[bucket_index(value)]++;
+    count++;
+}
+
+
+void DurationHistogram::reset() {
+    buckets.fill(0);
+    count = 0;
+}
+
+
+uint64_t DurationHistogram::get_count() const {
+    return count;
+}
+
+
+double DurationHistogram::get_percentile(const double percentile) const {
+    if (count == 0)
+        return 0.0;
+
+    // rank of the value at `percentile`, counting from 1
+    const uint64_t rank = std::max<uint64_t>(1, std::ceil((std::clamp(percentile, 0.0, 100.0) / 100.0) * count));
+    uint64_t seen = 0;
+    for (int i = 0; i < N_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen >= rank)
+            return bucket_upper_bound(i);
+    }
+
+    return bucket_upper_bound(N_BUCKETS - 1);
+}
+
+
+double DurationHistogram::get_high_mean(const double fraction) const {
+    if (count == 0)
+        return 0.0;
+
+    // walk down from the highest bucket, taking buckets' midpoints as their values
+    const uint64_t n_wanted = std::max<uint64_t>(1, fraction * count);
+    uint64_t n_taken = 0;
+    double total = 0.0;
+    for (int i = N_BUCKETS - 1; i >= 0 && n_taken < n_wanted; i--) {
+        const uint64_t n = std::min(buckets[i], n_wanted - n_taken);
+        total += n * (bucket_lower_bound(i) + bucket_upper_bound(i)) / 2.0;
+        n_taken += n;
+    }
+
+    return total / n_taken;
+}
+
+
+/*static*/ int DurationHistogram::bucket_index(const double value) {
+    if (!(value >= std::ldexp(1.0, MIN_EXPONENT)))  // also catches NaN
+        return 0;
+
+    // `value = mantissa * 2^exponent` with mantissa in [0.5, 1)
+    int exponent;
+    const double mantissa = std::frexp(value, &exponent);
+    const int octave = (exponent - 1) - MIN_EXPONENT;
+    if (octave >= MAX_EXPONENT - MIN_EXPONENT)
+        return N_BUCKETS - 1;
+
+    const int sub_bucket = (2.0 * mantissa - 1.0) * SUB_BUCKETS;
+    return octave * SUB_BUCKETS + sub_bucket;
+}
+
+
+/*static*/ double DurationHistogram::bucket_lower_bound(const int index) {
+    const int octave = index / SUB_BUCKETS,
+              sub_bucket = index % SUB_BUCKETS;
+    return std::ldexp(1.0 + (double)sub_bucket / SUB_BUCKETS, MIN_EXPONENT + octave);
+}
+
+
+/*static*/ double DurationHistogram::bucket_upper_bound(const int index) {
+    return bucket_lower_bound(index + 1);
+}
+
 
 FramePerformance::FramePerformance(const int _history_len)
     : history_len(_history_len),
       write_index(0),
-      recorded_frame_times(0)
+      recorded_frame_times(0),
+      frame_time_total(0.0),
+      frame_ready_time_total(0.0),
+      max_frame_time(0.0),
+      budget(std::numeric_limits<double>::infinity()),
+      n_frames_over_budget(0),
+      n_idle_frames(0),
+      record_write_index(0),
+      n_records(0)
 {
     frame_times.resize(history_len, 0.0);
     frame_ready_times.resize(history_len, 0.0);
@@ -33,6 +135,10 @@ int FramePerformance::get_history_len() const {
 
 
 void FramePerformance::add_frame_time(const double frame_time, const double frame_ready_time) {
+    // unused entries are 0.0, so they can be subtracted as well
+    frame_time_total += frame_time - frame_times[write_index];
+    frame_ready_time_total += frame_ready_time - frame_ready_times[write_index];
+
     frame_times[write_index] = frame_time;
     frame_ready_times[write_index] = frame_ready_time;
 
@@ -40,6 +146,25 @@ void FramePerformance::add_frame_time(const double frame_time, const double fram
 
     if (recorded_frame_times < history_len)
         recorded_frame_times++;
+
+    // recompute the running sums once per pass through the ringbuffer, so rounding errors don't build up
+    if (write_index == 0) {
+        frame_time_total = frame_ready_time_total = 0.0;
+        for (int i = 0; i < history_len; i++) {
+            frame_time_total += frame_times[i];
+            frame_ready_time_total += frame_ready_times[i];
+        }
+    }
+
+    frame_time_histogram.record(frame_time);
+    max_frame_time = std::max(max_frame_time, frame_time);
+    if (frame_ready_time > budget)
+        n_frames_over_budget++;
+}
+
+
+void FramePerformance::add_idle_frame() {
+    n_idle_frames++;
 }
 
 
@@ -47,20 +172,103 @@ double FramePerformance::get_fps() const {
     if (recorded_frame_times == 0)
         return -1.0;
 
-    double total = 0.0;
-    for (int i = 0; i < recorded_frame_times; i++)
-        total += frame_times[i];
-
-    return UNIT_PER_SECOND / (total / recorded_frame_times);
+    return UNIT_PER_SECOND / (frame_time_total / recorded_frame_times);
 }
 
 double FramePerformance::get_unlocked_fps() const {
     if (recorded_frame_times == 0)
         return -1.0;
 
-    double total = 0.0;
-    for (int i = 0; i < recorded_frame_times; i++)
-        total += frame_ready_times[i];
+    return UNIT_PER_SECOND / (frame_ready_time_total / recorded_frame_times);
+}
+
+
+void FramePerformance::set_frame_budget(const double _budget) {
+    budget = _budget;
+}
+
+
+void FramePerformance::reset_statistics() {
+    frame_time_histogram.reset();
+    max_frame_time = 0.0;
+    n_frames_over_budget = 0;
+    n_idle_frames = 0;
+}
+
+
+uint64_t FramePerformance::get_n_frames() const {
+    return frame_time_histogram.get_count();
+}
+
+
+double FramePerformance::get_frame_time_percentile(const double percentile) const {
+    // the bucket's upper bound may lie above any recorded frame time
+    return std::min(frame_time_histogram.get_percentile(percentile), max_frame_time);
+}
+
+
+double FramePerformance::get_max_frame_time() const {
+    return max_frame_time;
+}
+
+
+double FramePerformance::get_one_percent_low_fps() const {
+    if (frame_time_histogram.get_count() == 0)
+        return -1.0;
+
+    return UNIT_PER_SECOND / frame_time_histogram.get_high_mean(0.01);
+}
+
+
+uint64_t FramePerformance::get_n_frames_over_budget() const {
+    return n_frames_over_budget;
+}
+
+
+uint64_t FramePerformance::get_n_idle_frames() const {
+    return n_idle_frames;
+}
+
+
+void FramePerformance::print_statistics(std::ostream& os) const {
+    // use stringstream to contain `std::fixed`/`std::setprecision` modifiers
+    const int width = 18;
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(3)
+       << "--- Frame statistics (" << get_n_frames() << " frames) ---\n"
+       << std::setw(width) << "p50 frame time: "   << get_frame_time_percentile(50.0) << " ms\n"
+       << std::setw(width) << "p95 frame time: "   << get_frame_time_percentile(95.0) << " ms\n"
+       << std::setw(width) << "p99 frame time: "   << get_frame_time_percentile(99.0) << " ms\n"
+       << std::setw(width) << "p99.9 frame time: " << get_frame_time_percentile(99.9) << " ms\n"
+       << std::setw(width) << "max frame time: "   << get_max_frame_time()            << " ms\n"
+       << std::setw(width) << "1% low fps: "       << get_one_percent_low_fps()       << '\n'
+       << std::setw(width) << "over budget: "      << get_n_frames_over_budget()      << " frames\n"
+       << std::setw(width) << "idle: "             << get_n_idle_frames()             << " frames\n";
+
+    os << ss.str()
+       << std::flush;
+}
+
+
+void FramePerformance::add_frame_record(const FrameRecord& record) {
+    records[record_write_index] = record;
+    record_write_index = (record_write_index + 1) % RECORD_HISTORY_LEN;
+
+    if (n_records < RECORD_HISTORY_LEN)
+        n_records++;
+}
+
+
+int FramePerformance::get_n_frame_records() const {
+    return n_records;
+}
+
+
+const FrameRecord& FramePerformance::get_frame_record(const int age) const {
+    return records[(record_write_index - 1 - age + RECORD_HISTORY_LEN) % RECORD_HISTORY_LEN];
+}
+
 
-    return UNIT_PER_SECOND / (total / recorded_frame_times);
+double FramePerformance::get_frame_budget() const {
+    return budget;
 }
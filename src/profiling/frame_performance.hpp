@@ -1,8 +1,59 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <ostream>
 #include <vector>
 
 
+/* log-scale histogram of durations with fixed buckets, in the style of HDR histograms
+ * every power of two is split into `SUB_BUCKETS` linear buckets, so values are stored with a relative precision of `1 / SUB_BUCKETS`
+ * recording is O(1) and never allocates; queries walk the buckets
+ */
+class DurationHistogram {
+    public:
+        DurationHistogram();
+
+        // `value` should be milliseconds; values outside of the range are clamped to the first/last bucket
+        void record(const double value);
+        void reset();
+
+        uint64_t get_count() const;
+        // `percentile` from 0.0 to 100.0; returns the upper bound of the bucket containing the percentile, or 0.0 if empty
+        double get_percentile(const double percentile) const;
+        // average of the highest `fraction` of recorded values
+        double get_high_mean(const double fraction) const;
+
+
+        /* config */
+        static constexpr int SUB_BUCKETS = 64;
+        // range covered is [2^MIN_EXPONENT, 2^MAX_EXPONENT) milliseconds
+        static constexpr int MIN_EXPONENT = -6;  // ~0.016 ms
+        static constexpr int MAX_EXPONENT = 14;  // ~16 seconds
+        static constexpr int N_BUCKETS = (MAX_EXPONENT - MIN_EXPONENT) * SUB_BUCKETS;
+
+
+    private:
+        std::array<uint64_t, N_BUCKETS> buckets;
+        uint64_t count;
+
+
+        static int bucket_index(const double value);
+        static double bucket_lower_bound(const int index);
+        static double bucket_upper_bound(const int index);
+};
+
+
+// time spent in the stages of a frame, in the unit supplied to FramePerformance::add_frame_time()
+struct FrameRecord {
+    double frame_time = 0.0;
+    double events = 0.0;
+    double update = 0.0;
+    double prepare = 0.0;
+    double present = 0.0;
+};
+
+
 class FramePerformance {
     public:
         /* `history_len` determines the number of data points in ringbuffer for measuring fps
@@ -17,15 +68,44 @@ class FramePerformance {
 
         // `frame_time` and `frame_ready_time` should be milliseconds
         // otherwise, be sure to update `UNIT_PER_SECOND`
+        // O(1) and allocation free
         void add_frame_time(const double frame_time, const double frame_ready_time);
+        // iteration of the main loop which slept until there was something to draw (retained rendering)
+        // only counted, as its duration is idle time rather than frame time
+        void add_idle_frame();
 
         double get_fps() const;
         double get_unlocked_fps() const;
 
+        // frames whose ready time exceeds `budget` are counted as over budget; usually `UNIT_PER_SECOND / fps_limit`
+        void set_frame_budget(const double _budget);
+
+        /* statistics over all frames since start or the last reset_statistics() */
+        void reset_statistics();
+        uint64_t get_n_frames() const;
+        // `percentile` from 0.0 to 100.0; frame time in the unit supplied to add_frame_time()
+        double get_frame_time_percentile(const double percentile) const;
+        double get_max_frame_time() const;
+        // average fps of the slowest 1% of frames
+        double get_one_percent_low_fps() const;
+        uint64_t get_n_frames_over_budget() const;
+        uint64_t get_n_idle_frames() const;
+
+        void print_statistics(std::ostream& os) const;
+
+        /* history of per-stage frame times, e.g. for graphs; separate from the fps ringbuffer, as it is much longer */
+        // O(1) and allocation free
+        void add_frame_record(const FrameRecord& record);
+        int get_n_frame_records() const;
+        // `age == 0` is the latest record; `age` must be lower than get_n_frame_records()
+        const FrameRecord& get_frame_record(const int age) const;
+        double get_frame_budget() const;
+
 
         /* config */
         // number of the unit supplied to add_frame_time() in a second
         static constexpr double UNIT_PER_SECOND = 1000.0;
+        static constexpr int RECORD_HISTORY_LEN = 256;
 
 
     private:
@@ -41,4 +121,18 @@ class FramePerformance {
         // ringbuffers containing the frame-times
         std::vector<double> frame_times;
         std::vector<double> frame_ready_times;
+
+        // running sums of the ringbuffers
+        double frame_time_total;
+        double frame_ready_time_total;
+
+        DurationHistogram frame_time_histogram;
+        double max_frame_time;
+        double budget;
+        uint64_t n_frames_over_budget;
+        uint64_t n_idle_frames;
+
+        std::array<FrameRecord, RECORD_HISTORY_LEN> records;
+        int record_write_index;
+        int n_records;
 };
@@ -0,0 +1,45 @@
+#include "profiling/memory_usage.hpp"
+
+#include <cstddef>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>  // GetProcessMemoryInfo()
+#elif defined(__linux__)
+#include <cstdio>  // fopen(), fscanf()
+#include <unistd.h>  // sysconf()
+#endif
+
+
+namespace MemoryUsage {
+
+#if defined(_WIN32)
+size_t get_working_set() {
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+
+    return counters.WorkingSetSize;
+}
+#elif defined(__linux__)
+size_t get_working_set() {
+    // second field is the number of resident pages; plain stdio, as this may be called while drawing a frame
+    FILE* const statm = std::fopen("/proc/self/statm", "r");
+    if (statm == NULL)
+        return 0;
+
+    unsigned long size, resident;
+    const int n_read = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    if (n_read != 2)
+        return 0;
+
+    return resident * sysconf(_SC_PAGESIZE);
+}
+#else
+size_t get_working_set() {
+    return 0;
+}
+#endif
+
+}  // namespace MemoryUsage
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+
+
+namespace MemoryUsage {
+
+// resident memory of this process in bytes; 0 if it can't be determined
+// reads from the OS, so avoid calling it every frame
+size_t get_working_set();
+
+}  // namespace MemoryUsage
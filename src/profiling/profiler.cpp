@@ -0,0 +1,106 @@
+#include "profiling/profiler.hpp"
+
+#include "exception.hpp"
+#include "logger.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <memory>  // make_shared()
+#include <mutex>
+#include <string>  // to_string()
+#include <vector>
+
+
+namespace Profiler {
+
+namespace {
+
+// buffers of all threads that ever recorded; kept after a thread exits, so its events can still be written
+std::mutex registry_mutex;
+std::vector<std::shared_ptr<ThreadBuffer>> registry;
+
+
+std::string escape_json(const std::string& str) {
+    std::string escaped;
+    escaped.reserve(str.size());
+    for (const char c : str) {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+}  // namespace
+
+
+ThreadBuffer::ThreadBuffer(const int _thread_id)
+    : thread_id(_thread_id),
+      thread_name("thread " + std::to_string(_thread_id)),
+      events(EVENTS_PER_THREAD),
+      n_dropped(0) {}
+
+
+void ThreadBuffer::record(const Event& event) noexcept {
+    if (events.write(&event, 1) == 0)
+        n_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+ThreadBuffer& get_thread_buffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer = []() {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        registry.push_back(std::make_shared<ThreadBuffer>(registry.size()));
+        return registry.back();
+    }();
+
+    return *buffer;
+}
+
+
+void set_thread_name(const std::string& name) {
+    ThreadBuffer& buffer = get_thread_buffer();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    buffer.thread_name = name;
+}
+
+
+void write_trace(const std::filesystem::path& path) {
+    std::ofstream file(path);
+    if (!file.is_open())
+        throw Exception("Failed to open '" + path.string() + "' for writing trace");
+
+    // the lock also makes this the only reader of the ring buffers
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    uint64_t n_dropped = 0;
+    for (const std::shared_ptr<ThreadBuffer>& buffer : registry) {
+        file << (first ? "" : ",\n")
+             << R"({"name":"thread_name","ph":"M","pid":1,"tid":)" << buffer->thread_id
+             << R"(,"args":{"name":")" << escape_json(buffer->thread_name) << "\"}}";
+        first = false;
+
+        // timestamps are in microseconds
+        Event event;
+        while (buffer->events.read(&event, 1) == 1) {
+            file << ",\n"
+                 << R"({"name":")" << escape_json(event.name) << R"(","ph":"X","pid":1,"tid":)" << buffer->thread_id
+                 << ",\"ts\":" << event.start / 1000 << '.' << std::to_string(1000 + event.start % 1000).substr(1)
+                 << ",\"dur\":" << event.duration / 1000 << '.' << std::to_string(1000 + event.duration % 1000).substr(1) << '}';
+        }
+
+        n_dropped += buffer->n_dropped.exchange(0, std::memory_order_relaxed);
+    }
+    file << "\n]}\n";
+
+    if (!file)
+        throw Exception("Failed to write trace to '" + path.string() + "'");
+
+    if (n_dropped > 0)
+        Logger::warning("Dropped {} profiler events, as buffers were full; write traces more often or increase `Profiler::EVENTS_PER_THREAD`", n_dropped);
+    Logger::info("Wrote trace to '{}'", path.string());
+}
+
+}  // namespace Profiler
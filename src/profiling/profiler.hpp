@@ -0,0 +1,112 @@
+#pragma once
+
+#include "audio/ring_buffer.hpp"
+#include "profiling/timer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+
+/* scoped instrumentation profiler exporting Chrome Trace Event JSON (open in chrome://tracing or ui.perfetto.dev)
+ * usage:
+ *   void some_function() {
+ *       PROFILE_SCOPE("some_function");
+ *       // code to measure
+ *   }
+ *
+ * only compiled in if `ENABLE_PROFILING` is defined (`make PROFILE=1`); otherwise PROFILE_SCOPE() expands to nothing
+ * every thread records into its own lock-free ring buffer, so recording doesn't lock
+ * the first event on a thread allocates its buffer, so don't profile the audio callback
+ */
+namespace Profiler {
+
+#ifdef ENABLE_PROFILING
+constexpr bool ENABLED = true;
+#else
+constexpr bool ENABLED = false;
+#endif
+
+
+struct Event {
+    // must have static storage duration, e.g. a string literal
+    const char* name;
+    int64_t start;  // nanoseconds
+    int64_t duration;  // nanoseconds
+};
+
+
+// recording side of a thread
+class ThreadBuffer {
+    public:
+        ThreadBuffer(const int _thread_id);
+
+        void record(const Event& event) noexcept;
+
+
+        const int thread_id;
+        std::string thread_name;
+
+        SpscRingBuffer<Event> events;
+        std::atomic<uint64_t> n_dropped;
+};
+
+
+// the calling thread's buffer; registered on first use
+ThreadBuffer& get_thread_buffer();
+
+// name shown for the calling thread in the trace
+void set_thread_name(const std::string& name);
+
+/* writes all events recorded since the previous call to `path` as a Chrome Trace Event JSON file
+ * events recorded while a thread's buffer was full are dropped (and reported)
+ * throws exception on failure
+ * thread safe
+ */
+void write_trace(const std::filesystem::path& path);
+
+
+inline int64_t to_nanoseconds(const Timer::TimePoint& time_point) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time_point.time_since_epoch()).count();
+}
+
+
+class Scope {
+    public:
+        Scope(const char* const _name)
+            : name(_name),
+              start(Timer::now()) {}
+
+        ~Scope() {
+            const Timer::TimePoint end = Timer::now();
+            get_thread_buffer().record({.name = name, .start = to_nanoseconds(start), .duration = to_nanoseconds(end) - to_nanoseconds(start)});
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+
+    private:
+        const char* const name;
+        const Timer::TimePoint start;
+};
+
+
+/* config */
+// events per thread kept between write_trace() calls
+constexpr size_t EVENTS_PER_THREAD = 1 << 16;
+
+}  // namespace Profiler
+
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifdef ENABLE_PROFILING
+#define PROFILE_SCOPE(name) const Profiler::Scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
@@ -2,56 +2,353 @@
 
 #include "quit.hpp"
 #include "logger.hpp"
+#include "rsc_dir.hpp"
+#include "audio/mixer.hpp"
+#include "audio/monitor.hpp"
 #include "audio/wave_data.hpp"
 #include "audio/audio_file_loader/loaders.hpp"
+#include "audio/audio_asset_cache.hpp"
+#include "audio/audio_file_loader/wav_header.hpp"
+#include "audio/audio_file_loader/wav_stream.hpp"
 #include "profiling/frame_performance.hpp"
+#include "profiling/profiler.hpp"
+#include "profiling/memory_usage.hpp"
 #include "profiling/timer.hpp"
 
-#include <thread>  // sleep_for()
+#include <thread>  // sleep_until(), jthread
+#include <memory>  // make_unique()
+#include <string>  // to_string()
+#include <algorithm>  // clamp(), min(), max()
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <stop_token>
+#include <utility>  // move()
+#include <vector>
+#include <filesystem>
+#include <fstream>
 
 
-Program::Program()
-    : main_window("Project name", 800, 600, main_window_data),
+Program::Program(const ProgramOptions& _options)
+    : options(_options),
+      frame_count(0),
+      next_scripted_event(0),
+      audio_cache(thread_pool, AUDIO_CACHE_BUDGET, (options.audio_disk_cache ? RscDir::get_cache_dir() / AUDIO_DISK_CACHE_DIR : std::filesystem::path())),
+      main_window("Project name", 800, 600, main_window_data, thread_pool, options.render_mode, options.render_backend, options.headless),
+      frame_pacer(options.fps_limit, PACING_MODE),
       frame_perf(20),
+      show_hud(false),
+      working_set(0),
+      fps_counter_version(0),
+      performance_hud_version(0),
+      shown_fps(-1.0),
+      shown_unlocked_fps(-1.0),
       sample_config({.sample_rate=44100, .n_channels=2}),
-      audio_playback(sample_config)
+      mixer(sample_config),
+      audio_playback(sample_config, AUDIO_FRAMES_PER_BUFFER, AUDIO_MODE),
+      last_latency_test_state(LatencyTestState::idle)
 {
-    fps_limit = 60.0;
+    if (options.fps_limit > 0.0)
+        frame_perf.set_frame_budget(FramePerformance::UNIT_PER_SECOND / options.fps_limit);
+
+    audio_playback.set_source(&mixer);
 }
 
 
 void Program::main_loop() {
+    if constexpr (Profiler::ENABLED)
+        Profiler::set_thread_name("main");
+
+    if constexpr (THREADED_SIMULATION) {
+        main_loop_threaded();
+        frame_perf.print_statistics(std::cout);
+        write_trace();
+        return;
+    }
+
     Timer::TimePoint frame_start = Timer::now();
-    Timer::Duration<Timer::ms> frame_time(0.0);
-    Timer::Duration<Timer::ms> real_frame_time(0.0);
 
     audio_playback.unpause_device();
-    while (!Quit::poll_quit()) {
+    while (!is_finished()) {
+        push_scripted_events();
+
         // handle SDL events
-        handle_sdl_events();
+        {
+            PROFILE_SCOPE("handle_sdl_events");
+            const Timer::TimePoint stage_start = Timer::now();
+            handle_sdl_events();
+            frame_record.events = Timer::Duration<Timer::ms>(Timer::now() - stage_start);
+        }
         if (Quit::poll_quit())
             break;
 
         // alter internal structures and prepare next frame
-        update_state();
-        main_window.prepare_frame(main_window_data);
-
-        // calculate real frame rate
-        real_frame_time = Timer::now() - frame_start;
-
-        // sleep rest of frame out
-        const double milliseconds_in_frame = 1000.0 / fps_limit;
-        std::this_thread::sleep_for(Timer::Duration<Timer::ms>((milliseconds_in_frame - real_frame_time) - SLEEP_REDUCTION));
-        // spin lock rest of time if `SLEEP_REDUCTION` is used
-        while (Timer::Duration<Timer::ms>(Timer::now() - frame_start) < milliseconds_in_frame);
-        // calculate frame rate
-        frame_time = Timer::now() - frame_start;
-        frame_start = Timer::now();
-        frame_perf.add_frame_time(frame_time, real_frame_time);
-
-        // render frame
+        {
+            PROFILE_SCOPE("update_state");
+            const Timer::TimePoint stage_start = Timer::now();
+            update_state();
+            frame_record.update = Timer::Duration<Timer::ms>(Timer::now() - stage_start);
+        }
+        set_render_data(main_window_data);
+        bool changed;
+        {
+            PROFILE_SCOPE("prepare_frame");
+            const Timer::TimePoint stage_start = Timer::now();
+            changed = main_window.prepare_frame(main_window_data);
+            frame_record.prepare = Timer::Duration<Timer::ms>(Timer::now() - stage_start);
+        }
+
+        finish_frame(frame_start, changed);
+    }
+
+    frame_perf.print_statistics(std::cout);
+    write_trace();
+}
+
+
+void Program::main_loop_threaded() {
+    Timer::TimePoint frame_start = Timer::now();
+
+    const Timer::Duration<Timer::sec> tick_duration(1.0 / SIMULATION_RATE);
+    SimulationSnapshot previous = snapshots.front(),
+                       latest = snapshots.front();
+
+    audio_playback.unpause_device();
+    // joined at the end of this scope, before the state it uses is destroyed
+    std::jthread simulation_thread([this](std::stop_token stop_token) { simulation_loop(stop_token); });
+    while (!is_finished()) {
+        push_scripted_events();
+
+        // handle SDL events; input for the simulation is queued
+        {
+            PROFILE_SCOPE("handle_sdl_events");
+            const Timer::TimePoint stage_start = Timer::now();
+            handle_sdl_events();
+            frame_record.events = Timer::Duration<Timer::ms>(Timer::now() - stage_start);
+        }
+        if (Quit::poll_quit())
+            break;
+
+        // pick up the latest snapshot; skipped snapshots aren't needed, as only the latest two are interpolated
+        if (snapshots.update()) {
+            previous = latest;
+            latest = snapshots.front();
+        }
+
+        // draw the state one tick in the past, between the two latest snapshots
+        const Timer::TimePoint render_time = Timer::now() - std::chrono::duration_cast<Timer::TimePoint::duration>(tick_duration);
+        const double tick_span = Timer::Duration<Timer::sec>(latest.time - previous.time);
+        const double since_previous = Timer::Duration<Timer::sec>(render_time - previous.time);
+        const double alpha = (tick_span > 0.0 ? std::clamp(since_previous / tick_span, 0.0, 1.0) : 1.0);
+        WindowData frame_window_data = interpolate(previous.window_data, latest.window_data, alpha);
+        set_render_data(frame_window_data);
+        bool changed;
+        {
+            PROFILE_SCOPE("prepare_frame");
+            const Timer::TimePoint stage_start = Timer::now();
+            changed = main_window.prepare_frame(frame_window_data);
+            frame_record.prepare = Timer::Duration<Timer::ms>(Timer::now() - stage_start);
+        }
+
+        finish_frame(frame_start, changed);
+    }
+}
+
+
+uint64_t Program::get_n_frames() const {
+    return frame_count;
+}
+
+
+const FramePerformance& Program::get_frame_performance() const {
+    return frame_perf;
+}
+
+
+bool Program::is_finished() const {
+    return Quit::poll_quit() || (options.max_frames > 0 && frame_count >= options.max_frames);
+}
+
+
+void Program::push_scripted_events() {
+    while (next_scripted_event < options.event_script.size() && options.event_script[next_scripted_event].frame <= frame_count) {
+        const ScriptedEvent& scripted = options.event_script[next_scripted_event++];
+        SDL_Event event = scripted.event;
+        if (event.type == SDL_DROPFILE)
+            event.drop.file = SDL_strdup(scripted.dropped_file.c_str());
+
+        if (SDL_PushEvent(&event) < 0) {
+            Logger::warning("Failed to push scripted event\nSDL error: {}", SDL_GetError());
+            if (event.type == SDL_DROPFILE)
+                SDL_free(event.drop.file);
+        }
+    }
+}
+
+
+void Program::finish_frame(Timer::TimePoint& frame_start, const bool present) {
+    // calculate real frame rate
+    const Timer::Duration<Timer::ms> real_frame_time = Timer::now() - frame_start;
+
+    // wait out rest of frame, or until there is something to draw
+    const bool idle = !present && can_idle();
+    if (!idle) {
+        PROFILE_SCOPE("wait_for_next_frame");
+        frame_pacer.wait_for_next_frame();
+    }
+    else {
+        PROFILE_SCOPE("wait_for_events");
+        wait_for_events();
+    }
+    // calculate frame rate
+    const Timer::TimePoint now = Timer::now();
+    const Timer::Duration<Timer::ms> frame_time = now - frame_start;
+    frame_start = now;
+
+    // the time slept waiting for events isn't frame time; it would show up as stutter in the statistics and as the wake-up rate in the fps counter
+    if (idle) {
+        frame_perf.add_idle_frame();
+        frame_record = {};
+        frame_count++;
+        return;
+    }
+    frame_perf.add_frame_time(frame_time, real_frame_time);
+
+    // render frame
+    double present_time = 0.0;
+    if (present) {
+        PROFILE_SCOPE("render_frame");
         main_window.render_frame();
+        present_time = Timer::Duration<Timer::ms>(Timer::now() - now);
+        frame_pacer.frame_presented(present_time);
+    }
+
+    frame_record.frame_time = frame_time;
+    frame_record.present = present_time;
+    frame_perf.add_frame_record(frame_record);
+    frame_record = {};
+
+    frame_count++;
+}
+
+
+bool Program::can_idle() const {
+    // the simulation thread changes the window data on its own
+    if constexpr (THREADED_SIMULATION)
+        return false;
+
+    // the HUD's graph changes every frame; audio streams, loads, monitoring and scripts are polled every frame
+    return main_window.get_render_mode() == RenderMode::retained
+        && !show_hud
+        && !wav_stream
+        && pending_loads.empty()
+        && !monitor
+        && next_scripted_event >= options.event_script.size();
+}
+
+
+void Program::wait_for_events() {
+    double timeout = MAX_IDLE_WAIT;
+    if (main_window_data.fps_data.show_fps)
+        timeout = std::min<double>(timeout, FPS_UPDATE_INTERVAL - Timer::Duration<Timer::ms>(Timer::now() - last_fps_update));
+
+    // leaves the event in the queue for handle_sdl_events()
+    SDL_WaitEventTimeout(NULL, std::max(1, static_cast<int>(timeout)));
+}
+
+
+void Program::set_render_data(WindowData& window_data) {
+    // only refreshed every `FPS_UPDATE_INTERVAL`, so retained rendering can skip the frames in between
+    const Timer::TimePoint now = Timer::now();
+    if (Timer::Duration<Timer::ms>(now - last_fps_update) >= FPS_UPDATE_INTERVAL) {
+        const double fps = frame_perf.get_fps(),
+                     unlocked_fps = frame_perf.get_unlocked_fps();
+        if (fps != shown_fps || unlocked_fps != shown_unlocked_fps) {
+            shown_fps = fps;
+            shown_unlocked_fps = unlocked_fps;
+            fps_counter_version++;
+        }
+        last_fps_update = now;
     }
+    window_data.fps_data.fps = shown_fps;
+    window_data.fps_data.unlocked_fps = shown_unlocked_fps;
+    window_data.fps_data.version = fps_counter_version;
+
+    PerformanceHudData& hud_data = window_data.hud_data;
+    hud_data.show = show_hud;
+    hud_data.version = performance_hud_version;
+    if (!show_hud)
+        return;
+
+    // the graph scrolls every frame
+    hud_data.version = ++performance_hud_version;
+
+    hud_data.frame_perf = &frame_perf;
+    hud_data.audio_queued_frames = audio_playback.get_n_queued_frames();
+    hud_data.audio_fill_level = audio_playback.get_fill_level();
+
+    // reading the working set asks the OS, so don't do it every frame
+    if (Timer::Duration<Timer::ms>(now - last_working_set_update) >= WORKING_SET_INTERVAL) {
+        working_set = MemoryUsage::get_working_set();
+        last_working_set_update = now;
+    }
+    hud_data.working_set = working_set;
+
+    const RenderStats& render_stats = main_window.get_render_stats();
+    hud_data.draw_calls = render_stats.n_draw_calls;
+    hud_data.quads = render_stats.n_quads;
+}
+
+
+void Program::simulation_loop(std::stop_token stop_token) {
+    const auto tick_duration = std::chrono::duration_cast<Timer::TimePoint::duration>(Timer::Duration<Timer::sec>(1.0 / SIMULATION_RATE));
+    Timer::TimePoint next_tick = Timer::now();
+
+    if constexpr (Profiler::ENABLED)
+        Profiler::set_thread_name("simulation");
+
+    while (!stop_token.stop_requested()) {
+        PROFILE_SCOPE("simulation_tick");
+        run_simulation_queue();
+        update_state();
+
+        SimulationSnapshot& snapshot = snapshots.back();
+        snapshot.window_data = main_window_data;
+        snapshot.time = next_tick;
+        snapshots.publish();
+
+        // absolute deadlines, so sleep overshoot doesn't accumulate
+        next_tick += tick_duration;
+        const Timer::TimePoint now = Timer::now();
+        if (now - next_tick > MAX_SIMULATION_LAG * tick_duration) {
+            // fell too far behind (e.g. a stall); continue from now instead of running a burst of ticks
+            next_tick = now;
+        }
+        std::this_thread::sleep_until(next_tick);
+    }
+}
+
+
+void Program::run_on_simulation(std::function<void()> task) {
+    if constexpr (!THREADED_SIMULATION) {
+        task();
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(simulation_queue_mutex);
+    simulation_queue.push_back(std::move(task));
+}
+
+
+void Program::run_simulation_queue() {
+    std::vector<std::function<void()>> tasks;
+    {
+        std::lock_guard<std::mutex> lock(simulation_queue_mutex);
+        tasks.swap(simulation_queue);
+    }
+
+    for (const std::function<void()>& task : tasks)
+        task();
 }
 
 
@@ -73,7 +370,28 @@ void Program::handle_sdl_events() {
 
                     // DEBUG: stop audio playback
                     case SDLK_s:
-                        audio_playback.clear_queued_samples();
+                        run_on_simulation([this]() { stop_playback(); });
+                        break;
+
+                    // DEBUG: toggle performance HUD
+                    case SDLK_h:
+                        show_hud = !show_hud;
+                        performance_hud_version++;
+                        break;
+
+                    // DEBUG: write profiler trace
+                    case SDLK_p:
+                        write_trace();
+                        break;
+
+                    // DEBUG: toggle input monitoring
+                    case SDLK_m:
+                        run_on_simulation([this]() { toggle_monitoring(); });
+                        break;
+
+                    // DEBUG: measure round-trip latency of input monitoring
+                    case SDLK_l:
+                        run_on_simulation([this]() { start_latency_test(); });
                         break;
                 }
                 break;
@@ -111,9 +429,7 @@ void Program::handle_sdl_events() {
                 {
                     const std::string dropped_file_path(e.drop.file);
                     SDL_free(e.drop.file);
-                    WaveData song = AudioFileLoader::best_loader(dropped_file_path, sample_config);
-                    audio_playback.clear_queued_samples();
-                    audio_playback.send_samples(song.samples.data(), song.samples.size());
+                    run_on_simulation([this, dropped_file_path]() { play_dropped_file(dropped_file_path); });
                     break;
                 }
 
@@ -125,8 +441,19 @@ void Program::handle_sdl_events() {
 
                     // case SDL_WINDOWEVENT_SIZE_CHANGED:  // all size changes
                     case SDL_WINDOWEVENT_RESIZED:  // only final size
-                        main_window.set_resolution(e.window.data1, e.window.data2, main_window_data);
-                        // TODO: force redraw?
+                        {
+                            // the window belongs to the render loop; the layout in `main_window_data` to the simulation
+                            const int w = e.window.data1,
+                                      h = e.window.data2;
+                            main_window.set_resolution(w, h);
+                            run_on_simulation([this, w, h]() { main_window.calculate_screen_coordinates(main_window_data, w, h); });
+                        }
+                        main_window.invalidate();
+                        break;
+
+                    // the window system may have discarded the window's contents
+                    case SDL_WINDOWEVENT_EXPOSED:
+                        main_window.invalidate();
                         break;
 
                     // case SDL_WINDOWEVENT_ENTER:
@@ -139,7 +466,8 @@ void Program::handle_sdl_events() {
 
             case SDL_RENDER_TARGETS_RESET:
             case SDL_RENDER_DEVICE_RESET:
-                Logger::error("Graphics had a mishap");
+                Logger::warning("Renderer lost its textures; reloading them");
+                main_window.handle_render_reset();
                 break;
         }
     }
@@ -147,5 +475,146 @@ void Program::handle_sdl_events() {
 
 
 void Program::update_state() {
-    main_window_data.fps_data.fps = frame_perf.get_fps();
+    if (wav_stream) {
+        // the file may be truncated or removed while streaming; stop the stream instead of the program
+        try {
+            if (!wav_stream->top_up(audio_playback, STREAM_LATENCY))
+                wav_stream.reset();
+        }
+        catch (const std::exception& e) {
+            Logger::error("Failed to stream dropped file");
+            Logger::exception(e);
+            wav_stream.reset();
+        }
+    }
+
+    audio_cache.update();
+    for (size_t i = 0; i < pending_loads.size();) {
+        const std::shared_ptr<const AudioAsset>& load = pending_loads[i];
+        if (!load->is_ready()) {
+            i++;
+            continue;
+        }
+
+        try {
+            const VoiceId voice = mixer.play(load->get());
+            if (voice.is_valid())
+                Logger::info("Playing '{}'", load->get_path());
+            else
+                Logger::warning("Can't play '{}'; all {} voices are in use", load->get_path(), Mixer::MAX_VOICES);
+        }
+        catch (const std::exception& e) {
+            Logger::error("Failed to load '{}'", load->get_path());
+            Logger::exception(e);
+        }
+        pending_loads.erase(pending_loads.begin() + i);
+    }
+
+    // releases the wave data of ended voices
+    mixer.update();
+
+    // report finished latency tests
+    if (monitor) {
+        const LatencyTestState latency_test_state = monitor->get_latency_test_state();
+        if (latency_test_state != last_latency_test_state) {
+            if (latency_test_state == LatencyTestState::succeeded)
+                Logger::info("Round-trip latency: {:.2f} ms (drift correction: {:.1f} ppm)", monitor->get_round_trip_latency(), monitor->get_drift_correction());
+            else if (latency_test_state == LatencyTestState::failed)
+                Logger::warning("Latency test failed; the impulse didn't come back through the input");
+            last_latency_test_state = latency_test_state;
+        }
+    }
+}
+
+
+// length of a WAV file the loaders can decode themselves; 0.0 for other files
+static double get_wav_length(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return 0.0;
+
+    try {
+        const AudioFileLoader::WavInfo wav_info = AudioFileLoader::read_wav_info(file);
+        return (double)wav_info.get_n_frames() / wav_info.sample_rate;
+    }
+    catch (const std::exception&) {
+        return 0.0;
+    }
+}
+
+
+void Program::play_dropped_file(const std::string& path) {
+    // long files are streamed, so playback starts right away and memory use stays bounded
+    if (get_wav_length(path) >= STREAM_MIN_LENGTH) {
+        wav_stream.reset();
+        audio_playback.clear_queued_samples();
+        try {
+            wav_stream = std::make_unique<AudioFileLoader::WavStream>(path, sample_config);
+            wav_stream->top_up(audio_playback, STREAM_LATENCY);
+            Logger::info("Streaming '{}'", path);
+            return;
+        }
+        catch (const std::exception& e) {
+            wav_stream.reset();
+            Logger::info("Can't stream '{}' ({}); loading whole file in the background instead", path, e.what());
+        }
+    }
+
+    pending_loads.push_back(audio_cache.load(path, sample_config));
+}
+
+
+void Program::stop_playback() {
+    wav_stream.reset();
+    // frees the workers for newer loads
+    audio_cache.cancel_loads();
+    pending_loads.clear();
+    mixer.stop_all();
+    audio_playback.clear_queued_samples();
+}
+
+
+void Program::toggle_monitoring() {
+    if (monitor) {
+        Logger::info("Stopped input monitoring ({} dropouts)", monitor->get_n_dropouts());
+        monitor.reset();
+        return;
+    }
+
+    try {
+        monitor = std::make_unique<AudioMonitor>(sample_config, MONITOR_FRAMES_PER_BUFFER);
+        monitor->start();
+        last_latency_test_state = LatencyTestState::idle;
+        Logger::info("Started input monitoring");
+    }
+    catch (const std::exception& e) {
+        monitor.reset();
+        Logger::error("Failed to start input monitoring");
+        Logger::exception(e);
+    }
+}
+
+
+void Program::start_latency_test() {
+    if (!monitor) {
+        Logger::warning("Start input monitoring before measuring its latency");
+        return;
+    }
+
+    Logger::info("Measuring round-trip latency; loop the output back to the input");
+    monitor->start_latency_test();
+}
+
+
+void Program::write_trace() {
+    if constexpr (!Profiler::ENABLED)
+        return;
+
+    try {
+        Profiler::write_trace(TRACE_PATH);
+    }
+    catch (const std::exception& e) {
+        Logger::error("Failed to write profiler trace");
+        Logger::exception(e);
+    }
 }
@@ -1,36 +1,186 @@
 #pragma once
 
 #include "window.hpp"
+#include "triple_buffer.hpp"
+#include "thread_pool.hpp"
+#include "audio/mixer.hpp"
+#include "audio/monitor.hpp"
 #include "audio/audio_device.hpp"
 #include "audio/sample_config.hpp"
+#include "audio/audio_asset_cache.hpp"
+#include "audio/audio_file_loader/wav_stream.hpp"
+#include "profiling/frame_pacer.hpp"
 #include "profiling/frame_performance.hpp"
+#include "profiling/timer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <vector>
+
+
+// state published by the simulation for rendering
+struct SimulationSnapshot {
+    WindowData window_data;
+    // time of the simulation tick which produced the snapshot
+    Timer::TimePoint time;
+};
+
+
+// SDL event pushed at the start of a frame
+struct ScriptedEvent {
+    uint64_t frame;
+    SDL_Event event;
+    // for SDL_DROPFILE; a copy is put in `event.drop.file` when pushed, as the handler frees it
+    std::string dropped_file;
+};
+
+
+// set-up of a Program; the defaults are those of the application, others are used by e.g. benchmarks
+struct ProgramOptions {
+    // `<= 0.0` is uncapped
+    double fps_limit = 60.0;
+    // main_loop() returns after this many frames; 0 runs until quit
+    uint64_t max_frames = 0;
+    // hidden window with a software renderer, e.g. for SDL's dummy video driver
+    bool headless = false;
+    // must be sorted by frame
+    std::vector<ScriptedEvent> event_script;
+    // reuse converted audio files from earlier runs; benchmarks disable this to measure the loaders
+    bool audio_disk_cache = true;
+    // with retained rendering, frames without changes aren't drawn and the main loop waits for events instead; benchmarks draw every frame
+    RenderMode render_mode = RenderMode::retained;
+    // the CPU backend draws on the thread pool; combined with `headless`, frames are only rendered to memory
+    RenderBackend render_backend = RenderBackend::automatic;
+};
 
 
 class Program {
     public:
-        Program();
+        Program(const ProgramOptions& _options = {});
 
         void main_loop();
 
+        uint64_t get_n_frames() const;
+        const FramePerformance& get_frame_performance() const;
+
 
         /* config */
-        // sleep will wake up later than the given time
-        // so sleep less and wait the rest out with a spinlock
-        static constexpr double SLEEP_REDUCTION = 10.0;  // milliseconds
+        static constexpr PacingMode PACING_MODE = PacingMode::hybrid;
+
+        /* run update_state() on its own thread at a fixed rate, independent of rendering
+         * the render loop (together with event handling, as SDL requires) draws interpolated snapshots of the simulation
+         * rendering lags one tick behind, so it can interpolate between the two latest snapshots
+         * off, as the simulation has no moving state to interpolate yet (see interpolate()); then the lag is only added latency
+         */
+        static constexpr bool THREADED_SIMULATION = false;
+        static constexpr double SIMULATION_RATE = 120.0;  // ticks per second
+        // when the simulation is further behind, ticks are skipped instead of caught up
+        static constexpr int MAX_SIMULATION_LAG = 5;  // ticks
+
+        // how often the performance HUD's memory usage is updated
+        static constexpr double WORKING_SET_INTERVAL = 500.0;  // milliseconds
+        // how often the fps counter's values are updated; with retained rendering, frames in between can be skipped
+        static constexpr double FPS_UPDATE_INTERVAL = 250.0;  // milliseconds
+        // longest wait for events when retained rendering has nothing to draw, so quit signals are still noticed
+        static constexpr double MAX_IDLE_WAIT = 100.0;  // milliseconds
+
+        // written on exit and when pressing 'p' if compiled with `ENABLE_PROFILING`
+        static constexpr const char* TRACE_PATH = "trace.json";
+
+        /* dropped WAV files at least this long (e.g. music) are streamed, replacing the previous stream
+         * shorter ones (e.g. sound effects) and other files are loaded in the background and played as a mixer voice on top of whatever is playing
+         *   WAV files are converted in parallel chunks on the thread pool, others on a single worker
+         */
+        static constexpr double STREAM_MIN_LENGTH = 30.0;  // seconds
+        // amount of audio kept queued while streaming a dropped file
+        static constexpr double STREAM_LATENCY = 100.0;  // milliseconds
+        // loaded files are kept in memory up to this size, so dropping them again plays them right away
+        static constexpr size_t AUDIO_CACHE_BUDGET = 512 << 20;  // bytes
+        // converted files are stored here, relative to RscDir::get_cache_dir()
+        static constexpr const char* AUDIO_DISK_CACHE_DIR = "audio";
+
+        // the audio callback pulls from a lock-free ring buffer, so playback doesn't depend on SDL's audio lock
+        static constexpr AudioMode AUDIO_MODE = AudioMode::callback;
+        static constexpr int AUDIO_FRAMES_PER_BUFFER = 256;
+        // input monitoring uses its own devices with smaller buffers, as its latency is heard directly
+        static constexpr int MONITOR_FRAMES_PER_BUFFER = 128;
 
 
     private:
+        const ProgramOptions options;
+        uint64_t frame_count;
+        // index in `options.event_script` of the next event to push
+        size_t next_scripted_event;
+
+        ThreadPool thread_pool;
+        AudioAssetCache audio_cache;
+
         Window main_window;
         WindowData main_window_data;
 
-        double fps_limit;
+        FramePacer frame_pacer;
         FramePerformance frame_perf;
+        // stage times of the current frame
+        FrameRecord frame_record;
+        bool show_hud;
+        size_t working_set;
+        Timer::TimePoint last_working_set_update;
+        // versions of the render loop's GUI elements (see WindowData)
+        uint64_t fps_counter_version;
+        uint64_t performance_hud_version;
+        double shown_fps;
+        double shown_unlocked_fps;
+        Timer::TimePoint last_fps_update;
 
         SampleConfig sample_config;
+        // declared before `audio_playback`, so it outlives the audio callback pulling from it
+        Mixer mixer;
         AudioPlayback audio_playback;
+        // dropped file currently being streamed; empty if none
+        std::unique_ptr<AudioFileLoader::WavStream> wav_stream;
+        // dropped files currently being loaded in the background
+        std::vector<std::shared_ptr<const AudioAsset>> pending_loads;
+        // live input monitoring; empty if not monitoring
+        std::unique_ptr<AudioMonitor> monitor;
+        LatencyTestState last_latency_test_state;
+
+        // only used with `THREADED_SIMULATION`
+        TripleBuffer<SimulationSnapshot> snapshots;
+        std::mutex simulation_queue_mutex;
+        // input forwarded from the main thread, run at the start of the next tick
+        std::vector<std::function<void()>> simulation_queue;
 
 
         /* private functions */
+        void main_loop_threaded();
+        bool is_finished() const;
+        void push_scripted_events();
+        // waits out the rest of the frame and presents it if `present`
+        void finish_frame(Timer::TimePoint& frame_start, const bool present);
+        // true if nothing but events can change the next frame, so the main loop can wait for them
+        bool can_idle() const;
+        // blocks until there is an event, the fps counter is due for an update, or `MAX_IDLE_WAIT` passed
+        void wait_for_events();
+        // sets the parts of `window_data` owned by the render loop (fps counter, performance HUD)
+        void set_render_data(WindowData& window_data);
+        void simulation_loop(std::stop_token stop_token);
+        // runs `task` right away, or on the simulation thread with `THREADED_SIMULATION`
+        void run_on_simulation(std::function<void()> task);
+        void run_simulation_queue();
+
         void handle_sdl_events();
         void update_state();
+
+        void play_dropped_file(const std::string& path);
+        void stop_playback();
+        void toggle_monitoring();
+        void start_latency_test();
+
+        // does nothing if the profiler isn't compiled in
+        void write_trace();
 };
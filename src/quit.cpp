@@ -2,56 +2,68 @@
 
 #include "logger.hpp"
 
+#include <atomic>
 #include <csignal>  // signal()
-#include <cstdlib>  // exit()
-#include <string>
-#include <map>
+#include <cstdlib>  // _Exit()
 
 
 namespace Quit {
 
-// use this mapping instead of sigabbrev_np(), as the latter is not available on Windows
-const std::map<const int, const std::string> signum_to_name = {
-    {SIGINT, "SIGINT"},
-    {SIGTERM, "SIGTERM"},
-};
+static_assert(std::atomic<bool>::is_always_lock_free && std::atomic<int>::is_always_lock_free, "Quit requires lock-free atomics to be set from signal handlers");
 
 
-static volatile bool quit = false;
+static std::atomic<bool> quit = false;
+// last terminating signal which wasn't reported yet; 0 if none
+static std::atomic<int> received_signal = 0;
+
+
+// use this instead of sigabbrev_np(), as the latter is not available on Windows
+static const char* get_signal_name(const int signum) {
+    switch (signum) {
+        case SIGINT:
+            return "SIGINT";
+        case SIGTERM:
+            return "SIGTERM";
+        default:
+            return nullptr;
+    }
+}
 
 
 bool poll_quit() {
-    return quit;
+    // signals are reported here, as the signal handler can't log
+    const int signum = received_signal.exchange(0, std::memory_order_relaxed);
+    if (signum != 0) {
+        if (const char* const name = get_signal_name(signum))
+            Logger::info("Signal '{}' received", name);
+        else
+            Logger::info("Signal number '{}' received", signum);
+        Logger::info("Quitting application on next cycle...");
+        Logger::hint("Sending another terminating signal will force quit");
+    }
+
+    return quit.load(std::memory_order_relaxed);
 }
 
 
 void set_quit() {
     Logger::info("Quitting application on next cycle...");
-    quit = true;
+    quit.store(true, std::memory_order_relaxed);
 }
 
 
 void reset_quit() {
-    quit = false;
+    quit.store(false, std::memory_order_relaxed);
 }
 
 
+// only touches lock-free atomics; logging, and exit() with its atexit handlers, aren't async-signal-safe
 void quit_signal_handler(const int signum) {
-    if (quit) {
-        if (signum_to_name.contains(signum))
-            Logger::info("Received signal '" + std::string(signum_to_name.at(signum)) + "' while quitting; will now force quit");
-        else
-            Logger::info("Received signal number '" + std::to_string(signum) + "' while quitting; will now force quit");
-        std::exit(-2);
-    }
-
-    if (signum_to_name.contains(signum))
-        Logger::info("Signal '" + std::string(signum_to_name.at(signum)) + "' received");
-    else
-        Logger::info("Signal number '" + std::to_string(signum) + "' received");
+    // force quit without cleaning up; queued log messages are lost
+    if (quit.exchange(true, std::memory_order_relaxed))
+        std::_Exit(-2);
 
-    set_quit();
-    Logger::hint("Sending another terminating signal will force quit");
+    received_signal.store(signum, std::memory_order_relaxed);
 }
 
 
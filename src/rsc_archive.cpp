@@ -0,0 +1,260 @@
+#include "rsc_archive.hpp"
+
+#include "exception.hpp"
+#include "mapped_file.hpp"
+#include "lz4.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>  // sort(), min()
+#include <climits>  // INT_MAX
+#include <cstddef>
+#include <cstdint>
+#include <cstring>  // memcmp(), memcpy()
+#include <filesystem>
+#include <fstream>
+#include <iterator>  // istreambuf_iterator
+#include <memory>  // make_unique()
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+
+namespace fs = std::filesystem;
+
+
+// archives are little-endian; read and write byte by byte to be independent of host endianness
+static uint64_t read_le(const uint8_t* const bytes, const int n_bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < n_bytes; i++)
+        value |= (uint64_t)bytes[i] << (8 * i);
+    return value;
+}
+
+
+static void write_le(std::vector<uint8_t>& out, const uint64_t value, const int n_bytes) {
+    for (int i = 0; i < n_bytes; i++)
+        out.push_back((value >> (8 * i)) & 0xff);
+}
+
+
+RscArchive::RscArchive(const fs::path& path)
+    : file(path)
+{
+    const uint8_t* const data = file.data();
+    if (file.size() < HEADER_SIZE || std::memcmp(data, MAGIC.data(), MAGIC.size()) != 0)
+        throw Exception("'" + path.string() + "' is not a resource archive");
+
+    const uint32_t version = read_le(data + 8, 4);
+    if (version != VERSION)
+        throw Exception("Resource archive has version " + std::to_string(version) + " instead of " + std::to_string(VERSION));
+
+    const uint32_t n_entries = read_le(data + 12, 4);
+    const uint64_t index_offset = read_le(data + 16, 8);
+    const uint64_t index_size = read_le(data + 24, 8);
+    if (index_offset > file.size() || index_size > file.size() - index_offset)
+        throw Exception("Resource archive index extends past end of file");
+
+    // the hash is padded with zero bytes
+    const char* const hash = reinterpret_cast<const char*>(data + 32);
+    verification_hash.assign(hash, std::find(hash, hash + HASH_SIZE, '\0'));
+
+    const uint8_t* pos = data + index_offset;
+    const uint8_t* const index_end = pos + index_size;
+    for (uint32_t i = 0; i < n_entries; i++) {
+        if (index_end - pos < 4)
+            throw Exception("Resource archive index is truncated");
+        const uint32_t name_size = read_le(pos, 4);
+        pos += 4;
+
+        // name, compression, offset, stored size and size; widened, as the sum overflows 32 bits for corrupt name sizes
+        if ((uint64_t)(index_end - pos) < (uint64_t)name_size + 4 + 3 * 8)
+            throw Exception("Resource archive index is truncated");
+        std::string name(reinterpret_cast<const char*>(pos), name_size);
+        pos += name_size;
+
+        const Entry entry = {
+            .compression = static_cast<Compression>(read_le(pos, 4)),
+            .offset = read_le(pos + 4, 8),
+            .stored_size = read_le(pos + 12, 8),
+            .size = read_le(pos + 20, 8),
+        };
+        pos += 4 + 3 * 8;
+
+        if (entry.compression != Compression::none && entry.compression != Compression::lz4)
+            throw Exception("Resource archive entry '" + name + "' has unknown compression");
+        if (entry.offset > index_offset || entry.stored_size > index_offset - entry.offset)
+            throw Exception("Resource archive entry '" + name + "' extends past the entry data");
+        if (entry.compression == Compression::none && entry.stored_size != entry.size)
+            throw Exception("Size of uncompressed resource archive entry '" + name + "' doesn't match");
+        // rather than allocating whatever a corrupt size asks for on first access; `stored_size` is bounded by the file size, so this can't overflow
+        if (entry.compression == Compression::lz4 && entry.size > Lz4::decompress_bound(entry.stored_size))
+            throw Exception("Size of compressed resource archive entry '" + name + "' is larger than its data can decompress to");
+
+        entries.emplace(std::move(name), entry);
+    }
+}
+
+
+const std::string& RscArchive::get_verification_hash() const {
+    return verification_hash;
+}
+
+
+bool RscArchive::contains(const std::string& name) const {
+    return entries.contains(name);
+}
+
+
+std::vector<std::string> RscArchive::get_names() const {
+    std::vector<std::string> names;
+    for (const auto& [name, entry] : entries)
+        names.push_back(name);
+    std::sort(names.begin(), names.end());
+    return names;
+}
+
+
+std::span<const uint8_t> RscArchive::get(const std::string& name) {
+    const auto it = entries.find(name);
+    if (it == entries.end())
+        throw Exception("Resource archive has no entry '" + name + "'");
+
+    const Entry& entry = it->second;
+    const std::span<const uint8_t> stored(file.data() + entry.offset, entry.stored_size);
+    if (entry.compression == Compression::none)
+        return stored;
+
+    std::lock_guard<std::mutex> lock(decompressed_mutex);
+    std::unique_ptr<std::vector<uint8_t>>& contents = decompressed[name];
+    if (!contents) {
+        auto buffer = std::make_unique<std::vector<uint8_t>>(entry.size);
+        try {
+            Lz4::decompress(stored, *buffer);
+        }
+        catch (const std::exception& e) {
+            decompressed.erase(name);
+            throw Exception("Resource archive entry '" + name + "' is corrupt\n" + e.what());
+        }
+        contents = std::move(buffer);
+    }
+
+    return *contents;
+}
+
+
+// SDL_RWFromConstMem() rejects a size of 0, so empty entries get a stream of their own
+static SDL_RWops* open_empty_rw() {
+    SDL_RWops* const rw = SDL_AllocRW();
+    if (rw == NULL)
+        return NULL;
+
+    rw->size = [](SDL_RWops*) -> Sint64 { return 0; };
+    // every whence is relative to position 0
+    rw->seek = [](SDL_RWops*, const Sint64 offset, int) -> Sint64 {
+        if (offset != 0)
+            return SDL_SetError("Can't seek past the end of an empty stream");
+        return 0;
+    };
+    rw->read = [](SDL_RWops*, void*, size_t, size_t) -> size_t { return 0; };
+    rw->write = [](SDL_RWops*, const void*, size_t, size_t) -> size_t {
+        SDL_SetError("Can't write to a read-only stream");
+        return 0;
+    };
+    rw->close = [](SDL_RWops* const self) -> int {
+        SDL_FreeRW(self);
+        return 0;
+    };
+    rw->type = SDL_RWOPS_MEMORY_RO;
+    return rw;
+}
+
+
+SDL_RWops* RscArchive::open_rw(const std::string& name) {
+    const std::span<const uint8_t> contents = get(name);
+    if (contents.size() > INT_MAX)
+        throw Exception("Resource archive entry '" + name + "' is too large for an SDL stream");
+
+    SDL_RWops* const rw = (contents.empty() ? open_empty_rw() : SDL_RWFromConstMem(contents.data(), contents.size()));
+    if (rw == NULL)
+        throw Exception("Failed to open stream on resource archive entry '" + name + "'\nSDL error: " + std::string(SDL_GetError()));
+    return rw;
+}
+
+
+/*static*/ void RscArchive::pack(const fs::path& dir, const fs::path& archive_path, const bool compress) {
+    std::string hash;
+    {
+        std::ifstream verification_file(dir / "verify");
+        if (!verification_file.is_open())
+            throw Exception("Failed to open resource directory verification file");
+        verification_file >> hash;
+        if (hash.size() > HASH_SIZE)
+            throw Exception("Resource verification hash is longer than " + std::to_string(HASH_SIZE) + " bytes");
+    }
+
+    // sorted, so packing the same directory gives the same archive
+    std::vector<fs::path> paths;
+    for (const fs::directory_entry& dir_entry : fs::recursive_directory_iterator(dir))
+        if (dir_entry.is_regular_file() && dir_entry.path() != dir / "verify")
+            paths.push_back(dir_entry.path());
+    std::sort(paths.begin(), paths.end());
+
+    std::ofstream out(archive_path, std::ios::binary);
+    if (!out.is_open())
+        throw Exception("Failed to open '" + archive_path.string() + "' for writing");
+
+    // the header is written last, once the index location is known
+    uint64_t offset = HEADER_SIZE;
+    out.write(std::vector<char>(HEADER_SIZE, 0).data(), HEADER_SIZE);
+
+    std::vector<uint8_t> index;
+    for (const fs::path& path : paths) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open())
+            throw Exception("Failed to open '" + path.string() + "' for packing");
+        const std::vector<uint8_t> contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        Compression compression = Compression::none;
+        std::vector<uint8_t> compressed;
+        if (compress && !contents.empty()) {
+            compressed = Lz4::compress(contents);
+            if (compressed.size() <= contents.size() * (1.0 - MIN_COMPRESSION_GAIN))
+                compression = Compression::lz4;
+        }
+        const std::vector<uint8_t>& stored = (compression == Compression::lz4 ? compressed : contents);
+
+        const uint64_t padding = (ENTRY_ALIGNMENT - offset % ENTRY_ALIGNMENT) % ENTRY_ALIGNMENT;
+        out.write(std::vector<char>(padding, 0).data(), padding);
+        offset += padding;
+        out.write(reinterpret_cast<const char*>(stored.data()), stored.size());
+
+        const std::string name = path.lexically_relative(dir).generic_string();
+        write_le(index, name.size(), 4);
+        index.insert(index.end(), name.begin(), name.end());
+        write_le(index, static_cast<uint32_t>(compression), 4);
+        write_le(index, offset, 8);
+        write_le(index, stored.size(), 8);
+        write_le(index, contents.size(), 8);
+
+        offset += stored.size();
+    }
+
+    out.write(reinterpret_cast<const char*>(index.data()), index.size());
+
+    std::vector<uint8_t> header(MAGIC.begin(), MAGIC.end());
+    write_le(header, VERSION, 4);
+    write_le(header, paths.size(), 4);
+    write_le(header, offset, 8);
+    write_le(header, index.size(), 8);
+    header.insert(header.end(), hash.begin(), hash.end());
+    header.resize(HEADER_SIZE, 0);
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(header.data()), header.size());
+
+    // the last buffered bytes are only written when closing, which fails e.g. on a full disk
+    out.close();
+    if (!out)
+        throw Exception("Failed to write resource archive '" + archive_path.string() + "'");
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "mapped_file.hpp"
+
+#include <SDL2/SDL.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+/* read-only archive of resource files, packed into a single file which is memory mapped
+ * layout (all integers little-endian):
+ *   header of `HEADER_SIZE` bytes: magic, format version, number of entries, offset and size of the index, and the resource verification hash
+ *   entry data, every entry starting at a multiple of `ENTRY_ALIGNMENT` bytes
+ *   index: per entry its name (path relative to the packed directory, with '/' separators), compression, offset, stored size and size
+ * stored entries are served straight from the mapping; LZ4 compressed entries are decompressed on first access and kept in memory
+ * all member functions are thread safe
+ */
+class RscArchive {
+    public:
+        enum class Compression : uint32_t {
+            none = 0,
+            lz4 = 1
+        };
+
+        // throws exception if the file can't be mapped or isn't a valid archive
+        RscArchive(const std::filesystem::path& path);
+
+        RscArchive(const RscArchive&) = delete;
+        RscArchive& operator=(const RscArchive&) = delete;
+
+        const std::string& get_verification_hash() const;
+
+        bool contains(const std::string& name) const;
+        std::vector<std::string> get_names() const;
+
+        // contents of an entry; valid as long as the archive
+        // throws exception if there is no such entry or it is corrupt
+        std::span<const uint8_t> get(const std::string& name);
+        // read-only SDL stream on the contents of an entry, without copying them (e.g. for TTF_OpenFontRW() or SDL_LoadBMP_RW())
+        // must be closed before the archive is destroyed; throws exception on failure
+        SDL_RWops* open_rw(const std::string& name);
+
+        /* packs all files in `dir` into an archive at `archive_path`
+         * the first line of `dir`'s verification file (`verify`) becomes the header's hash; the file itself isn't packed
+         * with `compress`, entries are LZ4 compressed if that saves at least `MIN_COMPRESSION_GAIN` of their size
+         * throws exception on failure
+         */
+        static void pack(const std::filesystem::path& dir, const std::filesystem::path& archive_path, const bool compress);
+
+
+        /* config */
+        static constexpr std::string_view MAGIC = {"RSCPACK\0", 8};
+        static constexpr uint32_t VERSION = 1;
+        static constexpr size_t HEADER_SIZE = 64;  // bytes
+        static constexpr size_t HASH_SIZE = 32;  // bytes
+        // page cache friendly and enough for any SIMD loads from mapped entries
+        static constexpr size_t ENTRY_ALIGNMENT = 64;  // bytes
+        static constexpr double MIN_COMPRESSION_GAIN = 0.125;
+
+
+    private:
+        struct Entry {
+            Compression compression;
+            uint64_t offset;
+            uint64_t stored_size;
+            uint64_t size;
+        };
+
+        MappedFile file;
+        std::string verification_hash;
+        std::unordered_map<std::string, Entry> entries;
+
+        std::mutex decompressed_mutex;
+        // decompressed contents of LZ4 compressed entries; never moved once inserted, as spans to them are handed out
+        std::unordered_map<std::string, std::unique_ptr<std::vector<uint8_t>>> decompressed;
+};
@@ -1,10 +1,15 @@
 #include "rsc_dir.hpp"
 
 #include "exception.hpp"
+#include "rsc_archive.hpp"
+
+#include <SDL2/SDL.h>
 
 #include <string>
 #include <filesystem>
 #include <fstream>
+#include <memory>  // make_unique()
+#include <utility>  // move()
 
 
 namespace fs = std::filesystem;
@@ -12,11 +17,14 @@ namespace fs = std::filesystem;
 
 bool RscDir::valid = false;
 fs::path RscDir::rsc_path = fs::path();
+std::unique_ptr<RscArchive> RscDir::archive = nullptr;
 
 
 /*static*/ const fs::path& RscDir::get() {
     if (!RscDir::valid)
         throw Exception("Resource directory path is not yet set");
+    if (RscDir::archive)
+        throw Exception("Resources are packed in '" + RscDir::rsc_path.string() + "'; use RscDir::open_rw()");
 
     return RscDir::rsc_path;
 }
@@ -25,8 +33,9 @@ fs::path RscDir::rsc_path = fs::path();
 /*static*/ void RscDir::set(fs::path new_path) {
     if (!fs::exists(new_path))
         throw Exception("Resource path '" + new_path.string() + "' does not exist");
-    if (!fs::is_directory(new_path))
-        throw Exception("Resource path '" + new_path.string() + "' is not a directory");
+    const bool packed = fs::is_regular_file(new_path);
+    if (!packed && !fs::is_directory(new_path))
+        throw Exception("Resource path '" + new_path.string() + "' is not a directory or archive");
 
     // clean the path string (for printing it to cli)
     new_path = new_path.lexically_normal();
@@ -41,19 +50,28 @@ fs::path RscDir::rsc_path = fs::path();
     }
 
     // verify we have the right rsc directory
-    if (!std::filesystem::exists(new_path / "verify"))
-        throw Exception("Resource directory verification file does not exist");
-
-    std::ifstream verification_file(new_path / "verify");
-    if (!verification_file.is_open())
-        throw Exception("Failed to open resource directory verification file");
-
-    std::string line;
-    verification_file >> line;
-    if (line != hash_in_file)
-        throw Exception("Resource directory verification file has wrong content");
+    std::unique_ptr<RscArchive> new_archive;
+    if (packed) {
+        new_archive = std::make_unique<RscArchive>(new_path);
+        if (new_archive->get_verification_hash() != hash_in_file)
+            throw Exception("Resource archive has wrong verification hash");
+    }
+    else {
+        if (!std::filesystem::exists(new_path / "verify"))
+            throw Exception("Resource directory verification file does not exist");
+
+        std::ifstream verification_file(new_path / "verify");
+        if (!verification_file.is_open())
+            throw Exception("Failed to open resource directory verification file");
+
+        std::string line;
+        verification_file >> line;
+        if (line != hash_in_file)
+            throw Exception("Resource directory verification file has wrong content");
+    }
 
     RscDir::rsc_path = new_path;
+    RscDir::archive = std::move(new_archive);
     RscDir::valid = true;
 }
 
@@ -61,3 +79,31 @@ fs::path RscDir::rsc_path = fs::path();
 /*static*/ bool RscDir::is_valid() noexcept {
     return RscDir::valid;
 }
+
+
+/*static*/ bool RscDir::is_packed() noexcept {
+    return RscDir::archive != nullptr;
+}
+
+
+/*static*/ SDL_RWops* RscDir::open_rw(const std::string& name) {
+    if (!RscDir::valid)
+        throw Exception("Resource directory path is not yet set");
+
+    if (RscDir::archive)
+        return RscDir::archive->open_rw(name);
+
+    const fs::path path = RscDir::rsc_path / name;
+    SDL_RWops* const rw = SDL_RWFromFile(path.string().c_str(), "rb");
+    if (rw == NULL)
+        throw Exception("Failed to open resource '" + path.string() + "'\nSDL error: " + std::string(SDL_GetError()));
+    return rw;
+}
+
+
+/*static*/ fs::path RscDir::get_cache_dir() {
+    if (!RscDir::valid)
+        throw Exception("Resource directory path is not yet set");
+
+    return (RscDir::archive ? RscDir::rsc_path.parent_path() : RscDir::rsc_path) / "cache";
+}
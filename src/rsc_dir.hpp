@@ -1,31 +1,56 @@
 #pragma once
 
+#include "rsc_archive.hpp"
+
+#include <SDL2/SDL.h>
+
 #include <filesystem>
+#include <memory>
+#include <string>
 #include <string_view>
 
 
+/* location of the resources: either a directory of loose files or a packed archive (see RscArchive)
+ * open_rw() works for both; get() only for directories
+ */
 class RscDir {
     public:
         // static only class, so disallow construction
         RscDir() = delete;
 
-        // throws exception if not yet set to a valid path
+        // throws exception if not yet set to a valid path or if the resources are packed
         // don't forget to call `.string()` on the final path for Windows compatibility
         static const std::filesystem::path& get();
 
         // throws an exception if new path is not valid
+        // a regular file is mounted as a resource archive; its header must contain `hash_in_file`
+        // streams opened on a previously mounted archive must be closed first
         // strong exception guarantee
         static void set(std::filesystem::path new_path);
 
         static bool is_valid() noexcept;
+        static bool is_packed() noexcept;
+
+        /* read-only SDL stream on resource `name` (relative path with '/' separators), e.g. for TTF_OpenFontRW()
+         * packed resources are served from the archive without copying
+         * thread safe once set; throws exception on failure
+         */
+        static SDL_RWops* open_rw(const std::string& name);
+
+        // writable directory for generated files, such as converted audio: `cache` in the resource directory or next to the archive
+        static std::filesystem::path get_cache_dir();
 
 
         /* config */
         static constexpr bool make_path_absolute = false;
         static constexpr std::string_view hash_in_file = "8ee8a8613fadc96701484b23c1d3764e";
+        // used instead of the resource directory if present; built by `make pack`
+        static constexpr const char* archive_file = "rsc.pack";
 
 
     private:
         static std::filesystem::path rsc_path;
         static bool valid;
+        // set if the resources are packed
+        static std::unique_ptr<RscArchive> archive;
 };
@@ -0,0 +1,74 @@
+#include "thread_pool.hpp"
+
+#include "logger.hpp"
+
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>  // move()
+#include <algorithm>  // max()
+
+
+ThreadPool::ThreadPool(const int n_threads)
+    : stop(false)
+{
+    int n_workers = n_threads;
+    if (n_workers <= 0)
+        n_workers = std::max(1u, std::thread::hardware_concurrency());
+
+    workers.reserve(n_workers);
+    for (int i = 0; i < n_workers; i++)
+        workers.emplace_back(&ThreadPool::worker_loop, this);
+}
+
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stop = true;
+        queue.clear();
+    }
+    queue_cv.notify_all();
+
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.push_back(std::move(task));
+    }
+    queue_cv.notify_one();
+}
+
+
+int ThreadPool::get_n_threads() const {
+    return workers.size();
+}
+
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]() { return stop || !queue.empty(); });
+            if (stop)
+                return;
+
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        // tasks should handle their own errors; don't let one take down the worker
+        try {
+            task();
+        }
+        catch (const std::exception& e) {
+            Logger::error("Uncaught exception in thread pool task");
+            Logger::exception(e);
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+/* fixed size pool of worker threads executing tasks in submission order
+ * tasks may submit new tasks, but should not block on the result of other tasks
+ * on destruction, running tasks are finished and queued tasks are discarded
+ */
+class ThreadPool {
+    public:
+        // `n_threads <= 0` uses one thread per hardware thread
+        ThreadPool(const int n_threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        void submit(std::function<void()> task);
+
+        // returns a future to the result of `task`; exceptions thrown by `task` are rethrown by `future::get()`
+        template <class Task>
+        std::future<std::invoke_result_t<Task>> submit_with_future(Task&& task) {
+            using Result = std::invoke_result_t<Task>;
+            // std::function requires a copyable callable, so share the packaged task
+            auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+            std::future<Result> future = packaged->get_future();
+            submit([packaged]() { (*packaged)(); });
+            return future;
+        }
+
+        int get_n_threads() const;
+
+
+    private:
+        std::vector<std::thread> workers;
+
+        std::mutex queue_mutex;
+        std::condition_variable queue_cv;
+        std::deque<std::function<void()>> queue;
+        bool stop;
+
+
+        void worker_loop();
+};
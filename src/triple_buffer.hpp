@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+
+/* lock-free triple buffer passing the latest value from one writer thread to one reader thread
+ * the writer fills back() and publishes it; the reader picks up the most recently published value with update()
+ * neither side ever waits for the other; values published in between two update() calls are skipped
+ */
+template <class T>
+class TripleBuffer {
+    public:
+        TripleBuffer(const T& initial = T())
+            : slots{initial, initial, initial} {}
+
+        TripleBuffer(const TripleBuffer&) = delete;
+        TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+
+        /* writer side */
+        // not yet visible to the reader; may contain an older value
+        T& back() noexcept {
+            return slots[back_index];
+        }
+
+        // makes back() visible to the reader and swaps in a new back buffer
+        void publish() noexcept {
+            back_index = middle.exchange(back_index | NEW_DATA, std::memory_order_acq_rel) & INDEX_MASK;
+        }
+
+
+        /* reader side */
+        // returns true if a value was published since the last call
+        bool update() noexcept {
+            if ((middle.load(std::memory_order_relaxed) & NEW_DATA) == 0)
+                return false;
+
+            front_index = middle.exchange(front_index, std::memory_order_acq_rel) & INDEX_MASK;
+            return true;
+        }
+
+        const T& front() const noexcept {
+            return slots[front_index];
+        }
+
+
+    private:
+        static constexpr int CACHE_LINE = 64;
+        // the middle index is tagged with whether it holds data the reader hasn't seen yet
+        static constexpr int INDEX_MASK = 0b011;
+        static constexpr int NEW_DATA = 0b100;
+
+        std::array<T, 3> slots;
+
+        alignas(CACHE_LINE) int back_index = 0;
+        alignas(CACHE_LINE) std::atomic<int> middle = 1;
+        alignas(CACHE_LINE) int front_index = 2;
+};
@@ -1,9 +1,14 @@
 #include "window.hpp"
 
-#include "rsc_dir.hpp"
+#include "thread_pool.hpp"
 #include "exception.hpp"
 #include "logger.hpp"
+#include "graphics/cpu_rasterizer.hpp"
 #include "graphics/fps_counter.hpp"
+#include "graphics/glyph_atlas.hpp"
+#include "graphics/performance_hud.hpp"
+#include "graphics/render_queue.hpp"
+#include "graphics/resource_cache.hpp"
 
 #include <SDL2/SDL.h>
 
@@ -12,15 +17,29 @@
 #include <memory>  // make_unique()
 
 
+WindowData interpolate(const WindowData& /*previous*/, const WindowData& next, const double /*alpha*/) {
+    return next;
+}
+
+
 void Window::calculate_screen_coordinates(WindowData& /*window_data*/, const int /*res_w*/, const int /*res_h*/) const {
     //
 }
 
 
-Window::Window(const std::string& title, const int res_w, const int res_h, WindowData& window_data)
-    : resolution(res_w, res_h)
+Window::Window(const std::string& title, const int res_w, const int res_h, WindowData& window_data, ThreadPool& thread_pool, const RenderMode _render_mode, const RenderBackend _render_backend, const bool _headless)
+    : resolution(res_w, res_h),
+      render_mode(_render_mode),
+      render_backend(_render_backend),
+      headless(_headless),
+      canvas(NULL),
+      canvas_res(0, 0),
+      full_redraw(true),
+      frame_damage({.x = 0, .y = 0, .w = 0, .h = 0})
 {
     uint32_t sdl_window_flags = 0;
+    if (headless)
+        sdl_window_flags |= SDL_WINDOW_HIDDEN;
     // if (cli_args.fullscreen)
         // sdl_window_flags |= SDL_WINDOW_FULLSCREEN_DESKTOP;  // causes huge start-up time increase
     // sdl_window_flags |= SDL_WINDOW_UTILITY;
@@ -33,23 +52,36 @@ Window::Window(const std::string& title, const int res_w, const int res_h, Windo
     int w, h;
     SDL_GetWindowSize(sdl_window, &w, &h);
     if (resolution.w != w || resolution.h != h) {
-        Logger::info("Resolution changed compared to start-up resolution (" + std::to_string(res_w) + "x" + std::to_string(res_h) + " -> " + std::to_string(w) + "x" + std::to_string(h) + ")");
+        Logger::info("Resolution changed compared to start-up resolution ({}x{} -> {}x{})", res_w, res_h, w, h);
         resolution.w = w;
         resolution.h = h;
     }
 
-    renderer = SDL_CreateRenderer(sdl_window, -1, SDL_RENDERER_ACCELERATED/* | SDL_RENDERER_PRESENTVSYNC*/);
+    // the CPU backend only uploads to a streaming texture
+    const uint32_t target_flag = (render_mode == RenderMode::retained && render_backend != RenderBackend::cpu ? SDL_RENDERER_TARGETTEXTURE : 0);
+    renderer = SDL_CreateRenderer(sdl_window, -1, (headless ? SDL_RENDERER_SOFTWARE : SDL_RENDERER_ACCELERATED/* | SDL_RENDERER_PRESENTVSYNC*/) | target_flag);
+    if (renderer == NULL && !headless) {
+        Logger::warning("Failed to create accelerated renderer; falling back to SDL's software renderer\nSDL error: {}", SDL_GetError());
+        renderer = SDL_CreateRenderer(sdl_window, -1, SDL_RENDERER_SOFTWARE | target_flag);
+    }
     if (renderer == NULL) {
         SDL_DestroyWindow(sdl_window);
         throw Exception("Failed to create renderer for window\nSDL error: " + std::string(SDL_GetError()));
     }
     SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_BLEND);
 
-    default_font = TTF_OpenFont((RscDir::get() / "font" / "DejaVuSans.ttf").string().c_str(), DEFAULT_FONT_PT);
-    if (default_font == NULL) {
-        SDL_DestroyRenderer(renderer);
-        SDL_DestroyWindow(sdl_window);
-        throw Exception("Failed to load font 'rsc/font/DejaVuSans.ttf'\nTTF error: " + std::string(TTF_GetError()));
+    // SDL's software renderer is single threaded, so the CPU backend draws faster on machines without a GPU driver
+    if (render_backend == RenderBackend::automatic) {
+        SDL_RendererInfo info;
+        const bool software = (SDL_GetRendererInfo(renderer, &info) == 0 && (info.flags & SDL_RENDERER_SOFTWARE) != 0);
+        render_backend = (software && !headless ? RenderBackend::cpu : RenderBackend::sdl);
+        if (render_backend == RenderBackend::cpu)
+            Logger::info("SDL uses its software renderer; drawing with the CPU backend instead");
+    }
+
+    if (render_mode == RenderMode::retained && render_backend == RenderBackend::sdl && !SDL_RenderTargetSupported(renderer)) {
+        Logger::warning("Renderer doesn't support target textures; falling back to immediate rendering");
+        render_mode = RenderMode::immediate;
     }
 
     // render initial black frame
@@ -57,7 +89,24 @@ Window::Window(const std::string& title, const int res_w, const int res_h, Windo
     SDL_RenderClear(renderer);
     SDL_RenderPresent(renderer);
 
-    fps_counter = std::make_unique<FpsCounter>(renderer, default_font);
+    if (render_backend == RenderBackend::cpu)
+        rasterizer = std::make_unique<CpuRasterizer>(thread_pool, resolution.w, resolution.h);
+    render_queue = std::make_unique<RenderQueue>(renderer, rasterizer.get());
+    try {
+        resources = std::make_unique<ResourceCache>(renderer, thread_pool);
+        // the HUD elements hold on to the atlas, so it may not be evicted
+        text_atlas = &resources->get_glyph_atlas(DEFAULT_FONT, DEFAULT_FONT_PT, true);
+    }
+    catch (...) {
+        resources.reset();
+        SDL_DestroyRenderer(renderer);
+        SDL_DestroyWindow(sdl_window);
+        throw;
+    }
+    fps_counter = std::make_unique<FpsCounter>(*render_queue, *text_atlas);
+    performance_hud = std::make_unique<PerformanceHud>(*render_queue, *text_atlas);
+    if (rasterizer != nullptr)
+        add_cpu_textures();
 
     calculate_screen_coordinates(window_data, resolution.w, resolution.h);
 }
@@ -65,9 +114,13 @@ Window::Window(const std::string& title, const int res_w, const int res_h, Windo
 
 Window::~Window() {
     // force clean-up before renderer
+    if (canvas != NULL)
+        SDL_DestroyTexture(canvas);
+    performance_hud.reset();
     fps_counter.reset();
-
-    TTF_CloseFont(default_font);
+    resources.reset();
+    render_queue.reset();
+    rasterizer.reset();
 
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(sdl_window);
@@ -75,27 +128,216 @@ Window::~Window() {
 
 
 void Window::set_resolution(const int w, const int h, WindowData& window_data) {
-    resolution.w = w;
-    resolution.h = h;
+    set_resolution(w, h);
 
     calculate_screen_coordinates(window_data, resolution.w, resolution.h);
 }
 
 
+void Window::set_resolution(const int w, const int h) {
+    resolution.w = w;
+    resolution.h = h;
+}
+
+
 std::tuple<int, int> Window::get_resolution() const {
     return {resolution.w, resolution.h};
 }
 
 
 void Window::render_frame() {
+    // everything drawn since the last present belongs to this frame
+    presented_stats = render_queue->get_stats();
+    render_queue->reset_stats();
+
+    if (rasterizer != nullptr) {
+        // headless, the frame is only kept in memory
+        if (headless)
+            return;
+        upload_frame();
+    }
+
+    // the back buffer is undefined after presenting, so the whole canvas is copied every frame
+    if (canvas != NULL)
+        SDL_RenderCopy(renderer, canvas, NULL, NULL);
+
     SDL_RenderPresent(renderer);
 }
 
 
-void Window::prepare_frame(const WindowData& window_data) {
-    // black background
-    SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, SDL_ALPHA_OPAQUE);
-    SDL_RenderClear(renderer);
+bool Window::prepare_frame(const WindowData& window_data) {
+    resources->update();
+
+    // the CPU backend's frame has the window's size; resizing discards its contents
+    if (rasterizer != nullptr && (rasterizer->get_w() != resolution.w || rasterizer->get_h() != resolution.h)) {
+        rasterizer->resize(resolution.w, resolution.h);
+        full_redraw = true;
+    }
 
+    if (render_mode == RenderMode::retained)
+        return prepare_retained_frame(window_data);
+
+    begin_drawing({.x = 0, .y = 0, .w = resolution.w, .h = resolution.h});
     fps_counter->render(window_data.fps_data, resolution);
+    performance_hud->render(window_data.hud_data, resolution);
+    end_drawing();
+    return true;
+}
+
+
+void Window::invalidate() {
+    full_redraw = true;
+}
+
+
+RenderMode Window::get_render_mode() const {
+    return render_mode;
+}
+
+
+RenderBackend Window::get_render_backend() const {
+    return render_backend;
+}
+
+
+const uint32_t* Window::get_frame_pixels() const {
+    return (rasterizer != nullptr ? rasterizer->get_pixels() : nullptr);
+}
+
+
+const RenderStats& Window::get_render_stats() const {
+    return presented_stats;
+}
+
+
+void Window::create_canvas(const int w, const int h) {
+    if (canvas != NULL)
+        SDL_DestroyTexture(canvas);
+
+    const int access = (rasterizer != nullptr ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_TARGET);
+    canvas = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, access, w, h);
+    if (canvas == NULL)
+        throw Exception("Failed to create canvas texture\nSDL error: " + std::string(SDL_GetError()));
+    // the canvas is opaque, so copying it doesn't need blending
+    SDL_SetTextureBlendMode(canvas, SDL_BLENDMODE_NONE);
+    canvas_res = Resolution(w, h);
+
+    // a new target has to be drawn, a new streaming texture only has to be uploaded
+    if (rasterizer == nullptr)
+        full_redraw = true;
+    frame_damage = {.x = 0, .y = 0, .w = w, .h = h};
+}
+
+
+bool Window::prepare_retained_frame(const WindowData& window_data) {
+    if (rasterizer == nullptr && (canvas == NULL || canvas_res.w != resolution.w || canvas_res.h != resolution.h))
+        create_canvas(resolution.w, resolution.h);
+
+    const SDL_Rect fps_counter_bounds = fps_counter->get_bounds(window_data.fps_data, resolution),
+                   performance_hud_bounds = performance_hud->get_bounds(window_data.hud_data, resolution);
+
+    SDL_Rect damage = {.x = 0, .y = 0, .w = 0, .h = 0};
+    add_damage(damage, drawn_fps_counter, window_data.fps_data.version, fps_counter_bounds);
+    add_damage(damage, drawn_performance_hud, window_data.hud_data.version, performance_hud_bounds);
+    if (full_redraw)
+        damage = {.x = 0, .y = 0, .w = resolution.w, .h = resolution.h};
+    full_redraw = false;
+
+    if (SDL_RectEmpty(&damage))
+        return false;
+
+    // clear the damaged region and redraw what overlaps it; drawing outside it is clipped
+    begin_drawing(damage);
+    if (SDL_HasIntersection(&fps_counter_bounds, &damage))
+        fps_counter->render(window_data.fps_data, resolution);
+    if (SDL_HasIntersection(&performance_hud_bounds, &damage))
+        performance_hud->render(window_data.hud_data, resolution);
+    end_drawing();
+    return true;
+}
+
+
+void Window::begin_drawing(const SDL_Rect& region) {
+    if (rasterizer != nullptr) {
+        rasterizer->set_clip_rect(&region);
+        rasterizer->clear({.r = 0x00, .g = 0x00, .b = 0x00, .a = SDL_ALPHA_OPAQUE});
+        SDL_UnionRect(&frame_damage, &region, &frame_damage);
+        return;
+    }
+
+    SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, SDL_ALPHA_OPAQUE);
+    if (render_mode == RenderMode::immediate) {
+        SDL_RenderClear(renderer);
+        return;
+    }
+
+    SDL_SetRenderTarget(renderer, canvas);
+    SDL_RenderSetClipRect(renderer, &region);
+    SDL_RenderFillRect(renderer, &region);
+}
+
+
+void Window::end_drawing() {
+    // while the canvas and clip rectangle are still set
+    render_queue->flush();
+
+    if (rasterizer != nullptr)
+        rasterizer->render();
+    else if (render_mode == RenderMode::retained) {
+        SDL_RenderSetClipRect(renderer, NULL);
+        SDL_SetRenderTarget(renderer, NULL);
+    }
+}
+
+
+/*static*/ void Window::add_damage(SDL_Rect& damage, DrawnElement& drawn, const uint64_t version, const SDL_Rect& bounds) {
+    if (version == drawn.version && bounds.x == drawn.bounds.x && bounds.y == drawn.bounds.y && bounds.w == drawn.bounds.w && bounds.h == drawn.bounds.h)
+        return;
+
+    // SDL_UnionRect() ignores empty rectangles
+    SDL_UnionRect(&damage, &drawn.bounds, &damage);
+    SDL_UnionRect(&damage, &bounds, &damage);
+    drawn = {.version = version, .bounds = bounds};
+}
+
+
+ResourceCache& Window::get_resources() {
+    return *resources;
+}
+
+
+void Window::handle_render_reset() {
+    // nothing should be queued between frames, but queued quads may refer to lost textures
+    render_queue->clear();
+    resources->invalidate();
+    if (rasterizer != nullptr)
+        add_cpu_textures();
+
+    // target textures lose their contents, or have to be recreated after a device reset
+    if (canvas != NULL)
+        create_canvas(canvas_res.w, canvas_res.h);
+}
+
+
+void Window::add_cpu_textures() {
+    rasterizer->clear_textures();
+    rasterizer->add_texture(text_atlas->get_texture(), {.pixels = text_atlas->get_pixels(), .w = GlyphAtlas::ATLAS_W, .h = GlyphAtlas::ATLAS_H, .pitch = GlyphAtlas::ATLAS_W});
+}
+
+
+void Window::upload_frame() {
+    // e.g. while minimized; SDL can't create empty textures
+    if (rasterizer->get_w() == 0 || rasterizer->get_h() == 0)
+        return;
+
+    if (canvas == NULL || canvas_res.w != rasterizer->get_w() || canvas_res.h != rasterizer->get_h())
+        create_canvas(rasterizer->get_w(), rasterizer->get_h());
+    if (SDL_RectEmpty(&frame_damage))
+        return;
+
+    // only the changed region; the texture keeps the rest
+    const uint32_t* const pixels = rasterizer->get_pixels() + (size_t)frame_damage.y * rasterizer->get_w() + frame_damage.x;
+    if (SDL_UpdateTexture(canvas, &frame_damage, pixels, rasterizer->get_w() * sizeof(uint32_t)) != 0)
+        Logger::warning("Failed to upload frame to canvas\nSDL error: {}", SDL_GetError());
+    frame_damage = {.x = 0, .y = 0, .w = 0, .h = 0};
 }
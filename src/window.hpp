@@ -1,10 +1,17 @@
 #pragma once
 
+#include "thread_pool.hpp"
+#include "graphics/cpu_rasterizer.hpp"
 #include "graphics/fps_counter.hpp"
+#include "graphics/glyph_atlas.hpp"
+#include "graphics/performance_hud.hpp"
+#include "graphics/render_queue.hpp"
+#include "graphics/resource_cache.hpp"
 
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 
+#include <cstdint>
 #include <string>
 #include <tuple>
 #include <memory>
@@ -12,6 +19,35 @@
 
 struct WindowData {
     FpsCounterData fps_data;
+    PerformanceHudData hud_data;
+};
+
+/* continuous values are interpolated from `previous` (`alpha == 0.0`) to `next` (`alpha == 1.0`); discrete values are taken from `next`
+ * there is no simulated state that moves yet (the FPS and HUD values are set by the render loop itself), so this returns `next`
+ * lerp positions and the like here once the simulation has them
+ */
+WindowData interpolate(const WindowData& previous, const WindowData& next, const double alpha);
+
+
+/* how Window draws frames
+ * immediate: clear and redraw everything every frame
+ * retained:  keep the frame in a target texture and only redraw the regions of elements whose version changed; unchanged frames aren't presented
+ */
+enum class RenderMode {
+    immediate,
+    retained
+};
+
+
+/* what draws Window's frames
+ * sdl: the SDL_Renderer; on the GPU, or SDL's single threaded software renderer without one
+ * cpu: CpuRasterizer on the thread pool; the frame is uploaded to a streaming texture to present it, or only kept in memory when headless
+ * automatic: cpu if SDL ends up with its software renderer (e.g. on machines without a GPU driver), else sdl; headless windows use sdl
+ */
+enum class RenderBackend {
+    sdl,
+    cpu,
+    automatic
 };
 
 
@@ -29,29 +65,101 @@ class Window {
         // called on resize to correctly scale the window
         void calculate_screen_coordinates(WindowData& window_data, const int res_w, const int res_h) const;
 
-        Window(const std::string& title, const int _res_w, const int _res_h, WindowData& window_data);
+        // a `headless` window is hidden and uses a software renderer, so it works with SDL's dummy video driver
+        // images of the resource cache are decoded on `thread_pool`, and the CPU backend rasterizes on it
+        // with the SDL backend, falls back to immediate rendering if the renderer doesn't support target textures
+        // if no accelerated renderer can be created, SDL's software renderer is used
+        Window(const std::string& title, const int _res_w, const int _res_h, WindowData& window_data, ThreadPool& thread_pool, const RenderMode _render_mode = RenderMode::immediate, const RenderBackend _render_backend = RenderBackend::sdl, const bool _headless = false);
         ~Window();
 
         // use through: (const) auto [w, h] = window.get_resolution();
         std::tuple<int, int> get_resolution() const;
         void set_resolution(const int w, const int h, WindowData& window_data);
+        // doesn't update the screen coordinates; call calculate_screen_coordinates() separately
+        void set_resolution(const int w, const int h);
 
         // only call once per prepare_frame() invocation
         void render_frame();
 
-        void prepare_frame(const WindowData& window_data);
+        // returns false if nothing changed since the last frame, in which case it doesn't have to be rendered
+        bool prepare_frame(const WindowData& window_data);
+        // redraw everything on the next frame, e.g. when the window was exposed
+        void invalidate();
+
+        RenderMode get_render_mode() const;
+        // never `automatic`; the backend it was resolved to
+        RenderBackend get_render_backend() const;
+        // CPU backend: the frame drawn by the last prepare_frame(); ARGB8888 rows of the window's width
+        // nullptr with the SDL backend
+        const uint32_t* get_frame_pixels() const;
+        /* draw calls and quads of the last presented frame, summed over everything drawn for it
+         * in retained mode that is only what overlapped the damaged region; frames which weren't presented don't reset it
+         */
+        const RenderStats& get_render_stats() const;
+
+        // fonts and textures for drawing in this window
+        ResourceCache& get_resources();
+        // call on SDL_RENDER_TARGETS_RESET and SDL_RENDER_DEVICE_RESET; reloads all textures
+        void handle_render_reset();
 
 
         /* config */
+        static constexpr const char* DEFAULT_FONT = "font/DejaVuSans.ttf";  // relative to the resource directory
         static constexpr int DEFAULT_FONT_PT = 40;
 
 
     private:
+        // version and area of an element when it was last drawn in retained mode
+        struct DrawnElement {
+            uint64_t version = 0;
+            SDL_Rect bounds = {.x = 0, .y = 0, .w = 0, .h = 0};
+        };
+
         SDL_Window* sdl_window;
         Resolution resolution;
         SDL_Renderer* renderer;
 
-        TTF_Font* default_font;
+        RenderMode render_mode;
+        RenderBackend render_backend;
+        bool headless;
+        /* SDL backend, retained mode: target texture with the frame drawn so far
+         * CPU backend: streaming texture the frame is uploaded to for presenting; not created when headless
+         * recreated on resize and render reset
+         */
+        SDL_Texture* canvas;
+        Resolution canvas_res;
+        // set when the canvas' contents can't be relied upon
+        bool full_redraw;
+        DrawnElement drawn_fps_counter;
+        DrawnElement drawn_performance_hud;
+
+        // CPU backend only; keeps the frame between frames, so retained rendering needs no target texture
+        std::unique_ptr<CpuRasterizer> rasterizer;
+        // CPU backend: region of the frame changed since it was last uploaded to the canvas
+        SDL_Rect frame_damage;
+
+        // the GUI elements queue their quads here; flushed once per frame
+        std::unique_ptr<RenderQueue> render_queue;
+        // stats of `render_queue` at the last render_frame()
+        RenderStats presented_stats;
+        std::unique_ptr<ResourceCache> resources;
+        // of the default font; owned by `resources`
+        GlyphAtlas* text_atlas;
 
         std::unique_ptr<FpsCounter> fps_counter;
+        std::unique_ptr<PerformanceHud> performance_hud;
+
+
+        void create_canvas(const int w, const int h);
+        // redraws the regions of changed elements on the canvas; returns false if nothing changed
+        bool prepare_retained_frame(const WindowData& window_data);
+        // clears `region` to black and limits drawing to it, on the canvas in retained mode
+        void begin_drawing(const SDL_Rect& region);
+        // draws what the GUI elements queued since begin_drawing()
+        void end_drawing();
+        // maps the textures the GUI elements draw with to their pixels; again after the textures were recreated
+        void add_cpu_textures();
+        void upload_frame();
+        // adds the old and new area of an element to `damage` if it changed since it was last drawn
+        static void add_damage(SDL_Rect& damage, DrawnElement& drawn, const uint64_t version, const SDL_Rect& bounds);
 };
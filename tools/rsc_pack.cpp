@@ -0,0 +1,43 @@
+/* resource packer: packs a resource directory into an archive which RscDir can mount instead of the loose files
+ * usage: rsc_pack <resource dir> <archive path> [--lz4]; run through `make pack`
+ */
+
+#include "rsc_archive.hpp"
+#include "logger.hpp"
+#include "profiling/timer.hpp"
+
+#include <cstdlib>  // EXIT_SUCCESS, EXIT_FAILURE
+#include <filesystem>
+#include <string>
+
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc > 4 || (argc == 4 && std::string(argv[3]) != "--lz4")) {
+        Logger::error("Usage: rsc_pack <resource dir> <archive path> [--lz4]");
+        return EXIT_FAILURE;
+    }
+
+    const std::filesystem::path dir = argv[1],
+                                archive_path = argv[2];
+    const bool compress = (argc == 4);
+
+    try {
+        const Timer::TimePoint start = Timer::now();
+        RscArchive::pack(dir, archive_path, compress);
+        const double pack_time = Timer::Duration<Timer::ms>(Timer::now() - start);
+
+        // read back, so a broken archive fails the build instead of the next start-up
+        RscArchive archive(archive_path);
+        for (const std::string& name : archive.get_names())
+            archive.get(name);
+
+        Logger::info("Packed {} resources into '{}' ({} bytes, {:.1f} ms)", archive.get_names().size(), archive_path.string(), std::filesystem::file_size(archive_path), pack_time);
+    }
+    catch (const std::exception& e) {
+        Logger::fatal("Failed to pack '{}'", dir.string());
+        Logger::exception(e);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}